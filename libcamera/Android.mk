@@ -21,6 +21,12 @@ LOCAL_SRC_FILES:= \
 	SecCamera.cpp \
 	SecCameraHWInterface.cpp \
 	SecCameraUtils.cpp \
+	SecCameraColorConvert.cpp \
+	SecCameraDevice.cpp \
+	SecCameraStats.cpp \
+	SecCameraDumpWriter.cpp \
+	SecCameraExif.cpp \
+	SecCameraParams.cpp \
 
 LOCAL_SHARED_LIBRARIES:= libutils libcutils libbinder liblog libcamera_client libhardware
 LOCAL_SHARED_LIBRARIES+= libs3cjpeg
@@ -43,4 +49,6 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(call all-makefiles-under,$(LOCAL_PATH))
+
 endif
@@ -34,7 +34,10 @@
 #include <stdlib.h>
 #include <sys/poll.h>
 #include "SecCamera.h"
+#include "SecCameraDevice.h"
+#include "SecCameraStats.h"
 #include "cutils/properties.h"
+#include <cutils/atomic.h>
 
 using namespace android;
 
@@ -62,27 +65,6 @@ namespace android {
 // ======================================================================
 // Camera controls
 
-static struct timeval time_start;
-static struct timeval time_stop;
-
-unsigned long measure_time(struct timeval *start, struct timeval *stop)
-{
-    unsigned long sec, usec, time;
-
-    sec = stop->tv_sec - start->tv_sec;
-
-    if (stop->tv_usec >= start->tv_usec) {
-        usec = stop->tv_usec - start->tv_usec;
-    } else {
-        usec = stop->tv_usec + 1000000 - start->tv_usec;
-        sec--;
-    }
-
-    time = (sec * 1000000) + usec;
-
-    return time;
-}
-
 static int get_pixel_depth(unsigned int fmt)
 {
     int depth = 0;
@@ -98,6 +80,7 @@ static int get_pixel_depth(unsigned int fmt)
         depth = 12;
         break;
     case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YVU420:
         depth = 12;
         break;
 
@@ -131,7 +114,7 @@ static int fimc_poll(struct pollfd *events)
     /* 10 second delay is because sensor can take a long time
      * to do auto focus and capture in dark settings
      */
-    ret = poll(events, 1, 10000);
+    ret = fimc_dev_poll(events, 1, 10000);
     if (ret < 0) {
         ALOGE("ERR(%s):poll error\n", __func__);
         return ret;
@@ -163,9 +146,9 @@ int SecCamera::previewPoll(bool preview)
         }
 #endif
 
-        ret = poll(&m_events_c, 1, 1000);
+        ret = fimc_dev_poll(&m_events_c, 1, 1000);
     } else {
-        ret = poll(&m_events_c2, 1, 1000);
+        ret = fimc_dev_poll(&m_events_c2, 1, 1000);
     }
 
     if (ret < 0) {
@@ -186,7 +169,7 @@ static int fimc_v4l2_querycap(int fp)
     struct v4l2_capability cap;
     int ret = 0;
 
-    ret = ioctl(fp, VIDIOC_QUERYCAP, &cap);
+    ret = fimc_dev_ioctl(fp, VIDIOC_QUERYCAP, &cap);
 
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_QUERYCAP failed\n", __func__);
@@ -201,18 +184,24 @@ static int fimc_v4l2_querycap(int fp)
     return ret;
 }
 
-static const __u8* fimc_v4l2_enuminput(int fp, int index)
+static int fimc_v4l2_enuminput(int fp, int index, __u8 *name, size_t len)
 {
-    static struct v4l2_input input;
+    struct v4l2_input input;
 
+    memset(&input, 0, sizeof(input));
     input.index = index;
-    if (ioctl(fp, VIDIOC_ENUMINPUT, &input) != 0) {
+    if (fimc_dev_ioctl(fp, VIDIOC_ENUMINPUT, &input) != 0) {
         ALOGE("ERR(%s):No matching index found\n", __func__);
-        return NULL;
+        return -1;
     }
     ALOGI("Name of input channel[%d] is %s\n", input.index, input.name);
 
-    return input.name;
+    if (name) {
+        strncpy((char *)name, (const char *)input.name, len - 1);
+        name[len - 1] = '\0';
+    }
+
+    return 0;
 }
 
 
@@ -223,7 +212,7 @@ static int fimc_v4l2_s_input(int fp, int index)
 
     input.index = index;
 
-    ret = ioctl(fp, VIDIOC_S_INPUT, &input);
+    ret = fimc_dev_ioctl(fp, VIDIOC_S_INPUT, &input);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_INPUT failed\n", __func__);
         return ret;
@@ -253,7 +242,7 @@ static int fimc_v4l2_s_fmt(int fp, int width, int height, unsigned int fmt, int
     v4l2_fmt.fmt.pix = pixfmt;
 
     /* Set up for capture */
-    ret = ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
+    ret = fimc_dev_ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_FMT failed\n", __func__);
         return -1;
@@ -286,7 +275,7 @@ static int fimc_v4l2_s_fmt_cap(int fp, int width, int height, unsigned int fmt)
     //ALOGE("ori_w %d, ori_h %d, w %d, h %d\n", width, height, v4l2_fmt.fmt.pix.width, v4l2_fmt.fmt.pix.height);
 
     /* Set up for capture */
-    ret = ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
+    ret = fimc_dev_ioctl(fp, VIDIOC_S_FMT, &v4l2_fmt);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_FMT failed\n", __func__);
         return ret;
@@ -303,7 +292,7 @@ static int fimc_v4l2_enum_fmt(int fp, unsigned int fmt)
     fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     fmtdesc.index = 0;
 
-    while (ioctl(fp, VIDIOC_ENUM_FMT, &fmtdesc) == 0) {
+    while (fimc_dev_ioctl(fp, VIDIOC_ENUM_FMT, &fmtdesc) == 0) {
         if (fmtdesc.pixelformat == fmt) {
             ALOGV("passed fmt = %#x found pixel format[%d]: %s\n", fmt, fmtdesc.index, fmtdesc.description);
             found = 1;
@@ -330,7 +319,7 @@ static int fimc_v4l2_reqbufs(int fp, enum v4l2_buf_type type, int nr_bufs)
     req.type = type;
     req.memory = V4L2_MEMORY_MMAP;
 
-    ret = ioctl(fp, VIDIOC_REQBUFS, &req);
+    ret = fimc_dev_ioctl(fp, VIDIOC_REQBUFS, &req);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_REQBUFS failed\n", __func__);
         return -1;
@@ -339,7 +328,26 @@ static int fimc_v4l2_reqbufs(int fp, enum v4l2_buf_type type, int nr_bufs)
     return req.count;
 }
 
-static int fimc_v4l2_querybuf(int fp, struct fimc_buffer *buffer, enum v4l2_buf_type type)
+static int fimc_v4l2_reqbufs_userptr(int fp, enum v4l2_buf_type type, int nr_bufs)
+{
+    struct v4l2_requestbuffers req;
+    int ret;
+
+    req.count = nr_bufs;
+    req.type = type;
+    req.memory = V4L2_MEMORY_USERPTR;
+
+    ret = fimc_dev_ioctl(fp, VIDIOC_REQBUFS, &req);
+    if (ret < 0) {
+        ALOGW("WARN(%s):VIDIOC_REQBUFS(USERPTR) not supported\n", __func__);
+        return -1;
+    }
+
+    return req.count;
+}
+
+static int fimc_v4l2_querybuf(int fp, struct fimc_buffer *buffer, enum v4l2_buf_type type,
+                              int index = 0)
 {
     struct v4l2_buffer v4l2_buf;
     int ret;
@@ -348,16 +356,16 @@ static int fimc_v4l2_querybuf(int fp, struct fimc_buffer *buffer, enum v4l2_buf_
 
     v4l2_buf.type = type;
     v4l2_buf.memory = V4L2_MEMORY_MMAP;
-    v4l2_buf.index = 0;
+    v4l2_buf.index = index;
 
-    ret = ioctl(fp , VIDIOC_QUERYBUF, &v4l2_buf);
+    ret = fimc_dev_ioctl(fp, VIDIOC_QUERYBUF, &v4l2_buf);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_QUERYBUF failed\n", __func__);
         return -1;
     }
 
     buffer->length = v4l2_buf.length;
-    if ((buffer->start = (char *)mmap(0, v4l2_buf.length,
+    if ((buffer->start = (char *)fimc_dev_mmap(v4l2_buf.length,
                                          PROT_READ | PROT_WRITE, MAP_SHARED,
                                          fp, v4l2_buf.m.offset)) < 0) {
          ALOGE("%s %d] mmap() failed\n",__func__, __LINE__);
@@ -375,7 +383,7 @@ static int fimc_v4l2_streamon(int fp)
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     int ret;
 
-    ret = ioctl(fp, VIDIOC_STREAMON, &type);
+    ret = fimc_dev_ioctl(fp, VIDIOC_STREAMON, &type);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_STREAMON failed\n", __func__);
         return ret;
@@ -390,7 +398,7 @@ static int fimc_v4l2_streamoff(int fp)
     int ret;
 
     ALOGV("%s :", __func__);
-    ret = ioctl(fp, VIDIOC_STREAMOFF, &type);
+    ret = fimc_dev_ioctl(fp, VIDIOC_STREAMOFF, &type);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_STREAMOFF failed\n", __func__);
         return ret;
@@ -408,7 +416,7 @@ static int fimc_v4l2_qbuf(int fp, int index)
     v4l2_buf.memory = V4L2_MEMORY_MMAP;
     v4l2_buf.index = index;
 
-    ret = ioctl(fp, VIDIOC_QBUF, &v4l2_buf);
+    ret = fimc_dev_ioctl(fp, VIDIOC_QBUF, &v4l2_buf);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_QBUF failed\n", __func__);
         return ret;
@@ -417,20 +425,103 @@ static int fimc_v4l2_qbuf(int fp, int index)
     return 0;
 }
 
-static int fimc_v4l2_dqbuf(int fp)
+static int fimc_v4l2_qbuf_userptr(int fp, int index, unsigned long userptr, size_t length)
 {
     struct v4l2_buffer v4l2_buf;
     int ret;
 
+    memset(&v4l2_buf, 0, sizeof(v4l2_buf));
     v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    v4l2_buf.memory = V4L2_MEMORY_MMAP;
+    v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+    v4l2_buf.index = index;
+    v4l2_buf.m.userptr = userptr;
+    v4l2_buf.length = length;
 
-    ret = ioctl(fp, VIDIOC_DQBUF, &v4l2_buf);
+    ret = fimc_dev_ioctl(fp, VIDIOC_QBUF, &v4l2_buf);
+    if (ret < 0) {
+        ALOGE("ERR(%s):VIDIOC_QBUF(USERPTR) failed\n", __func__);
+        return ret;
+    }
+
+    return 0;
+}
+
+/*
+ * The FIMC driver stamps buffers with do_gettimeofday(), while the camera
+ * framework expects systemTime(SYSTEM_TIME_MONOTONIC).  Carry the frame's
+ * age over to the monotonic clock, and fall back to "now" if the stamp
+ * is missing or from neither clock.
+ */
+static nsecs_t fimc_v4l2_buf_time(const struct v4l2_buffer *buf)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t ts = s2ns(buf->timestamp.tv_sec) + us2ns(buf->timestamp.tv_usec);
+
+    if (ts == 0)
+        return now;
+
+    nsecs_t real = systemTime(SYSTEM_TIME_REALTIME);
+    if (ts <= real && real - ts < FRAME_TIMESTAMP_MAX_AGE)
+        return now - (real - ts);
+    if (ts <= now && now - ts < FRAME_TIMESTAMP_MAX_AGE)
+        return ts;
+
+    return now;
+}
+
+static void fimc_update_frame_stats(struct fimc_frame_stats *stats,
+                                    const struct v4l2_buffer *buf)
+{
+    nsecs_t ts = fimc_v4l2_buf_time(buf);
+
+    if (stats->frames) {
+        nsecs_t delta = ts - stats->timestamp;
+        __u32 gap = buf->sequence - stats->sequence;
+
+        if (gap > 1) {
+            stats->dropped += gap - 1;
+            delta /= gap;
+        } else if (gap == 0 && stats->period > 0 && !stats->settle &&
+                   delta > stats->period * 3 / 2) {
+            /* the driver doesn't number frames, go by the time between them */
+            stats->dropped += (delta + stats->period / 2) / stats->period - 1;
+            delta = stats->period;
+        }
+
+        /* after a rate change the old period says nothing about drops, and
+         * clamping to it would keep it from ever adapting */
+        if (stats->period == 0 || stats->settle)
+            stats->period = delta;
+        else if (delta > 0)
+            stats->period += (delta - stats->period) / 8;
+        if (stats->settle)
+            stats->settle--;
+    }
+
+    stats->timestamp = ts;
+    stats->sequence = buf->sequence;
+    stats->frames++;
+}
+
+static int fimc_v4l2_dqbuf(int fp, enum v4l2_memory memory = V4L2_MEMORY_MMAP,
+                           struct fimc_frame_stats *stats = NULL)
+{
+    struct v4l2_buffer v4l2_buf;
+    int ret;
+
+    memset(&v4l2_buf, 0, sizeof(v4l2_buf));
+    v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    v4l2_buf.memory = memory;
+
+    ret = fimc_dev_ioctl(fp, VIDIOC_DQBUF, &v4l2_buf);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_DQBUF failed, dropped frame\n", __func__);
         return ret;
     }
 
+    if (stats)
+        fimc_update_frame_stats(stats, &v4l2_buf);
+
     return v4l2_buf.index;
 }
 
@@ -441,7 +532,7 @@ static int fimc_v4l2_g_ctrl(int fp, unsigned int id)
 
     ctrl.id = id;
 
-    ret = ioctl(fp, VIDIOC_G_CTRL, &ctrl);
+    ret = fimc_dev_ioctl(fp, VIDIOC_G_CTRL, &ctrl);
     if (ret < 0) {
         ALOGE("ERR(%s): VIDIOC_G_CTRL(id = 0x%x (%d)) failed, ret = %d\n",
              __func__, id, id-V4L2_CID_PRIVATE_BASE, ret);
@@ -459,7 +550,7 @@ static int fimc_v4l2_s_ctrl(int fp, unsigned int id, unsigned int value)
     ctrl.id = id;
     ctrl.value = value;
 
-    ret = ioctl(fp, VIDIOC_S_CTRL, &ctrl);
+    ret = fimc_dev_ioctl(fp, VIDIOC_S_CTRL, &ctrl);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_CTRL(id = %#x (%d), value = %d) failed ret = %d\n",
              __func__, id, id-V4L2_CID_PRIVATE_BASE, value, ret);
@@ -483,7 +574,7 @@ static int fimc_v4l2_s_ext_ctrl(int fp, unsigned int id, void *value)
     ctrls.count = 1;
     ctrls.controls = &ctrl;
 
-    ret = ioctl(fp, VIDIOC_S_EXT_CTRLS, &ctrls);
+    ret = fimc_dev_ioctl(fp, VIDIOC_S_EXT_CTRLS, &ctrls);
     if (ret < 0)
         ALOGE("ERR(%s):VIDIOC_S_EXT_CTRLS failed\n", __func__);
 
@@ -496,7 +587,7 @@ static int fimc_v4l2_g_parm(int fp, struct v4l2_streamparm *streamparm)
 
     streamparm->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-    ret = ioctl(fp, VIDIOC_G_PARM, streamparm);
+    ret = fimc_dev_ioctl(fp, VIDIOC_G_PARM, streamparm);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_G_PARM failed\n", __func__);
         return -1;
@@ -515,7 +606,7 @@ static int fimc_v4l2_s_parm(int fp, struct v4l2_streamparm *streamparm)
 
     streamparm->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-    ret = ioctl(fp, VIDIOC_S_PARM, streamparm);
+    ret = fimc_dev_ioctl(fp, VIDIOC_S_PARM, streamparm);
     if (ret < 0) {
         ALOGE("ERR(%s):VIDIOC_S_PARM failed\n", __func__);
         return ret;
@@ -532,11 +623,18 @@ SecCamera::SecCamera() :
             m_camera_id(CAMERA_ID_BACK),
             m_cam_fd(-1),
             m_cam_fd2(-1),
+            m_record_input_set(0),
+            m_exif_fixed_id(-1),
+            m_init_time(0),
             m_preview_v4lformat(V4L2_PIX_FMT_NV21),
             m_preview_width      (0),
             m_preview_height     (0),
             m_preview_max_width  (MAX_BACK_CAMERA_PREVIEW_WIDTH),
             m_preview_max_height (MAX_BACK_CAMERA_PREVIEW_HEIGHT),
+            m_preview_userptr_length(0),
+            m_preview_userptr_queued(0),
+            m_preview_hold(false),
+            m_preview_held(0),
             m_snapshot_v4lformat(-1),
             m_snapshot_width      (0),
             m_snapshot_height     (0),
@@ -547,6 +645,7 @@ SecCamera::SecCamera() :
             m_wdr(-1),
             m_anti_shake(-1),
             m_zoom_level(-1),
+            m_sensor_frame_rate(-1),
             m_object_tracking(-1),
             m_smart_auto(-1),
             m_beauty_shot(-1),
@@ -574,6 +673,9 @@ SecCamera::SecCamera() :
             ,
             m_esd_check_count(0)
 #endif // ENABLE_ESD_PREVIEW_CHECK
+            ,
+            m_exif_verify(false),
+            m_af_state(AF_STATE_IDLE)
 {
     m_params = (struct sec_cam_parm*)&m_streamparm.parm.raw_data;
     struct v4l2_captureparm capture;
@@ -592,6 +694,19 @@ SecCamera::SecCamera() :
     m_params->white_balance = -1;
 
     memset(&m_capture_buf, 0, sizeof(m_capture_buf));
+    memset(&m_preview_stats, 0, sizeof(m_preview_stats));
+    memset(&m_record_stats, 0, sizeof(m_record_stats));
+    m_record_queued = 0;
+    memset(m_record_buf, 0, sizeof(m_record_buf));
+    m_record_frame_width = 0;
+    m_record_frame_height = 0;
+    memset(m_probed_inputs, 0, sizeof(m_probed_inputs));
+    memset(m_input_names, 0, sizeof(m_input_names));
+    m_capture_nframe = 0;
+    m_ctrl_sent = 0;
+    m_ctrl_skipped = 0;
+    invalidateCtrlCache();
+    memset(m_preview_userptr, 0, sizeof(m_preview_userptr));
 
     ALOGV("%s :", __func__);
 }
@@ -607,13 +722,34 @@ int SecCamera::initCamera(int index)
     int ret = 0;
 
     if (!m_flag_init) {
+        SecCameraStats::Timer init(STAGE_CAMERA_INIT);
+        m_init_time = systemTime(SYSTEM_TIME_MONOTONIC);
+
         /* Arun C
          * Reset the lense position only during camera starts; don't do
          * reset between shot to shot
          */
         m_camera_af_flag = -1;
 
-        m_cam_fd = open(CAMERA_DEV_NAME, O_RDWR);
+        /* a freshly opened sensor has its defaults again */
+        invalidateCtrlCache();
+
+        m_camera_id = index;
+
+        /* a failed initCamera() may have left the record node behind */
+        stopRecordNodeThread();
+        if (m_cam_fd2 > -1) {
+            fimc_dev_close(m_cam_fd2);
+            m_cam_fd2 = -1;
+        }
+        m_record_input_set = 0;
+
+        /* recording may never happen, keep the record node off this path */
+        m_record_node_thread = new RecordNodeThread(this);
+        if (m_record_node_thread->run("CameraRecordNodeThread", PRIORITY_DEFAULT) != NO_ERROR)
+            m_record_node_thread.clear();
+
+        m_cam_fd = fimc_dev_open(CAMERA_DEV_NAME, O_RDWR);
         if (m_cam_fd < 0) {
             ALOGE("ERR(%s):Cannot open %s (error : %s)\n", __func__, CAMERA_DEV_NAME, strerror(errno));
             return -1;
@@ -622,31 +758,11 @@ int SecCamera::initCamera(int index)
 
         ALOGE("initCamera: m_cam_fd(%d), m_jpeg_fd(%d)", m_cam_fd, m_jpeg_fd);
 
-        ret = fimc_v4l2_querycap(m_cam_fd);
+        ret = probeNode(m_cam_fd, NODE_PREVIEW, index);
         CHECK(ret);
-        if (!fimc_v4l2_enuminput(m_cam_fd, index))
-            return -1;
         ret = fimc_v4l2_s_input(m_cam_fd, index);
         CHECK(ret);
 
-        m_cam_fd2 = open(CAMERA_DEV_NAME2, O_RDWR);
-        ALOGV("%s: open(%s) --> m_cam_fd2 = %d", __FUNCTION__, CAMERA_DEV_NAME2, m_cam_fd2);
-        if (m_cam_fd2 < 0) {
-            ALOGE("ERR(%s):Cannot open %s (error : %s)\n", __func__, CAMERA_DEV_NAME2, strerror(errno));
-            return -1;
-        }
-
-        ALOGE("initCamera: m_cam_fd2(%d)", m_cam_fd2);
-
-        ret = fimc_v4l2_querycap(m_cam_fd2);
-        CHECK(ret);
-        if (!fimc_v4l2_enuminput(m_cam_fd2, index))
-            return -1;
-        ret = fimc_v4l2_s_input(m_cam_fd2, index);
-        CHECK(ret);
-
-        m_camera_id = index;
-
         switch (m_camera_id) {
         case CAMERA_ID_FRONT:
             m_preview_max_width   = MAX_FRONT_CAMERA_PREVIEW_WIDTH;
@@ -663,8 +779,6 @@ int SecCamera::initCamera(int index)
             break;
         }
 
-        setExifFixedAttribute();
-
         m_flag_init = 1;
         ALOGI("%s : initialized", __FUNCTION__);
     }
@@ -691,15 +805,17 @@ void SecCamera::DeinitCamera()
          */
         ALOGI("DeinitCamera: m_cam_fd(%d)", m_cam_fd);
         if (m_cam_fd > -1) {
-            close(m_cam_fd);
+            fimc_dev_close(m_cam_fd);
             m_cam_fd = -1;
         }
 
+        stopRecordNodeThread();
         ALOGI("DeinitCamera: m_cam_fd2(%d)", m_cam_fd2);
         if (m_cam_fd2 > -1) {
-            close(m_cam_fd2);
+            fimc_dev_close(m_cam_fd2);
             m_cam_fd2 = -1;
         }
+        m_record_input_set = 0;
 
         m_flag_init = 0;
     }
@@ -712,6 +828,121 @@ int SecCamera::getCameraFd(void)
     return m_cam_fd;
 }
 
+int SecCamera::probeNode(int fd, int node, int index)
+{
+    if (m_probed_inputs[node] & (1 << index))
+        return 0;
+
+    __u8 *name = NULL;
+    if (node == NODE_PREVIEW && index < MAX_CAMERA_INPUTS)
+        name = m_input_names[index];
+
+    if (fimc_v4l2_querycap(fd) < 0)
+        return -1;
+    if (fimc_v4l2_enuminput(fd, index, name, sizeof(m_input_names[0])) < 0)
+        return -1;
+
+    m_probed_inputs[node] |= 1 << index;
+    return 0;
+}
+
+/*
+ * Runs on RecordNodeThread, or from prepareRecordNode() if that didn't
+ * get the node open.
+ */
+int SecCamera::openRecordNode(void)
+{
+    SecCameraStats::Timer open(STAGE_RECORD_NODE_OPEN);
+
+    int fd = fimc_dev_open(CAMERA_DEV_NAME2, O_RDWR);
+    if (fd < 0) {
+        ALOGE("ERR(%s):Cannot open %s (error : %s)\n", __func__, CAMERA_DEV_NAME2, strerror(errno));
+        return -1;
+    }
+    ALOGV("%s: open(%s) --> m_cam_fd2 = %d", __FUNCTION__, CAMERA_DEV_NAME2, fd);
+
+    if (probeNode(fd, NODE_RECORD, m_camera_id) < 0) {
+        fimc_dev_close(fd);
+        return -1;
+    }
+
+    m_cam_fd2 = fd;
+    return 0;
+}
+
+int SecCamera::prepareRecordNode(void)
+{
+    stopRecordNodeThread();
+
+    if (m_cam_fd2 < 0 && openRecordNode() < 0)
+        return -1;
+
+    if (!m_record_input_set) {
+        int ret = fimc_v4l2_s_input(m_cam_fd2, m_camera_id);
+        CHECK(ret);
+        m_record_input_set = 1;
+    }
+
+    return 0;
+}
+
+void SecCamera::stopRecordNodeThread(void)
+{
+    if (m_record_node_thread != NULL) {
+        m_record_node_thread->join();
+        m_record_node_thread.clear();
+    }
+}
+
+// ======================================================================
+// Sensor control cache
+/*
+ * startPreview() re-applies the whole sensor setup on every start, which
+ * after each snapshot is mostly the same values again.  Controls sent
+ * through setSensorCtrl() are remembered, so only the ones that differ
+ * from what the sensor already has go out as ioctls.  The cache is
+ * dropped whenever the sensor may have lost its state.
+ */
+int SecCamera::setSensorCtrl(unsigned int id, int value)
+{
+    int i;
+
+    for (i = 0; i < m_ctrl_cache_count; i++) {
+        if (m_ctrl_cache[i].id == id)
+            break;
+    }
+
+    if (i < m_ctrl_cache_count && m_ctrl_cache[i].value == value) {
+        m_ctrl_skipped++;
+        return 0;
+    }
+
+    int ret = fimc_v4l2_s_ctrl(m_cam_fd, id, value);
+    if (ret < 0) {
+        /* we don't know what the sensor ended up with */
+        if (i < m_ctrl_cache_count)
+            m_ctrl_cache[i] = m_ctrl_cache[--m_ctrl_cache_count];
+        return ret;
+    }
+    m_ctrl_sent++;
+
+    if (i == m_ctrl_cache_count) {
+        if (m_ctrl_cache_count == CTRL_CACHE_SIZE)
+            return ret;
+        m_ctrl_cache_count++;
+    }
+    m_ctrl_cache[i].id = id;
+    m_ctrl_cache[i].value = value;
+
+    return ret;
+}
+
+void SecCamera::invalidateCtrlCache(void)
+{
+    ALOGV("%s :", __func__);
+    m_ctrl_cache_count = 0;
+}
+
 // ======================================================================
 // Preview
 
@@ -737,20 +968,29 @@ int SecCamera::startPreview(void)
     m_events_c.fd = m_cam_fd;
     m_events_c.events = POLLIN | POLLERR;
 
+    SecCameraStats::Timer start(STAGE_PREVIEW_START);
+
+    /* user pointer preview writes straight into YV12 window buffers */
+    bool userptr = isPreviewUserPtr();
+    unsigned int v4lformat = userptr ? V4L2_PIX_FMT_YVU420 : m_preview_v4lformat;
+
     /* enum_fmt, s_fmt sample */
-    int ret = fimc_v4l2_enum_fmt(m_cam_fd,m_preview_v4lformat);
+    int ret = fimc_v4l2_enum_fmt(m_cam_fd, v4lformat);
     CHECK(ret);
 #ifndef FFC_FLIPPED
     if (m_camera_id == CAMERA_ID_BACK)
-        ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_width,m_preview_height,m_preview_v4lformat, 0);
+        ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_width,m_preview_height,v4lformat, 0);
     else
-        ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_height,m_preview_width,m_preview_v4lformat, 0);
+        ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_height,m_preview_width,v4lformat, 0);
 #else
-    ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_width,m_preview_height,m_preview_v4lformat, 0);
+    ret = fimc_v4l2_s_fmt(m_cam_fd, m_preview_width,m_preview_height,v4lformat, 0);
 #endif
     CHECK(ret);
 
-    ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
+    if (userptr)
+        ret = fimc_v4l2_reqbufs_userptr(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
+    else
+        ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
     CHECK(ret);
 
     ALOGV("%s : m_preview_width: %d m_preview_height: %d m_angle: %d\n",
@@ -762,13 +1002,22 @@ int SecCamera::startPreview(void)
 
     if (m_camera_id == CAMERA_ID_FRONT) {
         /* VT mode setting */
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_VT_MODE, m_vtmode);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_VT_MODE, m_vtmode);
         CHECK(ret);
     }
 
     /* start with all buffers in queue */
+    android_atomic_release_store(0, &m_preview_held);
     for (int i = 0; i < MAX_BUFFERS; i++) {
-        ret = fimc_v4l2_qbuf(m_cam_fd, i);
+        if (userptr) {
+            /* slots held by the display are queued once they come back */
+            if (!(m_preview_userptr_queued & (1 << i)))
+                continue;
+            ret = fimc_v4l2_qbuf_userptr(m_cam_fd, i, m_preview_userptr[i],
+                                         m_preview_userptr_length);
+        } else {
+            ret = fimc_v4l2_qbuf(m_cam_fd, i);
+        }
         CHECK(ret);
     }
 
@@ -783,23 +1032,23 @@ int SecCamera::startPreview(void)
         m_video_gamma = GAMMA_ON;
         m_slow_ae = SLOW_AE_ON;
 
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ANTI_BANDING, m_anti_banding);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_ANTI_BANDING, m_anti_banding);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ISO, m_params->iso);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_ISO, m_params->iso);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BRIGHTNESS, m_params->brightness);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_BRIGHTNESS, m_params->brightness);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE, m_params->capture.timeperframe.denominator);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_FRAME_RATE, m_params->capture.timeperframe.denominator);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_METERING, m_params->metering);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_METERING, m_params->metering);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_GAMMA, m_video_gamma);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_SET_GAMMA, m_video_gamma);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_SLOW_AE, m_slow_ae);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_SET_SLOW_AE, m_slow_ae);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_EFFECT, m_params->effects);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_EFFECT, m_params->effects);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_WHITE_BALANCE, m_params->white_balance);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_WHITE_BALANCE, m_params->white_balance);
         CHECK(ret);
     }
 
@@ -808,43 +1057,44 @@ int SecCamera::startPreview(void)
 
     if (m_camera_id == CAMERA_ID_BACK) {
         // More parameters for CE147
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FOCUS_MODE, m_params->focus_mode);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_FOCUS_MODE, m_params->focus_mode);
         CHECK(ret);
         m_face_detect = 0;
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FACE_DETECTION, m_face_detect);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_FACE_DETECTION, m_face_detect);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SHARPNESS, m_params->sharpness);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_SHARPNESS, m_params->sharpness);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SATURATION, m_params->saturation);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_SATURATION, m_params->saturation);
         CHECK(ret);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_CONTRAST, m_params->contrast);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_CONTRAST, m_params->contrast);
         CHECK(ret);
         // TODO
         m_beauty_shot = 0;
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BEAUTY_SHOT, m_beauty_shot);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_BEAUTY_SHOT, m_beauty_shot);
         CHECK(ret);
         m_zoom_level = 0;
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ZOOM, m_zoom_level);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_ZOOM, m_zoom_level);
         CHECK(ret);
         ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BATCH_REFLECTION, 1);
         CHECK(ret);
     }
 
     m_flag_camera_start = 1;
+    memset(&m_preview_stats, 0, sizeof(m_preview_stats));
 
     ret = fimc_v4l2_s_parm(m_cam_fd, &m_streamparm);
     CHECK(ret);
+    m_sensor_frame_rate = m_params->capture.timeperframe.denominator;
 
     if (m_camera_id == CAMERA_ID_FRONT) {
         /* Blur setting */
         ALOGV("m_blur_level = %d", m_blur_level);
-        ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_VGA_BLUR,
-                               m_blur_level);
+        ret = setSensorCtrl(V4L2_CID_CAMERA_VGA_BLUR, m_blur_level);
         CHECK(ret);
     }
 
 #ifdef HAVE_FLASH
-    ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FLASH_MODE, m_params->flash_mode);
+    ret = setSensorCtrl(V4L2_CID_CAMERA_FLASH_MODE, m_params->flash_mode);
     CHECK(ret);
 #endif
 
@@ -899,11 +1149,14 @@ int SecCamera::startRecord(void)
         return 0;
     }
 
-    if (m_cam_fd2 <= 0) {
+    if (m_cam_fd <= 0) {
         ALOGE("ERR(%s):Camera was closed\n", __func__);
         return -1;
     }
 
+    ret = prepareRecordNode();
+    CHECK(ret);
+
     /* enum_fmt, s_fmt sample */
     ret = fimc_v4l2_enum_fmt(m_cam_fd2, V4L2_PIX_FMT_NV12T);
     CHECK(ret);
@@ -911,6 +1164,8 @@ int SecCamera::startRecord(void)
     ALOGI("%s: m_recording_width = %d, m_recording_height = %d\n",
          __func__, m_recording_width, m_recording_height);
 
+    m_record_frame_width = m_recording_width;
+    m_record_frame_height = m_recording_height;
     if (m_camera_id == CAMERA_ID_BACK) {
         // Some properties for back camera video recording
         setISO(ISO_MOVIE);
@@ -921,6 +1176,8 @@ int SecCamera::startRecord(void)
                               m_recording_height, V4L2_PIX_FMT_NV12T, 0);
     }
     else {
+        m_record_frame_width = m_recording_height;
+        m_record_frame_height = m_recording_width;
         ret = fimc_v4l2_s_fmt(m_cam_fd2, m_recording_height,
                               m_recording_width, V4L2_PIX_FMT_NV12T, 0);
     }
@@ -931,15 +1188,26 @@ int SecCamera::startRecord(void)
 #endif
     CHECK(ret);
 
-    ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE,
-                            m_params->capture.timeperframe.denominator);
+    ret = setSensorCtrl(V4L2_CID_CAMERA_FRAME_RATE,
+                        m_params->capture.timeperframe.denominator);
     CHECK(ret);
+    m_sensor_frame_rate = m_params->capture.timeperframe.denominator;
+
+    /* left over if the last startRecord() failed after mapping them */
+    unmapRecordBuffers();
 
     ret = fimc_v4l2_reqbufs(m_cam_fd2, V4L2_BUF_TYPE_VIDEO_CAPTURE, MAX_BUFFERS);
     CHECK(ret);
 
-    /* start with all buffers in queue */
+    /* start with all buffers in queue; the MFC gets them by their
+     * physical address, the mapping is only read for video snapshots */
     for (i = 0; i < MAX_BUFFERS; i++) {
+        if (fimc_v4l2_querybuf(m_cam_fd2, &m_record_buf[i], V4L2_BUF_TYPE_VIDEO_CAPTURE, i) < 0) {
+            ALOGW("%s: record buffer %d not mapped, no video snapshots", __func__, i);
+            m_record_buf[i].start = NULL;
+            m_record_buf[i].length = 0;
+        }
+
         ret = fimc_v4l2_qbuf(m_cam_fd2, i);
         CHECK(ret);
     }
@@ -961,6 +1229,8 @@ int SecCamera::startRecord(void)
     }
 
     m_flag_record_start = 1;
+    memset(&m_record_stats, 0, sizeof(m_record_stats));
+    m_record_queued = MAX_BUFFERS;
 
     return 0;
 }
@@ -1000,9 +1270,11 @@ int SecCamera::stopRecord(void)
     ret = fimc_v4l2_streamoff(m_cam_fd2);
     CHECK(ret);
 
-    ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE,
-                            FRAME_RATE_AUTO);
+    unmapRecordBuffers();
+
+    ret = setSensorCtrl(V4L2_CID_CAMERA_FRAME_RATE, FRAME_RATE_AUTO);
     CHECK(ret);
+    m_sensor_frame_rate = FRAME_RATE_AUTO;
 
     // Properties for back camera non-video recording
     if (m_camera_id == CAMERA_ID_BACK) {
@@ -1032,6 +1304,33 @@ unsigned int SecCamera::getRecPhyAddrC(int index)
     return addr_c;
 }
 
+void SecCamera::unmapRecordBuffers(void)
+{
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (m_record_buf[i].start) {
+            fimc_dev_munmap(m_record_buf[i].start, m_record_buf[i].length);
+            m_record_buf[i].start = NULL;
+            m_record_buf[i].length = 0;
+        }
+    }
+}
+
+void SecCamera::getRecordFrameSize(int *width, int *height)
+{
+    *width = m_record_frame_width;
+    *height = m_record_frame_height;
+}
+
+const unsigned char *SecCamera::getRecordBuffer(int index, size_t *length)
+{
+    if (!m_flag_record_start || index < 0 || index >= MAX_BUFFERS ||
+        !m_record_buf[index].start)
+        return NULL;
+
+    *length = m_record_buf[index].length;
+    return (const unsigned char *)m_record_buf[index].start;
+}
+
 unsigned int SecCamera::getPhyAddrY(int index)
 {
     unsigned int addr_y;
@@ -1073,10 +1372,12 @@ int SecCamera::getPreview()
         /* Reset Only Camera Device */
         ret = fimc_v4l2_querycap(m_cam_fd);
         CHECK(ret);
-        if (fimc_v4l2_enuminput(m_cam_fd, m_camera_id))
+        if (fimc_v4l2_enuminput(m_cam_fd, m_camera_id, NULL, 0) < 0)
             return -1;
         ret = fimc_v4l2_s_input(m_cam_fd, 1000);
         CHECK(ret);
+        /* the sensor was restarted, everything has to be sent again */
+        invalidateCtrlCache();
         ret = startPreview();
         if (ret < 0) {
             ALOGE("ERR(%s): startPreview() return %d\n", __func__, ret);
@@ -1084,18 +1385,129 @@ int SecCamera::getPreview()
         }
     }
 
-    index = fimc_v4l2_dqbuf(m_cam_fd);
+    /* the poll above has seen the first frame since initCamera() */
+    if (m_init_time) {
+        SecCameraStats::record(STAGE_FIRST_PREVIEW_FRAME,
+                               systemTime(SYSTEM_TIME_MONOTONIC) - m_init_time);
+        m_init_time = 0;
+    }
+
+    SecCameraStats::Timer dqbuf(STAGE_PREVIEW_DQBUF);
+
+    if (isPreviewUserPtr()) {
+        /* the buffer stays with the caller until releasePreviewFrame() */
+        index = fimc_v4l2_dqbuf(m_cam_fd, V4L2_MEMORY_USERPTR, &m_preview_stats);
+        dqbuf.stop();
+        if (!(0 <= index && index < MAX_BUFFERS)) {
+            ALOGE("ERR(%s):wrong index = %d\n", __func__, index);
+            return -1;
+        }
+        m_preview_userptr_queued &= ~(1 << index);
+        return index;
+    }
+
+    index = fimc_v4l2_dqbuf(m_cam_fd, V4L2_MEMORY_MMAP, &m_preview_stats);
+    dqbuf.stop();
     if (!(0 <= index && index < MAX_BUFFERS)) {
         ALOGE("ERR(%s):wrong index = %d\n", __func__, index);
         return -1;
     }
 
+    if (m_preview_hold) {
+        android_atomic_or(1 << index, &m_preview_held);
+        return index;
+    }
+
     ret = fimc_v4l2_qbuf(m_cam_fd, index);
     CHECK(ret);
 
     return index;
 }
 
+nsecs_t SecCamera::getPreviewTimestamp(void)
+{
+    return m_preview_stats.timestamp;
+}
+
+/* smoothed interval between preview frames as delivered, 0 until known */
+nsecs_t SecCamera::getPreviewFramePeriod(void)
+{
+    return m_preview_stats.period;
+}
+
+int SecCamera::releasePreviewFrame(int index)
+{
+    if (!isPreviewUserPtr()) {
+        if (!(0 <= index && index < MAX_BUFFERS))
+            return -1;
+        /* not held, or the stream was restarted since */
+        if (!(android_atomic_and(~(1 << index), &m_preview_held) & (1 << index)))
+            return 0;
+        if (!m_flag_camera_start)
+            return 0;
+        return fimc_v4l2_qbuf(m_cam_fd, index);
+    }
+
+    if (!(0 <= index && index < MAX_BUFFERS) || !m_preview_userptr[index]) {
+        ALOGE("ERR(%s):wrong index = %d\n", __func__, index);
+        return -1;
+    }
+
+    m_preview_userptr_queued |= (1 << index);
+    if (!m_flag_camera_start)
+        return 0;
+
+    return fimc_v4l2_qbuf_userptr(m_cam_fd, index, m_preview_userptr[index],
+                                  m_preview_userptr_length);
+}
+
+/*
+ * Register a caller owned buffer (a gralloc buffer of the preview window)
+ * as preview capture slot 'index'.  Once any slot is registered the next
+ * startPreview() requests USERPTR buffers in YV12 instead of mmap'ing the
+ * FIMC buffers.  The buffer is handed to the camera right away.
+ */
+int SecCamera::setPreviewUserPtr(int index, unsigned long userptr, size_t length)
+{
+    ALOGV("%s(index(%d), userptr(%#lx), length(%d))", __func__, index, userptr, length);
+
+    if (!(0 <= index && index < MAX_BUFFERS) || !userptr) {
+        ALOGE("ERR(%s):Invalid index(%d) or userptr", __func__, index);
+        return -1;
+    }
+
+    m_preview_userptr[index] = userptr;
+    m_preview_userptr_length = length;
+
+    return releasePreviewFrame(index);
+}
+
+void SecCamera::clearPreviewUserPtrs(void)
+{
+    ALOGV("%s :", __func__);
+
+    memset(m_preview_userptr, 0, sizeof(m_preview_userptr));
+    m_preview_userptr_length = 0;
+    m_preview_userptr_queued = 0;
+}
+
+bool SecCamera::isPreviewUserPtr(void)
+{
+    return m_preview_userptr_length != 0;
+}
+
+/*
+ * With hold set, getPreview() leaves the mmap'ed buffers it returns with
+ * the caller until releasePreviewFrame(), as it does for user pointers.
+ * Takes effect with the next frame; buffers already held still have to be
+ * released.
+ */
+void SecCamera::setPreviewHold(bool hold)
+{
+    ALOGV("%s(%d)", __func__, hold);
+    m_preview_hold = hold;
+}
+
 int SecCamera::getRecordFrame()
 {
     if (m_flag_record_start == 0) {
@@ -1103,8 +1515,30 @@ int SecCamera::getRecordFrame()
         return -1;
     }
 
-    previewPoll(false);
-    return fimc_v4l2_dqbuf(m_cam_fd2);
+    if (m_record_queued <= 0) {
+        ALOGE("ERR(%s):no record buffer queued", __func__);
+        return -1;
+    }
+
+    if (previewPoll(false) <= 0)
+        return -1;
+
+    SecCameraStats::Timer dqbuf(STAGE_RECORD_DQBUF);
+    int index = fimc_v4l2_dqbuf(m_cam_fd2, V4L2_MEMORY_MMAP, &m_record_stats);
+    if (index >= 0)
+        m_record_queued--;
+    return index;
+}
+
+/* record buffers getRecordFrame() can still dequeue */
+int SecCamera::getRecordQueued(void)
+{
+    return m_record_queued;
+}
+
+nsecs_t SecCamera::getRecordTimestamp(void)
+{
+    return m_record_stats.timestamp;
 }
 
 int SecCamera::releaseRecordFrame(int index)
@@ -1120,7 +1554,10 @@ int SecCamera::releaseRecordFrame(int index)
         return 0;
     }
 
-    return fimc_v4l2_qbuf(m_cam_fd2, index);
+    int ret = fimc_v4l2_qbuf(m_cam_fd2, index);
+    if (ret == 0)
+        m_record_queued++;
+    return ret;
 }
 
 int SecCamera::setPreviewSize(int width, int height, int pixel_format)
@@ -1183,33 +1620,29 @@ int SecCamera::getPreviewPixelFormat(void)
  * Devide getJpeg() as two funcs, setSnapshotCmd() & getJpeg() because of the shutter sound timing.
  * Here, just send the capture cmd to camera ISP to start JPEG capture.
  */
-int SecCamera::setSnapshotCmd(void)
+int SecCamera::setSnapshotCmd(int nframe)
 {
     ALOGV("%s :", __func__);
 
     int ret = 0;
 
-    LOG_TIME_DEFINE(0)
-    LOG_TIME_DEFINE(1)
-
     if (m_cam_fd <= 0) {
         ALOGE("ERR(%s):Camera was closed\n", __func__);
         return 0;
     }
 
     if (m_flag_camera_start > 0) {
-        LOG_TIME_START(0)
         ALOGW("WARN(%s):Camera was in preview, should have been stopped\n", __func__);
         stopPreview();
-        LOG_TIME_END(0)
     }
 
     memset(&m_events_c, 0, sizeof(m_events_c));
     m_events_c.fd = m_cam_fd;
     m_events_c.events = POLLIN | POLLERR;
 
-    LOG_TIME_START(1) // prepare
-    int nframe = 1;
+    SecCameraStats::Timer prepare(STAGE_SNAPSHOT_PREPARE);
+    if (nframe > MAX_BURST_BUFFERS)
+        nframe = MAX_BURST_BUFFERS;
 
     ret = fimc_v4l2_enum_fmt(m_cam_fd,m_snapshot_v4lformat);
     CHECK(ret);
@@ -1217,11 +1650,19 @@ int SecCamera::setSnapshotCmd(void)
     CHECK(ret);
     ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nframe);
     CHECK(ret);
-    ret = fimc_v4l2_querybuf(m_cam_fd, &m_capture_buf, V4L2_BUF_TYPE_VIDEO_CAPTURE);
-    CHECK(ret);
+    if (ret < 1 || ret > nframe) {
+        ALOGE("ERR(%s):driver gave us %d capture buffers\n", __func__, ret);
+        return -1;
+    }
+    m_capture_nframe = ret;
 
-    ret = fimc_v4l2_qbuf(m_cam_fd, 0);
-    CHECK(ret);
+    for (int i = 0; i < m_capture_nframe; i++) {
+        ret = fimc_v4l2_querybuf(m_cam_fd, &m_capture_buf[i], V4L2_BUF_TYPE_VIDEO_CAPTURE, i);
+        CHECK(ret);
+
+        ret = fimc_v4l2_qbuf(m_cam_fd, i);
+        CHECK(ret);
+    }
 
     ret = fimc_v4l2_streamon(m_cam_fd);
     CHECK(ret);
@@ -1273,8 +1714,6 @@ int SecCamera::setSnapshotCmd(void)
     ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_CAPTURE, 0);
     CHECK(ret);
 
-    LOG_TIME_END(1)
-
     return 0;
 }
 
@@ -1283,16 +1722,90 @@ int SecCamera::endSnapshot(void)
     int ret;
 
     ALOGI("%s :", __func__);
-    if (m_capture_buf.start) {
-        munmap(m_capture_buf.start, m_capture_buf.length);
-        ALOGI("munmap():virt. addr %p size = %d\n",
-             m_capture_buf.start, m_capture_buf.length);
-        m_capture_buf.start = NULL;
-        m_capture_buf.length = 0;
+    for (int i = 0; i < m_capture_nframe; i++) {
+        if (m_capture_buf[i].start) {
+            fimc_dev_munmap(m_capture_buf[i].start, m_capture_buf[i].length);
+            ALOGI("munmap():virt. addr %p size = %d\n",
+                 m_capture_buf[i].start, m_capture_buf[i].length);
+            m_capture_buf[i].start = NULL;
+            m_capture_buf[i].length = 0;
+        }
+    }
+    m_capture_nframe = 0;
+    return 0;
+}
+
+/*
+ * Burst capture: after setSnapshotCmd(n) the JPEG capture stream stays on
+ * with up to n buffers.  getBurstJpeg() hands out the next JPEG and its
+ * buffer index, triggerBurstCapture() asks the ISP for the next frame and
+ * releaseBurstJpeg() gives a buffer back once its data has been copied.
+ * stopBurst() turns the stream off; endSnapshot() unmaps the buffers.
+ */
+unsigned char* SecCamera::getBurstJpeg(int *jpeg_size, int *index)
+{
+    ALOGV("%s :", __func__);
+
+    int ret;
+
+    SecCameraStats::Timer capture(STAGE_SNAPSHOT_CAPTURE);
+    ret = fimc_poll(&m_events_c);
+    CHECK_PTR(ret);
+    *index = fimc_v4l2_dqbuf(m_cam_fd);
+    capture.stop();
+    if (!(0 <= *index && *index < m_capture_nframe)) {
+        ALOGE("ERR(%s):wrong index = %d\n", __func__, *index);
+        return NULL;
+    }
+
+    /* read these before the next capture is triggered */
+    *jpeg_size = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAM_JPEG_MAIN_SIZE);
+    CHECK_PTR(*jpeg_size);
+    int main_offset = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAM_JPEG_MAIN_OFFSET);
+    CHECK_PTR(main_offset);
+    m_postview_offset = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAM_JPEG_POSTVIEW_OFFSET);
+    CHECK_PTR(m_postview_offset);
+
+    ALOGV("%s: dequeued buffer = %d, size = %d", __func__, *index, *jpeg_size);
+
+    return (unsigned char*)(m_capture_buf[*index].start) + main_offset;
+}
+
+int SecCamera::triggerBurstCapture(void)
+{
+    ALOGV("%s :", __func__);
+
+    int ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_CAPTURE, 0);
+    CHECK(ret);
+    return 0;
+}
+
+int SecCamera::releaseBurstJpeg(int index)
+{
+    if (!(0 <= index && index < m_capture_nframe)) {
+        ALOGE("ERR(%s):wrong index = %d\n", __func__, index);
+        return -1;
     }
+
+    return fimc_v4l2_qbuf(m_cam_fd, index);
+}
+
+int SecCamera::stopBurst(void)
+{
+    ALOGV("%s :", __func__);
+
+    int ret = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
+    CHECK(ret);
+    ret = fimc_v4l2_streamoff(m_cam_fd);
+    CHECK(ret);
     return 0;
 }
 
+int SecCamera::getCaptureBufferCount(void)
+{
+    return m_capture_nframe;
+}
+
 /*
  * Set Jpeg quality & exif info and get JPEG data from camera ISP
  */
@@ -1303,12 +1816,12 @@ unsigned char* SecCamera::getJpeg(int *jpeg_size, unsigned int *phyaddr)
     int index, ret = 0;
     unsigned char *addr;
 
-    LOG_TIME_DEFINE(2)
-
     // capture
+    SecCameraStats::Timer capture(STAGE_SNAPSHOT_CAPTURE);
     ret = fimc_poll(&m_events_c);
     CHECK_PTR(ret);
     index = fimc_v4l2_dqbuf(m_cam_fd);
+    capture.stop();
     if (index != 0) {
         ALOGE("ERR(%s):wrong index = %d\n", __func__, index);
         return NULL;
@@ -1327,24 +1840,62 @@ unsigned char* SecCamera::getJpeg(int *jpeg_size, unsigned int *phyaddr)
     ALOGV("\nsnapshot dqueued buffer = %d snapshot_width = %d snapshot_height = %d, size = %d\n\n",
             index, m_snapshot_width, m_snapshot_height, *jpeg_size);
 
-    addr = (unsigned char*)(m_capture_buf.start) + main_offset;
+    addr = (unsigned char*)(m_capture_buf[0].start) + main_offset;
     *phyaddr = getPhyAddrY(index) + m_postview_offset;
 
-    LOG_TIME_START(2) // post
+    SecCameraStats::Timer post(STAGE_SNAPSHOT_POST);
     ret = fimc_v4l2_streamoff(m_cam_fd);
     CHECK_PTR(ret);
-    LOG_TIME_END(2)
 
     return addr;
 }
 
-int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc)
+/*
+ * Snapshot the EXIF attributes of the current capture, so that the EXIF
+ * block can be built later while the parameters move on to the next shot.
+ */
+void SecCamera::getExifInfo(exif_attribute_t *exifInfo)
+{
+    /* only depends on the build and the sensor, filled on first use */
+    if (m_exif_fixed_id != m_camera_id) {
+        char verify[PROPERTY_VALUE_MAX];
+
+        setExifFixedAttribute();
+        m_exif_fixed_id = m_camera_id;
+
+        property_get("camera.debug.exif.verify", verify, "0");
+        Mutex::Autolock lock(m_jpeg_lock);
+        m_exif_template.invalidate();
+        m_exif_verify = atoi(verify) != 0;
+    }
+    setExifChangedAttribute();
+    mExifInfo.enableThumb = (m_jpeg_thumbnail_width > 0) && (m_jpeg_thumbnail_height > 0);
+    *exifInfo = mExifInfo;
+}
+
+/*
+ * pThumbSrc is a YUYV thumbnail of thumbWidth x thumbHeight.  Returns the
+ * size of the APP1 block written to pExifDst, or, when the block would not
+ * fit in exifSize bytes, the space it needs, with nothing written.  Only a
+ * shot matching the EXIF template has a size known up front; any other
+ * needs EXIF_MAX_BUILD_SIZE for makeExif().
+ */
+int SecCamera::getExif(unsigned char *pExifDst, unsigned int exifSize,
+                       unsigned char *pThumbSrc, int thumbWidth, int thumbHeight,
+                       exif_attribute_t *exifInfo)
 {
+    Mutex::Autolock lock(m_jpeg_lock);
     JpegEncoder jpgEnc;
 
-    ALOGV("%s : m_jpeg_thumbnail_width = %d, height = %d",
-         __func__, m_jpeg_thumbnail_width, m_jpeg_thumbnail_height);
-    if ((m_jpeg_thumbnail_width > 0) && (m_jpeg_thumbnail_height > 0)) {
+    if (exifSize < EXIF_MAX_BUILD_SIZE &&
+        !m_exif_template.matches(exifInfo, exifInfo->enableThumb))
+        return EXIF_MAX_BUILD_SIZE;
+
+    unsigned char *thumbBuf = NULL;
+    unsigned int thumbSize = 0;
+
+    ALOGV("%s : enableThumb = %d", __func__, exifInfo->enableThumb);
+    if (exifInfo->enableThumb) {
         int inFormat = JPG_MODESEL_YCBCR;
         int outFormat = JPG_422;
         switch (m_snapshot_v4lformat) {
@@ -1370,8 +1921,7 @@ int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc)
         if (jpgEnc.setConfig(JPEG_SET_ENCODE_QUALITY, JPG_QUALITY_LEVEL_2) != JPG_SUCCESS)
             return -1;
 
-        int thumbWidth, thumbHeight, thumbSrcSize;
-        getThumbnailConfig(&thumbWidth, &thumbHeight, &thumbSrcSize);
+        int thumbSrcSize = thumbWidth * thumbHeight * 2;
         if (jpgEnc.setConfig(JPEG_SET_ENCODE_WIDTH, thumbWidth) != JPG_SUCCESS)
             return -1;
 
@@ -1383,27 +1933,64 @@ int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc)
             return -1;
         memcpy(pInBuf, pThumbSrc, thumbSrcSize);
 
-        unsigned int thumbSize;
+        uint64_t thumbBufSize;
 
         jpgEnc.encode(&thumbSize, NULL);
+        thumbBuf = (unsigned char *)jpgEnc.getOutBuf(&thumbBufSize);
+    }
 
-        ALOGV("%s : enableThumb set to true", __func__);
-        mExifInfo.enableThumb = true;
-    } else {
-        ALOGV("%s : enableThumb set to false", __func__);
-        mExifInfo.enableThumb = false;
+    /* makeExif() leaves the thumbnail out if the encoder gave none */
+    bool thumb = exifInfo->enableThumb && thumbBuf != NULL && thumbSize != 0;
+    unsigned int size;
+
+    if (m_exif_template.matches(exifInfo, thumb)) {
+        size = m_exif_template.size(thumbSize);
+        if (size > exifSize)
+            return size;
+        size = m_exif_template.make(pExifDst, exifInfo, thumbBuf, thumbSize);
+        if (m_exif_verify)
+            verifyExif(jpgEnc, pExifDst, size, exifInfo);
+        return size;
     }
 
-    unsigned int exifSize;
+    /* the encoder gave no thumbnail after all, the template's layout has one */
+    if (exifSize < EXIF_MAX_BUILD_SIZE)
+        return EXIF_MAX_BUILD_SIZE;
 
-    setExifChangedAttribute();
+    ALOGV("%s: calling jpgEnc.makeExif, width set to %d, height to %d\n",
+         __func__, exifInfo->width, exifInfo->height);
+
+    jpgEnc.makeExif(pExifDst, exifInfo, &size, true);
+    m_exif_template.build(pExifDst, size, exifInfo, thumb);
 
-    ALOGV("%s: calling jpgEnc.makeExif, mExifInfo.width set to %d, height to %d\n",
-         __func__, mExifInfo.width, mExifInfo.height);
+    return size;
+}
+
+/*
+ * Debug check of the EXIF template: builds the same block with makeExif()
+ * and drops the template if they differ.  makeExif() modifies the user
+ * comment, so it runs on a copy of the attributes.
+ */
+void SecCamera::verifyExif(JpegEncoder& jpgEnc, const unsigned char *exif,
+                           unsigned int size, const exif_attribute_t *exifInfo)
+{
+    unsigned char *ref = (unsigned char *)malloc(EXIF_MAX_BUILD_SIZE);
+    exif_attribute_t info = *exifInfo;
+    unsigned int refSize;
 
-    jpgEnc.makeExif(pExifDst, &mExifInfo, &exifSize, true);
+    if (ref == NULL)
+        return;
 
-    return exifSize;
+    jpgEnc.makeExif(ref, &info, &refSize, true);
+    if (refSize != size || memcmp(ref, exif, size)) {
+        unsigned int i = 0;
+        while (i < size && i < refSize && ref[i] == exif[i])
+            i++;
+        ALOGE("ERR(%s):EXIF template differs from makeExif() at byte %d (size %d, expected %d)",
+              __func__, i, size, refSize);
+        m_exif_template.invalidate();
+    }
+    free(ref);
 }
 
 void SecCamera::getPostViewConfig(int *width, int *height, int *size)
@@ -1441,8 +2028,11 @@ int SecCamera::getPostViewOffset(void)
     return m_postview_offset;
 }
 
-int SecCamera::getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
-                                            unsigned int *output_size)
+/*
+ * Capture a single YUV frame from the front camera into yuv_buf, which
+ * must hold m_snapshot_width * m_snapshot_height * 2 bytes.
+ */
+int SecCamera::getSnapshot(unsigned char *yuv_buf)
 {
     ALOGV("%s :", __func__);
 
@@ -1451,13 +2041,6 @@ int SecCamera::getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_bu
     unsigned char *addr;
     int ret = 0;
 
-    LOG_TIME_DEFINE(0)
-    LOG_TIME_DEFINE(1)
-    LOG_TIME_DEFINE(2)
-    LOG_TIME_DEFINE(3)
-    LOG_TIME_DEFINE(4)
-    LOG_TIME_DEFINE(5)
-
     //fimc_v4l2_streamoff(m_cam_fd); [zzangdol] remove - it is separate in HWInterface with camera_id
 
     if (m_cam_fd <= 0) {
@@ -1466,10 +2049,8 @@ int SecCamera::getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_bu
     }
 
     if (m_flag_camera_start > 0) {
-        LOG_TIME_START(0)
         ALOGW("WARN(%s):Camera was in preview, should have been stopped\n", __func__);
         stopPreview();
-        LOG_TIME_END(0)
     }
 
     memset(&m_events_c, 0, sizeof(m_events_c));
@@ -1497,7 +2078,7 @@ int SecCamera::getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_bu
         ALOGV("SnapshotFormat:UnknownFormat");
 #endif
 
-    LOG_TIME_START(1) // prepare
+    SecCameraStats::Timer prepare(STAGE_SNAPSHOT_PREPARE);
     int nframe = 1;
 
     ret = fimc_v4l2_enum_fmt(m_cam_fd,m_snapshot_v4lformat);
@@ -1511,36 +2092,51 @@ int SecCamera::getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_bu
     CHECK(ret);
     ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nframe);
     CHECK(ret);
-    ret = fimc_v4l2_querybuf(m_cam_fd, &m_capture_buf, V4L2_BUF_TYPE_VIDEO_CAPTURE);
+    ret = fimc_v4l2_querybuf(m_cam_fd, &m_capture_buf[0], V4L2_BUF_TYPE_VIDEO_CAPTURE);
     CHECK(ret);
+    m_capture_nframe = 1;
 
     ret = fimc_v4l2_qbuf(m_cam_fd, 0);
     CHECK(ret);
 
     ret = fimc_v4l2_streamon(m_cam_fd);
     CHECK(ret);
-    LOG_TIME_END(1)
+    prepare.stop();
 
-    LOG_TIME_START(2) // capture
+    SecCameraStats::Timer capture(STAGE_SNAPSHOT_CAPTURE);
     fimc_poll(&m_events_c);
     index = fimc_v4l2_dqbuf(m_cam_fd);
     fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
     ALOGV("\nsnapshot dequeued buffer = %d snapshot_width = %d snapshot_height = %d\n\n",
             index, m_snapshot_width, m_snapshot_height);
 
-    LOG_TIME_END(2)
-
     ALOGI("%s : calling memcpy from m_capture_buf", __func__);
-    memcpy(yuv_buf, (unsigned char*)m_capture_buf.start, m_snapshot_width * m_snapshot_height * 2);
-    LOG_TIME_START(5) // post
+    memcpy(yuv_buf, (unsigned char*)m_capture_buf[0].start, m_snapshot_width * m_snapshot_height * 2);
+    capture.stop();
+
+    SecCameraStats::Timer post(STAGE_SNAPSHOT_POST);
     fimc_v4l2_streamoff(m_cam_fd);
-    LOG_TIME_END(5)
 
-    LOG_CAMERA("getSnapshotAndJpeg intervals : stopPreview(%lu), prepare(%lu),"
-                " capture(%lu), memcpy(%lu), yuv2Jpeg(%lu), post(%lu)  us",
-                    LOG_TIME(0), LOG_TIME(1), LOG_TIME(2), LOG_TIME(3), LOG_TIME(4), LOG_TIME(5));
-    /* JPEG encoding */
-    JpegEncoder jpgEnc;
+    return 0;
+}
+
+/*
+ * Encode a YUV snapshot with the hardware JPEG block.  On success jpeg
+ * refers to the encoder's own output buffer and keeps the encoder until it
+ * is released, so the caller can copy the stream straight to where it is
+ * needed instead of going through an intermediate buffer.
+ */
+int SecCamera::encodeSnapshot(unsigned char *yuv_buf, int width, int height, int quality,
+                              SnapshotJpeg *jpeg)
+{
+    ALOGV("%s(width(%d), height(%d), quality(%d))", __func__, width, height, quality);
+
+    jpeg->release();
+    m_jpeg_lock.lock();
+    jpeg->mLock = &m_jpeg_lock;
+    jpeg->mEncoder = new JpegEncoder;
+    JpegEncoder &jpgEnc = *jpeg->mEncoder;
+
     int inFormat = JPG_MODESEL_YCBCR;
     int outFormat = JPG_422;
 
@@ -1566,48 +2162,60 @@ int SecCamera::getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_bu
         ALOGE("[JPEG_SET_SAMPING_MODE] Error\n");
 
     image_quality_type_t jpegQuality;
-    if (m_jpeg_quality >= 90)
+    if (quality >= 90)
         jpegQuality = JPG_QUALITY_LEVEL_1;
-    else if (m_jpeg_quality >= 80)
+    else if (quality >= 80)
         jpegQuality = JPG_QUALITY_LEVEL_2;
-    else if (m_jpeg_quality >= 70)
+    else if (quality >= 70)
         jpegQuality = JPG_QUALITY_LEVEL_3;
     else
         jpegQuality = JPG_QUALITY_LEVEL_4;
 
     if (jpgEnc.setConfig(JPEG_SET_ENCODE_QUALITY, jpegQuality) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_QUALITY] Error\n");
-    if (jpgEnc.setConfig(JPEG_SET_ENCODE_WIDTH, m_snapshot_width) != JPG_SUCCESS)
+    if (jpgEnc.setConfig(JPEG_SET_ENCODE_WIDTH, width) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_WIDTH] Error\n");
 
-    if (jpgEnc.setConfig(JPEG_SET_ENCODE_HEIGHT, m_snapshot_height) != JPG_SUCCESS)
+    if (jpgEnc.setConfig(JPEG_SET_ENCODE_HEIGHT, height) != JPG_SUCCESS)
         ALOGE("[JPEG_SET_ENCODE_HEIGHT] Error\n");
 
-    unsigned int snapshot_size = m_snapshot_width * m_snapshot_height * 2;
+    unsigned int snapshot_size = width * height * 2;
     unsigned char *pInBuf = (unsigned char *)jpgEnc.getInBuf(snapshot_size);
 
     if (pInBuf == NULL) {
         ALOGE("JPEG input buffer is NULL!!\n");
+        jpeg->release();
         return -1;
     }
     memcpy(pInBuf, yuv_buf, snapshot_size);
 
-    setExifChangedAttribute();
-    jpgEnc.encode(output_size, NULL);
+    jpgEnc.encode(&jpeg->mSize, NULL);
 
     uint64_t outbuf_size;
-    unsigned char *pOutBuf = (unsigned char *)jpgEnc.getOutBuf(&outbuf_size);
+    jpeg->mData = (unsigned char *)jpgEnc.getOutBuf(&outbuf_size);
 
-    if (pOutBuf == NULL) {
+    if (jpeg->mData == NULL || jpeg->mSize > outbuf_size) {
         ALOGE("JPEG output buffer is NULL!!\n");
+        jpeg->release();
         return -1;
     }
 
-    memcpy(jpeg_buf, pOutBuf, outbuf_size);
-
     return 0;
 }
 
+void SecCamera::SnapshotJpeg::release(void)
+{
+    delete mEncoder;
+    mEncoder = NULL;
+    mData = NULL;
+    mSize = 0;
+    if (mLock) {
+        mLock->unlock();
+        mLock = NULL;
+    }
+}
+
+
 
 int SecCamera::setSnapshotSize(int width, int height)
 {
@@ -1718,30 +2326,54 @@ int SecCamera::setAutofocus(void)
         return -1;
     }
 
+    m_af_lock.lock();
+    m_af_state = AF_STATE_SEARCHING;
+    m_af_lock.unlock();
+
     return 0;
 }
 
+/*
+ * The sensor has no completion event for the 1st AF search, so its status
+ * still has to be polled.  Most searches finish within a few hundred ms, so
+ * poll often at first and back off towards a frame period after that.  The
+ * wait is on m_af_cond rather than a sleep so cancelAutofocus() ends it
+ * right away.
+ *
+ * Returns 1 on success, 0 on failure or timeout and 2 when cancelled.
+ */
 int SecCamera::getAutoFocusResult(void)
 {
-    int af_result, count, ret;
+    int af_result, ret = AF_PROGRESS;
+    nsecs_t start = systemTime();
+    nsecs_t elapsed = 0;
+    nsecs_t delay = AF_POLL_MIN_DELAY;
 
-    for (count = 0; count < FIRST_AF_SEARCH_COUNT; count++) {
+    m_af_lock.lock();
+    while (m_af_state == AF_STATE_SEARCHING && elapsed < AF_TIMEOUT) {
         ret = fimc_v4l2_g_ctrl(m_cam_fd, V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST);
         if (ret != AF_PROGRESS)
             break;
-        usleep(AF_DELAY);
+
+        if (elapsed >= AF_POLL_FAST_PERIOD)
+            delay = MIN(delay * 2, AF_POLL_MAX_DELAY);
+        m_af_cond.waitRelative(m_af_lock, delay);
+        elapsed = systemTime() - start;
     }
 
-    if ((count >= FIRST_AF_SEARCH_COUNT) || (ret != AF_SUCCESS)) {
-        ALOGV("%s : 1st AF timed out, failed, or was canceled", __func__);
+    if (m_af_state == AF_STATE_CANCELLING) {
+        ALOGV("%s : AF was canceled", __func__);
+        af_result = 2;
+    } else if (ret != AF_SUCCESS) {
+        ALOGV("%s : 1st AF timed out or failed", __func__);
         af_result = 0;
-        goto finish_auto_focus;
+    } else {
+        af_result = 1;
+        ALOGV("%s : AF was successful, returning %d", __func__, af_result);
     }
+    m_af_state = AF_STATE_IDLE;
+    m_af_lock.unlock();
 
-    af_result = 1;
-    ALOGV("%s : AF was successful, returning %d", __func__, af_result);
-
-finish_auto_focus:
     if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FINISH_AUTO_FOCUS, 0) < 0) {
         ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FINISH_AUTO_FOCUS", __func__);
         return -1;
@@ -1758,6 +2390,14 @@ int SecCamera::cancelAutofocus(void)
         return -1;
     }
 
+    /* stop the poll loop in getAutoFocusResult() without waiting out its delay */
+    m_af_lock.lock();
+    if (m_af_state == AF_STATE_SEARCHING) {
+        m_af_state = AF_STATE_CANCELLING;
+        m_af_cond.signal();
+    }
+    m_af_lock.unlock();
+
     if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_AUTO_FOCUS, AUTO_FOCUS_OFF) < 0) {
         ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SET_AUTO_FOCUS", __func__);
         return -1;
@@ -1841,16 +2481,49 @@ int SecCamera::setFrameRate(int frame_rate)
     if (m_params->capture.timeperframe.denominator != (unsigned)frame_rate) {
         m_params->capture.timeperframe.denominator = frame_rate;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FRAME_RATE, frame_rate) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_FRAME_RATE, frame_rate) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FRAME_RATE", __func__);
                 return -1;
             }
+            m_sensor_frame_rate = frame_rate;
+            m_preview_stats.settle = FRAME_RATE_SETTLE_FRAMES;
+        }
+    }
+
+    return 0;
+}
+
+int SecCamera::getFrameRate(void)
+{
+    return m_params->capture.timeperframe.denominator;
+}
+
+int SecCamera::setSensorFrameRate(int frame_rate)
+{
+    ALOGV("%s(FrameRate(%d))", __func__, frame_rate);
+
+    if (!m_flag_camera_start) {
+        ALOGE("ERR(%s):Preview not started", __func__);
+        return -1;
+    }
+
+    if (m_sensor_frame_rate != frame_rate) {
+        if (setSensorCtrl(V4L2_CID_CAMERA_FRAME_RATE, frame_rate) < 0) {
+            ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FRAME_RATE", __func__);
+            return -1;
         }
+        m_sensor_frame_rate = frame_rate;
+        m_preview_stats.settle = FRAME_RATE_SETTLE_FRAMES;
     }
 
     return 0;
 }
 
+int SecCamera::getSensorFrameRate(void)
+{
+    return m_sensor_frame_rate;
+}
+
 // -----------------------------------
 
 int SecCamera::setVerticalMirror(void)
@@ -1901,7 +2574,7 @@ int SecCamera::setWhiteBalance(int white_balance)
     if (m_params->white_balance != white_balance) {
         m_params->white_balance = white_balance;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_WHITE_BALANCE, white_balance) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_WHITE_BALANCE, white_balance) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_WHITE_BALANCE", __func__);
                 return -1;
             }
@@ -1933,7 +2606,7 @@ int SecCamera::setBrightness(int brightness)
     if (m_params->brightness != brightness) {
         m_params->brightness = brightness;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BRIGHTNESS, brightness) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_BRIGHTNESS, brightness) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_BRIGHTNESS", __func__);
                 return -1;
             }
@@ -1963,7 +2636,7 @@ int SecCamera::setImageEffect(int image_effect)
     if (m_params->effects != image_effect) {
         m_params->effects = image_effect;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_EFFECT, image_effect) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_EFFECT, image_effect) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_EFFECT", __func__);
                 return -1;
             }
@@ -1992,7 +2665,7 @@ int SecCamera::setAntiBanding(int anti_banding)
     if (m_anti_banding != anti_banding) {
         m_anti_banding = anti_banding;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ANTI_BANDING, anti_banding) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_ANTI_BANDING, anti_banding) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ANTI_BANDING", __func__);
                  return -1;
             }
@@ -2019,6 +2692,8 @@ int SecCamera::setSceneMode(int scene_mode)
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SCENE_MODE", __func__);
                 return -1;
             }
+            /* scene presets override the ISP's own settings */
+            invalidateCtrlCache();
         }
     }
 
@@ -2044,7 +2719,7 @@ int SecCamera::setFlashMode(int flash_mode)
     if (m_params->flash_mode != flash_mode) {
         m_params->flash_mode = flash_mode;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FLASH_MODE, flash_mode) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_FLASH_MODE, flash_mode) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FLASH_MODE", __func__);
                 return -1;
             }
@@ -2072,7 +2747,7 @@ int SecCamera::setISO(int iso_value)
     if (m_params->iso != iso_value) {
         m_params->iso = iso_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ISO, iso_value) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_ISO, iso_value) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ISO", __func__);
                 return -1;
             }
@@ -2101,7 +2776,7 @@ int SecCamera::setContrast(int contrast_value)
     if (m_params->contrast != contrast_value) {
         m_params->contrast = contrast_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_CONTRAST, contrast_value) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_CONTRAST, contrast_value) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_CONTRAST", __func__);
                 return -1;
             }
@@ -2130,7 +2805,7 @@ int SecCamera::setSaturation(int saturation_value)
     if (m_params->saturation != saturation_value) {
         m_params->saturation = saturation_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SATURATION, saturation_value) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_SATURATION, saturation_value) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SATURATION", __func__);
                 return -1;
             }
@@ -2159,7 +2834,7 @@ int SecCamera::setSharpness(int sharpness_value)
     if (m_params->sharpness != sharpness_value) {
         m_params->sharpness = sharpness_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SHARPNESS, sharpness_value) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_SHARPNESS, sharpness_value) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SHARPNESS", __func__);
                 return -1;
             }
@@ -2192,6 +2867,8 @@ int SecCamera::setWDR(int wdr_value)
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_WDR", __func__);
                 return -1;
             }
+            /* WDR retunes the ISP's exposure and tone settings */
+            invalidateCtrlCache();
         }
     }
 
@@ -2221,6 +2898,8 @@ int SecCamera::setAntiShake(int anti_shake)
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ANTI_SHAKE", __func__);
                 return -1;
             }
+            /* anti-shake switches the ISP's exposure settings */
+            invalidateCtrlCache();
         }
     }
 
@@ -2247,7 +2926,7 @@ int SecCamera::setMetering(int metering_value)
     if (m_params->metering != metering_value) {
         m_params->metering = metering_value;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_METERING, metering_value) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_METERING, metering_value) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_METERING", __func__);
                 return -1;
             }
@@ -2305,7 +2984,7 @@ int SecCamera::setZoom(int zoom_level)
     if (m_zoom_level != zoom_level) {
         m_zoom_level = zoom_level;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_ZOOM, zoom_level) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_ZOOM, zoom_level) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_ZOOM", __func__);
                 return -1;
             }
@@ -2399,6 +3078,8 @@ int SecCamera::setSmartAuto(int smart_auto)
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SMART_AUTO", __func__);
                 return -1;
             }
+            /* smart auto picks scene presets of its own */
+            invalidateCtrlCache();
         }
     }
 
@@ -2439,7 +3120,7 @@ int SecCamera::setBeautyShot(int beauty_shot)
     if (m_beauty_shot != beauty_shot) {
         m_beauty_shot = beauty_shot;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_BEAUTY_SHOT, beauty_shot) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_BEAUTY_SHOT, beauty_shot) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_BEAUTY_SHOT", __func__);
                 return -1;
             }
@@ -2500,7 +3181,7 @@ int SecCamera::setFocusMode(int focus_mode)
         m_params->focus_mode = focus_mode;
 
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FOCUS_MODE, focus_mode) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_FOCUS_MODE, focus_mode) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FOCUS_MODE", __func__);
                 return -1;
             }
@@ -2525,12 +3206,12 @@ int SecCamera::setFaceDetect(int face_detect)
         m_face_detect = face_detect;
         if (m_flag_camera_start) {
             if (m_face_detect != FACE_DETECTION_OFF) {
-                if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FOCUS_MODE, FOCUS_MODE_AUTO) < 0) {
+                if (setSensorCtrl(V4L2_CID_CAMERA_FOCUS_MODE, FOCUS_MODE_AUTO) < 0) {
                     ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FOCUS_MODin face detecion", __func__);
                     return -1;
                 }
             }
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_FACE_DETECTION, face_detect) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_FACE_DETECTION, face_detect) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_FACE_DETECTION", __func__);
                 return -1;
             }
@@ -2701,7 +3382,7 @@ int SecCamera::setGamma(int gamma)
      if (m_video_gamma != gamma) {
          m_video_gamma = gamma;
          if (m_flag_camera_start) {
-             if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_GAMMA, gamma) < 0) {
+             if (setSensorCtrl(V4L2_CID_CAMERA_SET_GAMMA, gamma) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SET_GAMMA", __func__);
                  return -1;
              }
@@ -2725,7 +3406,7 @@ int SecCamera::setSlowAE(int slow_ae)
      if (m_slow_ae!= slow_ae) {
          m_slow_ae = slow_ae;
          if (m_flag_camera_start) {
-             if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_SET_SLOW_AE, slow_ae) < 0) {
+             if (setSensorCtrl(V4L2_CID_CAMERA_SET_SLOW_AE, slow_ae) < 0) {
                  ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_SET_SLOW_AE", __func__);
                  return -1;
              }
@@ -2845,7 +3526,7 @@ int SecCamera::setBlur(int blur_level)
     if (m_blur_level != blur_level) {
         m_blur_level = blur_level;
         if (m_flag_camera_start) {
-            if (fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CAMERA_VGA_BLUR, blur_level) < 0) {
+            if (setSensorCtrl(V4L2_CID_CAMERA_VGA_BLUR, blur_level) < 0) {
                 ALOGE("ERR(%s):Fail on V4L2_CID_CAMERA_VGA_BLUR", __func__);
                 return -1;
             }
@@ -2895,7 +3576,9 @@ const __u8* SecCamera::getCameraSensorName(void)
 {
     ALOGV("%s", __func__);
 
-    return fimc_v4l2_enuminput(m_cam_fd, getCameraId());
+    if (m_camera_id < 0 || m_camera_id >= MAX_CAMERA_INPUTS)
+        return NULL;
+    return m_input_names[m_camera_id];
 }
 
 #ifdef ENABLE_ESD_PREVIEW_CHECK
@@ -3212,6 +3895,7 @@ inline int SecCamera::m_frameSize(int format, int width, int height)
 
     switch (format) {
     case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YVU420:
     case V4L2_PIX_FMT_NV12:
     case V4L2_PIX_FMT_NV21:
         size = (width * height * 3 / 2);
@@ -3245,6 +3929,15 @@ status_t SecCamera::dump(int fd)
     String8 result;
     snprintf(buffer, 255, "dump(%d)\n", fd);
     result.append(buffer);
+    snprintf(buffer, 255, " control cache: entries(%d) sent(%u) skipped(%u)\n",
+             m_ctrl_cache_count, m_ctrl_sent, m_ctrl_skipped);
+    result.append(buffer);
+    snprintf(buffer, 255, " preview frames(%u) dropped(%u) period(%lldus)\n",
+             m_preview_stats.frames, m_preview_stats.dropped, ns2us(m_preview_stats.period));
+    result.append(buffer);
+    snprintf(buffer, 255, " record frames(%u) dropped(%u) period(%lldus)\n",
+             m_record_stats.frames, m_record_stats.dropped, ns2us(m_record_stats.period));
+    result.append(buffer);
     ::write(fd, result.string(), result.size());
     return NO_ERROR;
 }
@@ -39,8 +39,10 @@
 #include <videodev2_samsung.h>
 
 #include <utils/String8.h>
+#include <utils/threads.h>
 
 #include "JpegEncoder.h"
+#include "SecCameraExif.h"
 
 namespace android {
 
@@ -50,26 +52,9 @@ namespace android {
 #if defined(LOG_NDEBUG) && LOG_NDEBUG == 0
 #define LOG_CAMERA ALOGD
 #define LOG_CAMERA_PREVIEW ALOGD
-
-#define LOG_TIME_DEFINE(n) \
-    struct timeval time_start_##n, time_stop_##n; unsigned long log_time_##n = 0;
-
-#define LOG_TIME_START(n) \
-    gettimeofday(&time_start_##n, NULL);
-
-#define LOG_TIME_END(n) \
-    gettimeofday(&time_stop_##n, NULL); log_time_##n = measure_time(&time_start_##n, &time_stop_##n);
-
-#define LOG_TIME(n) \
-    log_time_##n
-
 #else
 #define LOG_CAMERA(...)
 #define LOG_CAMERA_PREVIEW(...)
-#define LOG_TIME_DEFINE(n)
-#define LOG_TIME_START(n)
-#define LOG_TIME_END(n)
-#define LOG_TIME(n)
 #endif
 
 #define JOIN(x, y) JOIN_AGAIN(x, y)
@@ -135,6 +120,9 @@ namespace android {
 #define FRONT_CAMERA_THUMBNAIL_BPP          JOIN(FRONT_CAM,_THUMBNAIL_BPP)
 #define FRONT_CAMERA_FOCAL_LENGTH           JOIN(FRONT_CAM,_FOCAL_LENGTH)
 
+/* the most getExif() may need, JpegEncoder::makeExif() doesn't take a size */
+#define EXIF_MAX_BUILD_SIZE                 (EXIF_FILE_SIZE + JPG_STREAM_BUF_SIZE)
+
 #define DEFAULT_JPEG_THUMBNAIL_WIDTH        256
 #define DEFAULT_JPEG_THUMBNAIL_HEIGHT       192
 
@@ -148,11 +136,18 @@ namespace android {
 #define BPP             2
 #define MIN(x, y)       (((x) < (y)) ? (x) : (y))
 #define MAX_BUFFERS     8
+#define MAX_BURST_BUFFERS   4
+#define CTRL_CACHE_SIZE     32
 
-#define FIRST_AF_SEARCH_COUNT 600
 #define AF_PROGRESS 0x05
 #define AF_SUCCESS 0x02
-#define AF_DELAY 10000
+#define AF_TIMEOUT          6000000000LL    /* ns, give up on the 1st search */
+#define AF_POLL_FAST_PERIOD 500000000LL     /* ns, poll quickly for this long */
+#define AF_POLL_MIN_DELAY   5000000LL       /* ns */
+#define AF_POLL_MAX_DELAY   40000000LL      /* ns */
+
+#define FRAME_TIMESTAMP_MAX_AGE 1000000000LL /* ns, older buffer stamps are bogus */
+#define FRAME_RATE_SETTLE_FRAMES 4          /* intervals re-seeding the period */
 
 /*
  * V 4 L 2   F I M C   E X T E N S I O N S
@@ -193,6 +188,16 @@ struct fimc_buffer {
     size_t  length;
 };
 
+/* what the driver told us about the frames dequeued from one node */
+struct fimc_frame_stats {
+    nsecs_t         timestamp;  /* capture time of the last frame, monotonic */
+    __u32           sequence;
+    nsecs_t         period;     /* smoothed frame interval */
+    unsigned int    frames;
+    unsigned int    dropped;
+    unsigned int    settle;     /* intervals left to take as the period */
+};
+
 struct yuv_fmt_list {
     const char  *name;
     const char  *desc;
@@ -297,10 +302,24 @@ public:
     int             stopRecord(void);
     int             getRecordFrame(void);
     int             releaseRecordFrame(int index);
+    int             getRecordQueued(void);
+    nsecs_t         getRecordTimestamp(void);
     unsigned int    getRecPhyAddrY(int);
     unsigned int    getRecPhyAddrC(int);
+    /* the record node's NV12T frames and their size, which is the
+     * recording size turned for the front camera; mapped for reading
+     * while the recording runs, NULL if the driver didn't map them */
+    void            getRecordFrameSize(int *width, int *height);
+    const unsigned char *getRecordBuffer(int index, size_t *length);
 
     int             getPreview(void);
+    int             releasePreviewFrame(int index);
+    nsecs_t         getPreviewTimestamp(void);
+    nsecs_t         getPreviewFramePeriod(void);
+    int             setPreviewUserPtr(int index, unsigned long userptr, size_t length);
+    void            clearPreviewUserPtrs(void);
+    bool            isPreviewUserPtr(void);
+    void            setPreviewHold(bool hold);
     int             setPreviewSize(int width, int height, int pixel_format);
     int             getPreviewSize(int *width, int *height, int *frame_size);
     int             getPreviewMaxSize(int *width, int *height);
@@ -412,8 +431,13 @@ public:
     int             setSlowAE(int slow_ae);
     int             setExifOrientationInfo(int orientationInfo);
     int             setBatchReflection(void);
-    int             setSnapshotCmd(void);
+    int             setSnapshotCmd(int nframe = 1);
     int             endSnapshot(void);
+    unsigned char*  getBurstJpeg(int *jpeg_size, int *index);
+    int             triggerBurstCapture(void);
+    int             releaseBurstJpeg(int index);
+    int             stopBurst(void);
+    int             getCaptureBufferCount(void);
     int             setCameraSensorReset(void);
     int             setSensorMode(int sensor_mode); /* Camcorder fix fps */
     int             setShotMode(int shot_mode);     /* Shot mode */
@@ -434,10 +458,43 @@ public:
 #endif // ENABLE_ESD_PREVIEW_CHECK
 
     int setFrameRate(int frame_rate);
+    int getFrameRate(void);
+    /* the rate the sensor runs the preview at right now, which stopRecord()
+     * leaves at FRAME_RATE_AUTO; setting it overrides the configured rate
+     * until the next startPreview() or startRecord() */
+    int             setSensorFrameRate(int frame_rate);
+    int             getSensorFrameRate(void);
     unsigned char*  getJpeg(int*, unsigned int*);
-    int             getSnapshotAndJpeg(unsigned char *yuv_buf, unsigned char *jpeg_buf,
-                                        unsigned int *output_size);
-    int             getExif(unsigned char *pExifDst, unsigned char *pThumbSrc);
+    int             getSnapshot(unsigned char *yuv_buf);
+
+    /* the stream encodeSnapshot() left in the encoder's output buffer,
+     * holding the JPEG block until release() or the end of its scope */
+    class SnapshotJpeg {
+    public:
+        SnapshotJpeg() : mLock(NULL), mEncoder(NULL), mData(NULL), mSize(0) {}
+        ~SnapshotJpeg() { release(); }
+
+        unsigned char   *data(void) const { return mData; }
+        unsigned int    size(void) const { return mSize; }
+        void            release(void);
+
+    private:
+        friend class SecCamera;
+        SnapshotJpeg(const SnapshotJpeg&);
+        SnapshotJpeg& operator=(const SnapshotJpeg&);
+
+        Mutex           *mLock;
+        JpegEncoder     *mEncoder;
+        unsigned char   *mData;
+        unsigned int    mSize;
+    };
+    int             encodeSnapshot(unsigned char *yuv_buf, int width, int height,
+                                   int quality, SnapshotJpeg *jpeg);
+    void            getExifInfo(exif_attribute_t *exifInfo);
+    int             getExif(unsigned char *pExifDst, unsigned int exifSize,
+                            unsigned char *pThumbSrc,
+                            int thumbWidth, int thumbHeight,
+                            exif_attribute_t *exifInfo);
 
     void            getPostViewConfig(int*, int*, int*);
     void            getThumbnailConfig(int *width, int *height, int *size);
@@ -498,11 +555,43 @@ private:
     struct pollfd   m_events_c2;
     int             m_flag_record_start;
 
+    /* the record node is opened and probed on a helper thread while the
+     * preview node comes up, and only bound to the sensor by the first
+     * startRecord() */
+    class RecordNodeThread : public Thread {
+        SecCamera *mCamera;
+    public:
+        RecordNodeThread(SecCamera *camera) : Thread(false), mCamera(camera) { }
+        virtual bool threadLoop() {
+            mCamera->openRecordNode();
+            return false;
+        }
+    };
+    sp<RecordNodeThread> m_record_node_thread;
+    int             m_record_input_set;
+
+    /* inputs QUERYCAP/ENUMINPUT already vouched for on each node, as bits;
+     * the answers can't change while the process lives */
+    enum { NODE_PREVIEW, NODE_RECORD, NODE_COUNT };
+    enum { MAX_CAMERA_INPUTS = 2 };
+    unsigned int    m_probed_inputs[NODE_COUNT];
+    __u8            m_input_names[MAX_CAMERA_INPUTS][32];
+
+    int             m_exif_fixed_id;
+    nsecs_t         m_init_time;
+
     int             m_preview_v4lformat;
     int             m_preview_width;
     int             m_preview_height;
     int             m_preview_max_width;
     int             m_preview_max_height;
+    unsigned long   m_preview_userptr[MAX_BUFFERS];
+    size_t          m_preview_userptr_length;
+    unsigned int    m_preview_userptr_queued;
+    /* mmap'ed preview buffers kept from the driver until released, the
+     * caller may release them from another thread */
+    bool            m_preview_hold;
+    volatile int32_t m_preview_held;
 
     int             m_snapshot_v4lformat;
     int             m_snapshot_width;
@@ -515,6 +604,7 @@ private:
     int             m_wdr;
     int             m_anti_shake;
     int             m_zoom_level;
+    int             m_sensor_frame_rate;
     int             m_object_tracking;
     int             m_smart_auto;
     int             m_beauty_shot;
@@ -555,13 +645,58 @@ private:
 
     exif_attribute_t mExifInfo;
 
-    struct fimc_buffer m_capture_buf;
+    /* the JPEG block only serves one encoder at a time */
+    Mutex           m_jpeg_lock;
+    /* under m_jpeg_lock */
+    SecCameraExifTemplate m_exif_template;
+    bool            m_exif_verify;
+
+    struct fimc_frame_stats m_preview_stats;
+    struct fimc_frame_stats m_record_stats;
+    int             m_record_queued;    /* record buffers the driver owns */
+    struct fimc_buffer m_record_buf[MAX_BUFFERS];
+    void            unmapRecordBuffers(void);
+    int             m_record_frame_width;
+    int             m_record_frame_height;
+
+    struct fimc_buffer m_capture_buf[MAX_BURST_BUFFERS];
+    int             m_capture_nframe;
     struct pollfd   m_events_c;
 
     inline int      m_frameSize(int format, int width, int height);
 
+    /* last value of each sensor control applied on m_cam_fd */
+    struct ctrl_cache_entry {
+        unsigned int    id;
+        int             value;
+    };
+    struct ctrl_cache_entry m_ctrl_cache[CTRL_CACHE_SIZE];
+    int             m_ctrl_cache_count;
+    unsigned int    m_ctrl_sent;
+    unsigned int    m_ctrl_skipped;
+
+    int             setSensorCtrl(unsigned int id, int value);
+    void            invalidateCtrlCache(void);
+
+    /* autofocus search, so cancelAutofocus() can wake the poll loop */
+    enum AF_STATE {
+        AF_STATE_IDLE,
+        AF_STATE_SEARCHING,
+        AF_STATE_CANCELLING,
+    };
+    Mutex           m_af_lock;
+    Condition       m_af_cond;
+    int             m_af_state;
+
+    int             probeNode(int fd, int node, int index);
+    int             openRecordNode(void);
+    int             prepareRecordNode(void);
+    void            stopRecordNodeThread(void);
+
     void            setExifChangedAttribute();
     void            setExifFixedAttribute();
+    void            verifyExif(JpegEncoder& jpgEnc, const unsigned char *exif,
+                               unsigned int size, const exif_attribute_t *exifInfo);
     void            resetCamera();
 
     static double   jpeg_ratio;
@@ -569,8 +704,6 @@ private:
     static int      jpegLineLength;
 };
 
-extern unsigned long measure_time(struct timeval *start, struct timeval *stop);
-
 }; // namespace android
 
 #endif // ANDROID_HARDWARE_CAMERA_SEC_H
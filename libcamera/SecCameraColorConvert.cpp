@@ -0,0 +1,610 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraColorConvert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#define ALIGN_TO_16B(x)   ((((x) + (1 <<  4) - 1) >>  4) <<  4)
+
+namespace android {
+
+// ======================================================================
+// Row kernels
+
+static inline void copyRowGeneric(uint8_t *dst, const uint8_t *src, int width)
+{
+    memcpy(dst, src, width);
+}
+
+#if defined(__ARM_NEON__)
+static inline void copyRowNeon(uint8_t *dst, const uint8_t *src, int width)
+{
+    int x = 0;
+
+    /* 64 bytes per iteration keeps the Cortex-A8 load/store pipes busy */
+    for (; x + 64 <= width; x += 64) {
+        __builtin_prefetch(src + x + 256);
+        uint8x16_t a = vld1q_u8(src + x);
+        uint8x16_t b = vld1q_u8(src + x + 16);
+        uint8x16_t c = vld1q_u8(src + x + 32);
+        uint8x16_t d = vld1q_u8(src + x + 48);
+        vst1q_u8(dst + x, a);
+        vst1q_u8(dst + x + 16, b);
+        vst1q_u8(dst + x + 32, c);
+        vst1q_u8(dst + x + 48, d);
+    }
+    for (; x + 16 <= width; x += 16)
+        vst1q_u8(dst + x, vld1q_u8(src + x));
+
+    if (x < width)
+        memcpy(dst + x, src + x, width - x);
+}
+#endif
+
+static inline void copyRow(uint8_t *dst, const uint8_t *src, int width)
+{
+#if defined(__ARM_NEON__)
+    copyRowNeon(dst, src, width);
+#else
+    copyRowGeneric(dst, src, width);
+#endif
+}
+
+static inline void interleaveGeneric(uint8_t *dst, const uint8_t *first,
+                                     const uint8_t *second, int count)
+{
+    for (int i = 0; i < count; i++) {
+        *dst++ = first[i];
+        *dst++ = second[i];
+    }
+}
+
+#if defined(__ARM_NEON__)
+static inline void interleaveNeon(uint8_t *dst, const uint8_t *first,
+                                  const uint8_t *second, int count)
+{
+    int i = 0;
+
+    /* vst2 does the zip for us, 32 output bytes per iteration */
+    for (; i + 16 <= count; i += 16) {
+        __builtin_prefetch(first + i + 128);
+        __builtin_prefetch(second + i + 128);
+        uint8x16x2_t vu;
+        vu.val[0] = vld1q_u8(first + i);
+        vu.val[1] = vld1q_u8(second + i);
+        vst2q_u8(dst + 2 * i, vu);
+    }
+
+    interleaveGeneric(dst + 2 * i, first + i, second + i, count - i);
+}
+#endif
+
+// ======================================================================
+// Plane copy
+
+void copyPlane(uint8_t *dst, int dstStride,
+               const uint8_t *src, int srcStride,
+               int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (dstStride == width && srcStride == width) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+
+    for (int h = 0; h < height; h++) {
+        copyRow(dst, src, width);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+void copyYuv420ToYv12(uint8_t *dst, int dstStride,
+                      const uint8_t *src, int width, int height)
+{
+    const int cwidth   = (width + 1) / 2;
+    const int cheight  = (height + 1) / 2;
+    const int cstride  = ALIGN_TO_16B(dstStride / 2);
+
+    const uint8_t *srcY = src;
+    const uint8_t *srcU = srcY + width * height;
+    const uint8_t *srcV = srcU + cwidth * cheight;
+
+    uint8_t *dstY = dst;
+    uint8_t *dstV = dstY + dstStride * height;
+    uint8_t *dstU = dstV + cstride * cheight;
+
+    copyPlane(dstY, dstStride, srcY, width, width, height);
+    copyPlane(dstV, cstride, srcV, cwidth, cwidth, cheight);
+    copyPlane(dstU, cstride, srcU, cwidth, cwidth, cheight);
+}
+
+void copyYv12ToYuv420(uint8_t *dst, const uint8_t *src, int srcStride,
+                      int width, int height)
+{
+    const int cwidth   = (width + 1) / 2;
+    const int cheight  = (height + 1) / 2;
+    const int cstride  = ALIGN_TO_16B(srcStride / 2);
+
+    const uint8_t *srcY = src;
+    const uint8_t *srcV = srcY + srcStride * height;
+    const uint8_t *srcU = srcV + cstride * cheight;
+
+    uint8_t *dstY = dst;
+    uint8_t *dstU = dstY + width * height;
+    uint8_t *dstV = dstU + cwidth * cheight;
+
+    copyPlane(dstY, width, srcY, srcStride, width, height);
+    copyPlane(dstU, cwidth, srcU, cstride, cwidth, cheight);
+    copyPlane(dstV, cwidth, srcV, cstride, cwidth, cheight);
+}
+
+// ======================================================================
+// Planar to semi-planar
+
+void interleaveChroma(uint8_t *dst, const uint8_t *first,
+                      const uint8_t *second, int count)
+{
+    if (count <= 0)
+        return;
+
+#if defined(__ARM_NEON__)
+    interleaveNeon(dst, first, second, count);
+#else
+    interleaveGeneric(dst, first, second, count);
+#endif
+}
+
+size_t nv21ScratchSize(int width, int height)
+{
+    return 2 * ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+void yuv420ToNv21InPlace(uint8_t *frame, int width, int height,
+                         uint8_t *scratch)
+{
+    const int csize = ((width + 1) / 2) * ((height + 1) / 2);
+    uint8_t *uv = frame + width * height;
+
+    memcpy(scratch, uv, 2 * csize);
+    interleaveChroma(uv, scratch + csize, scratch, csize);
+}
+
+// ======================================================================
+// YUYV to NV21
+
+static inline void yuyvRowGeneric(uint8_t *dstY, uint8_t *dstVU,
+                                  const uint8_t *src, int width)
+{
+    for (int x = 0; x < width; x += 2) {
+        *dstY++ = src[0];
+        *dstY++ = src[2];
+        if (dstVU) {
+            *dstVU++ = src[3];
+            *dstVU++ = src[1];
+        }
+        src += 4;
+    }
+}
+
+#if defined(__ARM_NEON__)
+static inline void yuyvRowNeon(uint8_t *dstY, uint8_t *dstVU,
+                               const uint8_t *src, int width)
+{
+    int x = 0;
+
+    /* vld4 splits 32 pixels into Y0, U, Y1, V lanes */
+    for (; x + 32 <= width; x += 32) {
+        __builtin_prefetch(src + 2 * x + 256);
+        uint8x16x4_t yuyv = vld4q_u8(src + 2 * x);
+        uint8x16x2_t y;
+        y.val[0] = yuyv.val[0];
+        y.val[1] = yuyv.val[2];
+        vst2q_u8(dstY + x, y);
+        if (dstVU) {
+            uint8x16x2_t vu;
+            vu.val[0] = yuyv.val[3];
+            vu.val[1] = yuyv.val[1];
+            vst2q_u8(dstVU + x, vu);
+        }
+    }
+
+    yuyvRowGeneric(dstY + x, dstVU ? dstVU + x : NULL, src + 2 * x, width - x);
+}
+#endif
+
+void yuyvToNv21(uint8_t *dst, const uint8_t *src, int width, int height)
+{
+    uint8_t *dstY = dst;
+    uint8_t *dstVU = dst + width * height;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *vu = (y & 1) ? NULL : dstVU + (y / 2) * width;
+#if defined(__ARM_NEON__)
+        yuyvRowNeon(dstY, vu, src, width);
+#else
+        yuyvRowGeneric(dstY, vu, src, width);
+#endif
+        dstY += width;
+        src += width * 2;
+    }
+}
+
+// ======================================================================
+// YUV420 / NV21 to YUYV
+
+/* u and v advance by step per chroma sample, 1 for planar and 2 for VU */
+static inline void yuv420RowGeneric(uint8_t *dst, const uint8_t *y,
+                                    const uint8_t *u, const uint8_t *v,
+                                    int step, int width)
+{
+    for (int x = 0; x < width; x += 2) {
+        dst[0] = y[0];
+        dst[1] = *u;
+        dst[2] = y[1];
+        dst[3] = *v;
+        dst += 4;
+        y += 2;
+        u += step;
+        v += step;
+    }
+}
+
+#if defined(__ARM_NEON__)
+static inline void yuv420RowNeon(uint8_t *dst, const uint8_t *y,
+                                 const uint8_t *u, const uint8_t *v,
+                                 int step, int width)
+{
+    int x = 0;
+
+    /* 32 pixels: split luma into even and odd, vst4 weaves Y0, U, Y1, V */
+    for (; x + 32 <= width; x += 32) {
+        __builtin_prefetch(y + x + 256);
+        uint8x16x2_t luma = vld2q_u8(y + x);
+        uint8x16x4_t yuyv;
+        yuyv.val[0] = luma.val[0];
+        yuyv.val[2] = luma.val[1];
+        if (step == 2) {
+            /* interleaved chroma, VU for NV21 and UV for NV12 */
+            const bool vuOrder = v < u;
+            uint8x16x2_t c = vld2q_u8((vuOrder ? v : u) + x);
+            yuyv.val[1] = c.val[vuOrder ? 1 : 0];
+            yuyv.val[3] = c.val[vuOrder ? 0 : 1];
+        } else {
+            yuyv.val[1] = vld1q_u8(u + x / 2);
+            yuyv.val[3] = vld1q_u8(v + x / 2);
+        }
+        vst4q_u8(dst + 2 * x, yuyv);
+    }
+
+    yuv420RowGeneric(dst + 2 * x, y + x, u + (x / 2) * step, v + (x / 2) * step,
+                     step, width - x);
+}
+#endif
+
+void yuv420ToYuyv(uint8_t *dst, const uint8_t *src, int width, int height,
+                  bool nv21)
+{
+    const uint8_t *chroma = src + width * height;
+    const int cwidth = width / 2;
+
+    for (int row = 0; row < height; row++) {
+        const uint8_t *u, *v;
+        int step;
+
+        if (nv21) {
+            v = chroma + (row / 2) * width;
+            u = v + 1;
+            step = 2;
+        } else {
+            u = chroma + (row / 2) * cwidth;
+            v = chroma + (height / 2) * cwidth + (row / 2) * cwidth;
+            step = 1;
+        }
+#if defined(__ARM_NEON__)
+        yuv420RowNeon(dst, src + row * width, u, v, step, width);
+#else
+        yuv420RowGeneric(dst, src + row * width, u, v, step, width);
+#endif
+        dst += width * 2;
+    }
+}
+
+// ======================================================================
+// NV12T to YUYV
+
+#define NV12T_TILE_WIDTH    64
+#define NV12T_TILE_HEIGHT   32
+#define NV12T_TILE_SIZE     (NV12T_TILE_WIDTH * NV12T_TILE_HEIGHT)
+
+size_t nv12tPlaneSize(int width, int height)
+{
+    /* whole 2x2 blocks across, whole tiles down */
+    return (size_t)((width + 127) & ~127) * ((height + 31) & ~31);
+}
+
+/* offset of the byte at x, y in an NV12T plane of width x height */
+static size_t nv12tOffset(int x, int y, int width, int height)
+{
+    const int tileX = x / NV12T_TILE_WIDTH;
+    const int tileY = y / NV12T_TILE_HEIGHT;
+    const int blocksAcross = (width + 127) / 128;
+    const int tileRows = (height + NV12T_TILE_HEIGHT - 1) / NV12T_TILE_HEIGHT;
+    size_t tile;
+
+    if ((tileRows & 1) && tileY == tileRows - 1) {
+        tile = (size_t)tileY * blocksAcross * 2 + tileX;
+    } else {
+        tile = ((size_t)(tileY / 2) * blocksAcross + tileX / 2) * 4;
+        if (((tileX / 2) & 1) == (tileY & 1))
+            tile += tileX & 1;
+        else
+            tile += 2 + (tileX & 1);
+    }
+
+    return tile * NV12T_TILE_SIZE + (y % NV12T_TILE_HEIGHT) * NV12T_TILE_WIDTH +
+           x % NV12T_TILE_WIDTH;
+}
+
+void nv12tToYuyv(uint8_t *dst, const uint8_t *y, const uint8_t *cbcr,
+                 int width, int height)
+{
+    for (int row = 0; row < height; row++) {
+        /* a tile's row is contiguous, the next one is elsewhere */
+        for (int x = 0; x < width; x += NV12T_TILE_WIDTH) {
+            const int span = width - x < NV12T_TILE_WIDTH ? width - x : NV12T_TILE_WIDTH;
+            const uint8_t *luma = y + nv12tOffset(x, row, width, height);
+            const uint8_t *uv = cbcr + nv12tOffset(x, row / 2, width, height / 2);
+#if defined(__ARM_NEON__)
+            yuv420RowNeon(dst + 2 * x, luma, uv, uv + 1, 2, span);
+#else
+            yuv420RowGeneric(dst + 2 * x, luma, uv, uv + 1, 2, span);
+#endif
+        }
+        dst += width * 2;
+    }
+}
+
+// ======================================================================
+// YUV422 box downscale
+
+static inline void accumulateRowGeneric(uint16_t *acc, const uint8_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+        acc[i] += src[i];
+}
+
+#if defined(__ARM_NEON__)
+static inline void accumulateRowNeon(uint16_t *acc, const uint8_t *src, int count)
+{
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __builtin_prefetch(src + i + 256);
+        uint8x16_t s = vld1q_u8(src + i);
+        uint16x8_t lo = vld1q_u16(acc + i);
+        uint16x8_t hi = vld1q_u16(acc + i + 8);
+        vst1q_u16(acc + i, vaddw_u8(lo, vget_low_u8(s)));
+        vst1q_u16(acc + i + 8, vaddw_u8(hi, vget_high_u8(s)));
+    }
+
+    accumulateRowGeneric(acc + i, src + i, count - i);
+}
+#endif
+
+bool scaleDownYuv422(uint8_t *dst, int dstWidth, int dstHeight,
+                     const uint8_t *src, int srcWidth, int srcHeight)
+{
+    if (dstWidth <= 0 || dstHeight <= 0 || (dstWidth & 1) ||
+        srcWidth < dstWidth || srcHeight < dstHeight)
+        return false;
+
+    const int stepX = srcWidth / dstWidth;
+    const int stepY = srcHeight / dstHeight;
+    /* uint16_t accumulators: stepY rows of 255 each must not overflow */
+    if (stepY > 256)
+        return false;
+
+    /* every luma and chroma sample averages stepX * stepY source samples */
+    const int count     = stepX * stepY;
+    const int usedBytes = dstWidth * stepX * 2;
+
+    uint16_t *acc = (uint16_t *)malloc(usedBytes * sizeof(uint16_t));
+    if (!acc)
+        return false;
+
+    for (int y = 0; y < dstHeight; y++) {
+        const uint8_t *row = src + (y * stepY) * srcWidth * 2;
+
+        /* vertical pass: sum the box rows byte by byte */
+        memset(acc, 0, usedBytes * sizeof(uint16_t));
+        for (int r = 0; r < stepY; r++) {
+#if defined(__ARM_NEON__)
+            accumulateRowNeon(acc, row, usedBytes);
+#else
+            accumulateRowGeneric(acc, row, usedBytes);
+#endif
+            row += srcWidth * 2;
+        }
+
+        /* horizontal pass: each output pixel pair covers stepX source pairs */
+        for (int x = 0; x < dstWidth; x += 2) {
+            const uint16_t *box = acc + x * stepX * 2;
+            uint32_t y0 = 0, y1 = 0, u = 0, v = 0;
+
+            for (int k = 0; k < stepX; k++) {
+                y0 += box[2 * k];
+                y1 += box[2 * (stepX + k)];
+                u  += box[4 * k + 1];
+                v  += box[4 * k + 3];
+            }
+
+            *dst++ = (y0 + count / 2) / count;
+            *dst++ = (u + count / 2) / count;
+            *dst++ = (y1 + count / 2) / count;
+            *dst++ = (v + count / 2) / count;
+        }
+    }
+
+    free(acc);
+    return true;
+}
+
+// ======================================================================
+// YUV420 box downscale
+
+static inline void halveRowGeneric(uint8_t *dst, const uint8_t *r0,
+                                   const uint8_t *r1, int dstWidth)
+{
+    for (int x = 0; x < dstWidth; x++)
+        dst[x] = (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
+}
+
+#if defined(__ARM_NEON__)
+static inline void halveRowNeon(uint8_t *dst, const uint8_t *r0,
+                                const uint8_t *r1, int dstWidth)
+{
+    int x = 0;
+
+    /* pairwise add across each row, add the rows, round and narrow */
+    for (; x + 16 <= dstWidth; x += 16) {
+        __builtin_prefetch(r0 + 2 * x + 256);
+        __builtin_prefetch(r1 + 2 * x + 256);
+        uint16x8_t lo = vaddq_u16(vpaddlq_u8(vld1q_u8(r0 + 2 * x)),
+                                  vpaddlq_u8(vld1q_u8(r1 + 2 * x)));
+        uint16x8_t hi = vaddq_u16(vpaddlq_u8(vld1q_u8(r0 + 2 * x + 16)),
+                                  vpaddlq_u8(vld1q_u8(r1 + 2 * x + 16)));
+        vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+
+    halveRowGeneric(dst + x, r0 + 2 * x, r1 + 2 * x, dstWidth - x);
+}
+#endif
+
+/*
+ * Output row y covers source rows [y * srcHeight / dstHeight,
+ * (y + 1) * srcHeight / dstHeight), and likewise for the columns, so each
+ * box is q or q + 1 samples wide.  The divisions are replaced by 16.16
+ * reciprocals, two per output row.
+ */
+static void scalePlane(uint8_t *dst, int dstWidth, int dstHeight,
+                       const uint8_t *src, int srcStride,
+                       int srcWidth, int srcHeight, uint16_t *acc)
+{
+    if (srcWidth == 2 * dstWidth && srcHeight == 2 * dstHeight) {
+        for (int y = 0; y < dstHeight; y++) {
+            const uint8_t *r0 = src + 2 * y * srcStride;
+#if defined(__ARM_NEON__)
+            halveRowNeon(dst, r0, r0 + srcStride, dstWidth);
+#else
+            halveRowGeneric(dst, r0, r0 + srcStride, dstWidth);
+#endif
+            dst += dstWidth;
+        }
+        return;
+    }
+
+    const int q = srcWidth / dstWidth;
+    const int r = srcWidth % dstWidth;
+
+    for (int y = 0; y < dstHeight; y++) {
+        const int y0 = y * srcHeight / dstHeight;
+        const int rows = (y + 1) * srcHeight / dstHeight - y0;
+        const uint8_t *row = src + y0 * srcStride;
+
+        /* vertical pass: sum the box rows */
+        memset(acc, 0, srcWidth * sizeof(uint16_t));
+        for (int k = 0; k < rows; k++) {
+#if defined(__ARM_NEON__)
+            accumulateRowNeon(acc, row, srcWidth);
+#else
+            accumulateRowGeneric(acc, row, srcWidth);
+#endif
+            row += srcStride;
+        }
+
+        const uint32_t narrow = (65536 + rows * q / 2) / (rows * q);
+        const uint32_t wide = (65536 + rows * (q + 1) / 2) / (rows * (q + 1));
+
+        /* horizontal pass, stepping the box edges without dividing */
+        const uint16_t *box = acc;
+        int err = 0;
+        for (int x = 0; x < dstWidth; x++) {
+            int cols = q;
+            err += r;
+            if (err >= dstWidth) {
+                err -= dstWidth;
+                cols++;
+            }
+
+            uint32_t sum = 0;
+            for (int k = 0; k < cols; k++)
+                sum += box[k];
+            box += cols;
+
+            uint32_t value = (sum * (cols == q ? narrow : wide) + 32768) >> 16;
+            *dst++ = value > 255 ? 255 : value;
+        }
+    }
+}
+
+size_t scaleYuv420ScratchSize(int srcWidth, int dstWidth, int dstHeight)
+{
+    /* row accumulator, then the scaled U and V planes */
+    return srcWidth * sizeof(uint16_t) + 2 * (dstWidth / 2) * (dstHeight / 2);
+}
+
+bool scaleDownYuv420(uint8_t *dst, int dstWidth, int dstHeight, bool lumaOnly,
+                     const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     int yStride, int cStride, int srcWidth, int srcHeight,
+                     uint8_t *scratch)
+{
+    if (dstWidth <= 0 || dstHeight <= 0 || ((dstWidth | dstHeight) & 1) ||
+        ((srcWidth | srcHeight) & 1) ||
+        srcWidth < dstWidth || srcHeight < dstHeight)
+        return false;
+    /* uint16_t accumulators: the rows of a box must not overflow */
+    if (srcHeight / dstHeight >= 256)
+        return false;
+
+    uint16_t *acc = (uint16_t *)scratch;
+
+    scalePlane(dst, dstWidth, dstHeight, y, yStride, srcWidth, srcHeight, acc);
+    if (lumaOnly)
+        return true;
+
+    const int cw = dstWidth / 2;
+    const int ch = dstHeight / 2;
+    uint8_t *su = scratch + srcWidth * sizeof(uint16_t);
+    uint8_t *sv = su + cw * ch;
+
+    scalePlane(su, cw, ch, u, cStride, srcWidth / 2, srcHeight / 2, acc);
+    scalePlane(sv, cw, ch, v, cStride, srcWidth / 2, srcHeight / 2, acc);
+    interleaveChroma(dst + dstWidth * dstHeight, sv, su, cw * ch);
+
+    return true;
+}
+
+}; // namespace android
@@ -0,0 +1,136 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_COLOR_CONVERT_H
+#define ANDROID_HARDWARE_CAMERA_SEC_COLOR_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/*
+ * Copy a single image plane of width x height bytes, honouring the row
+ * stride of both source and destination.  Collapses to a single memcpy
+ * when both planes are tightly packed.
+ */
+void copyPlane(uint8_t *dst, int dstStride,
+               const uint8_t *src, int srcStride,
+               int width, int height);
+
+/*
+ * Copy a tightly packed YUV420 planar frame (Y, U, V) as produced by FIMC
+ * into a YV12 gralloc buffer (Y, V, U) whose luma rows are dstStride bytes
+ * apart.  Chroma planes are (width + 1) / 2 x (height + 1) / 2, so odd
+ * sizes are handled; the destination chroma stride follows the YV12
+ * definition, i.e. dstStride / 2 rounded up to 16 bytes.
+ */
+void copyYuv420ToYv12(uint8_t *dst, int dstStride,
+                      const uint8_t *src, int width, int height);
+
+/*
+ * Inverse of copyYuv420ToYv12(): unpack a YV12 buffer with the given luma
+ * stride into a tightly packed YUV420 planar frame.
+ */
+void copyYv12ToYuv420(uint8_t *dst, const uint8_t *src, int srcStride,
+                      int width, int height);
+
+/*
+ * Interleave two chroma planes into a semi-planar chroma plane, i.e.
+ * dst = first[0], second[0], first[1], second[1], ...  count is the
+ * number of samples in each source plane.  dst must not overlap either
+ * source.
+ */
+void interleaveChroma(uint8_t *dst, const uint8_t *first,
+                      const uint8_t *second, int count);
+
+/*
+ * Scratch space needed by yuv420ToNv21InPlace() for a width x height frame.
+ */
+size_t nv21ScratchSize(int width, int height);
+
+/*
+ * Convert a packed YUV420 planar frame (Y, U, V) to NV21 (Y, VU) in place.
+ * The luma plane is left alone; the chroma planes are staged in scratch,
+ * which must hold nv21ScratchSize() bytes and is meant to be allocated
+ * once per preview size rather than per frame.
+ */
+void yuv420ToNv21InPlace(uint8_t *frame, int width, int height,
+                         uint8_t *scratch);
+
+/*
+ * Convert a packed YUYV (YUV422 interleaved) frame to NV21.  Chroma is
+ * taken from the even source rows.  width and height must be even.
+ */
+void yuyvToNv21(uint8_t *dst, const uint8_t *src, int width, int height);
+
+/*
+ * Convert a packed YUV420 planar frame (Y, U, V), or with nv21 set an NV21
+ * frame (Y, VU), to YUYV.  Each chroma row serves two output rows.  width
+ * and height must be even.
+ */
+void yuv420ToYuyv(uint8_t *dst, const uint8_t *src, int width, int height,
+                  bool nv21);
+
+/*
+ * Size of one NV12T plane of width x height bytes: the FIMC writes the
+ * record node's frames for the MFC as 64x32 tiles, grouped by 2x2 into
+ * 8 KB blocks whose tiles go in Z order, or flipped Z in odd columns of
+ * blocks.  An odd last row of tiles is stored in order.
+ */
+size_t nv12tPlaneSize(int width, int height);
+
+/*
+ * Convert an NV12T frame, given as its luma plane and its CbCr plane, to
+ * YUYV.  Each chroma row serves two output rows.  width and height must
+ * be even.
+ */
+void nv12tToYuyv(uint8_t *dst, const uint8_t *y, const uint8_t *cbcr,
+                 int width, int height);
+
+/*
+ * Downscale a packed YUYV frame by the integer ratios srcWidth / dstWidth
+ * and srcHeight / dstHeight, averaging every source pixel of each box so
+ * the result doesn't alias.  Any remainder at the right and bottom edges
+ * is ignored.  dstWidth must be even.  Returns false if the sizes can't be
+ * handled or the row accumulator can't be allocated.
+ */
+bool scaleDownYuv422(uint8_t *dst, int dstWidth, int dstHeight,
+                     const uint8_t *src, int srcWidth, int srcHeight);
+
+/*
+ * Scratch space needed by scaleDownYuv420() for the given sizes.
+ */
+size_t scaleYuv420ScratchSize(int srcWidth, int dstWidth, int dstHeight);
+
+/*
+ * Box-downscale a YUV420 frame, given as Y, U and V planes with the luma
+ * and chroma row strides, to dstWidth x dstHeight.  The result is NV21,
+ * or only the luma plane with lumaOnly set.  The ratios needn't be
+ * integers, exact halving takes a faster path.  All sizes must be even
+ * and the destination no larger than the source.  scratch must hold
+ * scaleYuv420ScratchSize() bytes.  Returns false if the sizes can't be
+ * handled.
+ */
+bool scaleDownYuv420(uint8_t *dst, int dstWidth, int dstHeight, bool lumaOnly,
+                     const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     int yStride, int cStride, int srcWidth, int srcHeight,
+                     uint8_t *scratch);
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_COLOR_CONVERT_H
@@ -0,0 +1,109 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraDevice.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+namespace android {
+
+// ======================================================================
+// Kernel backend
+
+static int kernel_open(const char *path, int flags)
+{
+    return ::open(path, flags);
+}
+
+static int kernel_close(int fd)
+{
+    return ::close(fd);
+}
+
+static int kernel_ioctl(int fd, int request, void *arg)
+{
+    return ::ioctl(fd, request, arg);
+}
+
+static void *kernel_mmap(size_t length, int prot, int flags, int fd, off_t offset)
+{
+    return ::mmap(0, length, prot, flags, fd, offset);
+}
+
+static int kernel_munmap(void *addr, size_t length)
+{
+    return ::munmap(addr, length);
+}
+
+static int kernel_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    return ::poll(fds, nfds, timeout);
+}
+
+static const SecCameraDeviceOps kernelOps = {
+    kernel_open,
+    kernel_close,
+    kernel_ioctl,
+    kernel_mmap,
+    kernel_munmap,
+    kernel_poll,
+};
+
+static const SecCameraDeviceOps *deviceOps = &kernelOps;
+
+void setSecCameraDeviceOps(const SecCameraDeviceOps *ops)
+{
+    deviceOps = ops ? ops : &kernelOps;
+}
+
+// ======================================================================
+// Dispatch
+
+int fimc_dev_open(const char *path, int flags)
+{
+    return deviceOps->open(path, flags);
+}
+
+int fimc_dev_close(int fd)
+{
+    return deviceOps->close(fd);
+}
+
+int fimc_dev_ioctl(int fd, int request, void *arg)
+{
+    return deviceOps->ioctl(fd, request, arg);
+}
+
+void *fimc_dev_mmap(size_t length, int prot, int flags, int fd, off_t offset)
+{
+    return deviceOps->mmap(length, prot, flags, fd, offset);
+}
+
+int fimc_dev_munmap(void *addr, size_t length)
+{
+    return deviceOps->munmap(addr, length);
+}
+
+int fimc_dev_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    return deviceOps->poll(fds, nfds, timeout);
+}
+
+}; // namespace android
@@ -0,0 +1,54 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_DEVICE_H
+#define ANDROID_HARDWARE_CAMERA_SEC_DEVICE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/poll.h>
+
+namespace android {
+
+/*
+ * The system calls SecCamera makes on the FIMC video nodes.  By default
+ * they go straight to the kernel.  A different backend, e.g. the simulated
+ * FIMC in SecCameraFakeDevice for running the HAL off target, can be
+ * installed with setSecCameraDeviceOps() before the camera is opened.
+ */
+struct SecCameraDeviceOps {
+    int     (*open)(const char *path, int flags);
+    int     (*close)(int fd);
+    int     (*ioctl)(int fd, int request, void *arg);
+    void    *(*mmap)(size_t length, int prot, int flags, int fd, off_t offset);
+    int     (*munmap)(void *addr, size_t length);
+    int     (*poll)(struct pollfd *fds, nfds_t nfds, int timeout);
+};
+
+/* NULL puts the kernel backend back */
+void setSecCameraDeviceOps(const SecCameraDeviceOps *ops);
+
+int     fimc_dev_open(const char *path, int flags);
+int     fimc_dev_close(int fd);
+int     fimc_dev_ioctl(int fd, int request, void *arg);
+void    *fimc_dev_mmap(size_t length, int prot, int flags, int fd, off_t offset);
+int     fimc_dev_munmap(void *addr, size_t length);
+int     fimc_dev_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_DEVICE_H
@@ -0,0 +1,181 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SecCameraDumpWriter"
+#include <utils/Log.h>
+
+#include "SecCameraDumpWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+SecCameraDumpWriter::SecCameraDumpWriter()
+    : Thread(false),
+      mHead(0),
+      mCount(0),
+      mDepth(4),
+      mExit(false),
+      mFilesWritten(0),
+      mFilesDropped(0),
+      mWriteErrors(0),
+      mBytesWritten(0),
+      mBytesDropped(0)
+{
+}
+
+void SecCameraDumpWriter::onFirstRef()
+{
+    run("CameraDumpWriter", PRIORITY_BACKGROUND);
+}
+
+void SecCameraDumpWriter::setDepth(int depth)
+{
+    Mutex::Autolock lock(mLock);
+
+    if (depth < 1)
+        depth = 1;
+    else if (depth > MAX_DEPTH)
+        depth = MAX_DEPTH;
+    /* a shallower queue only takes effect as the backlog drains */
+    mDepth = depth;
+}
+
+bool SecCameraDumpWriter::queue(const char *path, const sp<RefBase>& owner,
+                                const void *data, size_t size)
+{
+    Mutex::Autolock lock(mLock);
+
+    if (mExit || mCount >= mDepth) {
+        ALOGW("%s: queue full, dropping %s (%d bytes)", __func__, path, size);
+        mFilesDropped++;
+        mBytesDropped += size;
+        return false;
+    }
+
+    Entry &entry = mQueue[(mHead + mCount) % MAX_DEPTH];
+    entry.path = path;
+    entry.owner = owner;
+    entry.data = data;
+    entry.size = size;
+    mCount++;
+    mCondition.signal();
+    return true;
+}
+
+void SecCameraDumpWriter::stop(void)
+{
+    mLock.lock();
+    requestExit();
+    mExit = true;
+    while (mCount) {
+        Entry &entry = mQueue[mHead];
+        mFilesDropped++;
+        mBytesDropped += entry.size;
+        entry.owner.clear();
+        mHead = (mHead + 1) % MAX_DEPTH;
+        mCount--;
+    }
+    mCondition.signal();
+    mLock.unlock();
+
+    requestExitAndWait();
+}
+
+bool SecCameraDumpWriter::threadLoop()
+{
+    mLock.lock();
+    while (!mCount && !mExit)
+        mCondition.wait(mLock);
+
+    if (mExit) {
+        mLock.unlock();
+        return false;
+    }
+
+    /* take the buffer off the queue, so stop() leaves the one being
+     * written alone and queue() can use the slot meanwhile */
+    Entry entry = mQueue[mHead];
+    mQueue[mHead].owner.clear();
+    mHead = (mHead + 1) % MAX_DEPTH;
+    mCount--;
+    mLock.unlock();
+
+    bool ok = writeEntry(entry);
+
+    mLock.lock();
+    if (ok) {
+        mFilesWritten++;
+        mBytesWritten += entry.size;
+    } else {
+        mWriteErrors++;
+        mBytesDropped += entry.size;
+    }
+    mLock.unlock();
+
+    return true;
+}
+
+bool SecCameraDumpWriter::writeEntry(const Entry& entry)
+{
+    const uint8_t *buf = (const uint8_t *)entry.data;
+    size_t written = 0;
+
+    int fd = open(entry.path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        ALOGE("ERR(%s):failed to create file [%s]: %s", __func__,
+              entry.path.string(), strerror(errno));
+        return false;
+    }
+
+    while (written < entry.size) {
+        ssize_t nw = ::write(fd, buf + written, entry.size - written);
+        if (nw < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("ERR(%s):failed to write to file %d [%s]: %s", __func__,
+                  written, entry.path.string(), strerror(errno));
+            break;
+        }
+        written += nw;
+    }
+    ::close(fd);
+
+    ALOGV("%s: wrote %d of %d bytes to [%s]", __func__, written, entry.size,
+          entry.path.string());
+    return written == entry.size;
+}
+
+void SecCameraDumpWriter::dump(String8& result) const
+{
+    char buffer[256];
+    Mutex::Autolock lock(mLock);
+
+    snprintf(buffer, 255, " dump writer: queued(%d/%d) files written(%u) dropped(%u) errors(%u)\n",
+             mCount, mDepth, mFilesWritten, mFilesDropped, mWriteErrors);
+    result.append(buffer);
+    snprintf(buffer, 255, " dump writer: bytes written(%llu) dropped(%llu)\n",
+             mBytesWritten, mBytesDropped);
+    result.append(buffer);
+}
+
+}; // namespace android
@@ -0,0 +1,81 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_DUMP_WRITER_H
+#define ANDROID_HARDWARE_CAMERA_SEC_DUMP_WRITER_H
+
+#include <stdint.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+
+namespace android {
+
+/*
+ * Writes debug dumps of capture buffers to storage on a background thread.
+ * Buffers are not copied: the caller passes a reference that keeps the
+ * bytes alive until they are written.  The queue is bounded, a buffer that
+ * doesn't fit is dropped rather than making the capture path wait.
+ */
+class SecCameraDumpWriter : public Thread {
+public:
+    enum { MAX_DEPTH = 16 };
+
+    SecCameraDumpWriter();
+
+    /* how many buffers may wait for the writer, 1 to MAX_DEPTH */
+    void            setDepth(int depth);
+
+    /* false if the buffer was dropped */
+    bool            queue(const char *path, const sp<RefBase>& owner,
+                          const void *data, size_t size);
+
+    /* drops whatever is still queued and waits for the thread */
+    void            stop(void);
+
+    void            dump(String8& result) const;
+
+private:
+    struct Entry {
+        String8         path;
+        sp<RefBase>     owner;
+        const void      *data;
+        size_t          size;
+    };
+
+    virtual void    onFirstRef();
+    virtual bool    threadLoop();
+    bool            writeEntry(const Entry& entry);
+
+    mutable Mutex   mLock;
+    Condition       mCondition;
+    Entry           mQueue[MAX_DEPTH];
+    int             mHead;
+    int             mCount;
+    int             mDepth;
+    bool            mExit;
+
+    unsigned int    mFilesWritten;
+    unsigned int    mFilesDropped;
+    unsigned int    mWriteErrors;
+    uint64_t        mBytesWritten;
+    uint64_t        mBytesDropped;
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_DUMP_WRITER_H
@@ -0,0 +1,366 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SecCameraExif"
+#include <utils/Log.h>
+
+#include "SecCameraExif.h"
+
+#include <stddef.h>
+#include <string.h>
+
+namespace android {
+
+/* APP1 marker, length and "Exif\0\0" come before the TIFF header */
+#define TIFF_START      10
+#define IFD_ENTRY_SIZE  12
+
+enum {
+    IFD_0,
+    IFD_EXIF,
+    IFD_GPS,
+    IFD_1,
+};
+
+enum {
+    TAG_IMAGE_WIDTH             = 0x0100,
+    TAG_IMAGE_HEIGHT            = 0x0101,
+    TAG_ORIENTATION             = 0x0112,
+    TAG_DATE_TIME               = 0x0132,
+    TAG_JPEG_INTERCHANGE_FORMAT = 0x0201,
+    TAG_JPEG_INTERCHANGE_LENGTH = 0x0202,
+    TAG_EXPOSURE_TIME           = 0x829a,
+    TAG_EXIF_IFD_POINTER        = 0x8769,
+    TAG_ISO_SPEED_RATING        = 0x8827,
+    TAG_GPS_IFD_POINTER         = 0x8825,
+    TAG_DATE_TIME_ORIGINAL      = 0x9003,
+    TAG_DATE_TIME_DIGITIZED     = 0x9004,
+    TAG_SHUTTER_SPEED           = 0x9201,
+    TAG_BRIGHTNESS              = 0x9203,
+    TAG_EXPOSURE_BIAS           = 0x9204,
+    TAG_METERING_MODE           = 0x9207,
+    TAG_FLASH                   = 0x9209,
+    TAG_PIXEL_X_DIMENSION       = 0xa002,
+    TAG_PIXEL_Y_DIMENSION       = 0xa003,
+    TAG_WHITE_BALANCE           = 0xa403,
+    TAG_SCENE_CAPTURE_TYPE      = 0xa406,
+    TAG_GPS_LATITUDE_REF        = 0x0001,
+    TAG_GPS_LATITUDE            = 0x0002,
+    TAG_GPS_LONGITUDE_REF       = 0x0003,
+    TAG_GPS_LONGITUDE           = 0x0004,
+    TAG_GPS_ALTITUDE_REF        = 0x0005,
+    TAG_GPS_ALTITUDE            = 0x0006,
+    TAG_GPS_TIMESTAMP           = 0x0007,
+    TAG_GPS_PROCESSING_METHOD   = 0x001b,
+    TAG_GPS_DATESTAMP           = 0x001d,
+};
+
+/* makeExif() puts this before the GPS processing method */
+#define GPS_METHOD_PREFIX_SIZE  8
+
+/* an integer written into the entry, or bytes copied to the value */
+enum { PATCH_VALUE, PATCH_DATA };
+
+struct ExifField {
+    uint8_t     ifd;
+    uint8_t     kind;
+    uint16_t    tag;
+    uint16_t    member;     /* offset in exif_attribute_t */
+    uint16_t    size;
+};
+
+#define EXIF_FIELD(ifd, kind, tag, member) \
+    { ifd, kind, tag, offsetof(exif_attribute_t, member), \
+      sizeof(((exif_attribute_t *)0)->member) }
+
+/*
+ * What setExifChangedAttribute() and the thumbnail size can change between
+ * shots.  The maker, model, software, user comment and lens values are left
+ * as the template has them.
+ */
+static const ExifField exifFields[] = {
+    EXIF_FIELD(IFD_0,    PATCH_VALUE, TAG_IMAGE_WIDTH,         width),
+    EXIF_FIELD(IFD_0,    PATCH_VALUE, TAG_IMAGE_HEIGHT,        height),
+    EXIF_FIELD(IFD_0,    PATCH_VALUE, TAG_ORIENTATION,         orientation),
+    EXIF_FIELD(IFD_0,    PATCH_DATA,  TAG_DATE_TIME,           date_time),
+    EXIF_FIELD(IFD_EXIF, PATCH_DATA,  TAG_EXPOSURE_TIME,       exposure_time),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_ISO_SPEED_RATING,    iso_speed_rating),
+    EXIF_FIELD(IFD_EXIF, PATCH_DATA,  TAG_DATE_TIME_ORIGINAL,  date_time),
+    EXIF_FIELD(IFD_EXIF, PATCH_DATA,  TAG_DATE_TIME_DIGITIZED, date_time),
+    EXIF_FIELD(IFD_EXIF, PATCH_DATA,  TAG_SHUTTER_SPEED,       shutter_speed),
+    EXIF_FIELD(IFD_EXIF, PATCH_DATA,  TAG_BRIGHTNESS,          brightness),
+    EXIF_FIELD(IFD_EXIF, PATCH_DATA,  TAG_EXPOSURE_BIAS,       exposure_bias),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_METERING_MODE,       metering_mode),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_FLASH,               flash),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_PIXEL_X_DIMENSION,   width),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_PIXEL_Y_DIMENSION,   height),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_WHITE_BALANCE,       white_balance),
+    EXIF_FIELD(IFD_EXIF, PATCH_VALUE, TAG_SCENE_CAPTURE_TYPE,  scene_capture_type),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_LATITUDE_REF,    gps_latitude_ref),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_LATITUDE,        gps_latitude),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_LONGITUDE_REF,   gps_longitude_ref),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_LONGITUDE,       gps_longitude),
+    EXIF_FIELD(IFD_GPS,  PATCH_VALUE, TAG_GPS_ALTITUDE_REF,    gps_altitude_ref),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_ALTITUDE,        gps_altitude),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_TIMESTAMP,       gps_timestamp),
+    EXIF_FIELD(IFD_GPS,  PATCH_DATA,  TAG_GPS_DATESTAMP,       gps_datestamp),
+    EXIF_FIELD(IFD_1,    PATCH_VALUE, TAG_IMAGE_WIDTH,         widthThumb),
+    EXIF_FIELD(IFD_1,    PATCH_VALUE, TAG_IMAGE_HEIGHT,        heightThumb),
+    EXIF_FIELD(IFD_1,    PATCH_VALUE, TAG_ORIENTATION,         orientation),
+};
+
+#define NUM_EXIF_FIELDS (sizeof(exifFields) / sizeof(exifFields[0]))
+
+/* makeExif() writes the TIFF structure little endian */
+static inline uint32_t rd16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t rd32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void wr32(unsigned char *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static unsigned int typeSize(unsigned int type)
+{
+    switch (type) {
+    case 1:     /* BYTE */
+    case 2:     /* ASCII */
+    case 7:     /* UNDEFINED */
+        return 1;
+    case 3:     /* SHORT */
+        return 2;
+    case 4:     /* LONG */
+    case 9:     /* SLONG */
+        return 4;
+    case 5:     /* RATIONAL */
+    case 10:    /* SRATIONAL */
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static unsigned int gpsMethodLength(const exif_attribute_t *exifInfo)
+{
+    if (!exifInfo->enableGps)
+        return 0;
+    /* not always terminated, makeExif() stops at 100 bytes */
+    const unsigned char *method = exifInfo->gps_processing_method;
+    unsigned int len = 0;
+    while (len < sizeof(exifInfo->gps_processing_method) && len < 100 && method[len])
+        len++;
+    return len;
+}
+
+SecCameraExifTemplate::SecCameraExifTemplate()
+{
+    typedef char field_count_check[NUM_EXIF_FIELDS == FIELD_COUNT ? 1 : -1];
+    (void)sizeof(field_count_check);
+
+    invalidate();
+}
+
+void SecCameraExifTemplate::invalidate(void)
+{
+    mValid = false;
+    mSize = 0;
+}
+
+bool SecCameraExifTemplate::matches(const exif_attribute_t *exifInfo, bool thumb) const
+{
+    return mValid &&
+           mGps == exifInfo->enableGps &&
+           mThumb == thumb &&
+           mGpsMethodLength == gpsMethodLength(exifInfo);
+}
+
+bool SecCameraExifTemplate::parseIfd(int ifd, uint32_t start, uint32_t *next,
+                                     uint32_t *exif, uint32_t *gps)
+{
+    uint32_t pos = TIFF_START + start;
+
+    if (start == 0 || pos + 2 > mSize)
+        return false;
+
+    unsigned int entries = rd16(mData + pos);
+    pos += 2;
+    if (pos + entries * IFD_ENTRY_SIZE + 4 > mSize)
+        return false;
+
+    for (unsigned int i = 0; i < entries; i++, pos += IFD_ENTRY_SIZE) {
+        const unsigned char *entry = mData + pos;
+        unsigned int tag = rd16(entry);
+        unsigned int length = typeSize(rd16(entry + 2)) * rd32(entry + 4);
+        uint32_t value = length <= 4 ? pos + 8 : TIFF_START + rd32(entry + 8);
+
+        if (length > MAX_SIZE || value + length > mSize)
+            return false;
+
+        Location location = { (uint16_t)value, (uint16_t)length };
+
+        if (ifd == IFD_0 && tag == TAG_EXIF_IFD_POINTER)
+            *exif = rd32(entry + 8);
+        if (ifd == IFD_0 && tag == TAG_GPS_IFD_POINTER)
+            *gps = rd32(entry + 8);
+        if (ifd == IFD_GPS && tag == TAG_GPS_PROCESSING_METHOD) {
+            mGpsMethod = location;
+            continue;
+        }
+        if (ifd == IFD_1 && tag == TAG_JPEG_INTERCHANGE_FORMAT)
+            mThumbOffset = rd32(entry + 8);
+        if (ifd == IFD_1 && tag == TAG_JPEG_INTERCHANGE_LENGTH)
+            mThumbLength = location;
+
+        for (unsigned int f = 0; f < NUM_EXIF_FIELDS; f++) {
+            if (exifFields[f].ifd == ifd && exifFields[f].tag == tag) {
+                mFields[f] = location;
+                break;
+            }
+        }
+    }
+
+    *next = rd32(mData + pos);
+    return true;
+}
+
+bool SecCameraExifTemplate::build(const unsigned char *app1, unsigned int size,
+                                  const exif_attribute_t *exifInfo, bool thumb)
+{
+    invalidate();
+
+    if (size < TIFF_START + 8 || size > 0xffff + 2 ||
+        app1[0] != 0xff || app1[1] != 0xe1 ||
+        memcmp(app1 + 4, "Exif\0\0", 6) || app1[TIFF_START] != 'I') {
+        ALOGW("%s: not a little endian EXIF block", __func__);
+        return false;
+    }
+
+    memset(mFields, 0, sizeof(mFields));
+    memset(&mGpsMethod, 0, sizeof(mGpsMethod));
+    memset(&mThumbLength, 0, sizeof(mThumbLength));
+    mThumbOffset = 0;
+
+    /* everything up to the thumbnail, which makeExif() puts last */
+    mSize = size < MAX_SIZE ? size : (unsigned int)MAX_SIZE;
+    memcpy(mData, app1, mSize);
+
+    uint32_t next, exif = 0, gps = 0, unused;
+    if (!parseIfd(IFD_0, rd32(mData + TIFF_START + 4), &next, &exif, &gps))
+        goto fail;
+
+    if (!parseIfd(IFD_EXIF, exif, &unused, &unused, &unused))
+        goto fail;
+    if (exifInfo->enableGps && !parseIfd(IFD_GPS, gps, &unused, &unused, &unused))
+        goto fail;
+
+    if (thumb) {
+        if (!parseIfd(IFD_1, next, &unused, &unused, &unused) || !mThumbLength.offset ||
+            TIFF_START + mThumbOffset > MAX_SIZE ||
+            TIFF_START + mThumbOffset + rd32(mData + mThumbLength.offset) != size)
+            goto fail;
+        mSize = TIFF_START + mThumbOffset;
+    } else if (size > MAX_SIZE) {
+        goto fail;
+    }
+
+    for (unsigned int f = 0; f < NUM_EXIF_FIELDS; f++) {
+        const ExifField &field = exifFields[f];
+        if ((field.ifd == IFD_GPS && !exifInfo->enableGps) || (field.ifd == IFD_1 && !thumb))
+            continue;
+        if (!mFields[f].offset ||
+            (field.kind == PATCH_VALUE && mFields[f].length > 4)) {
+            ALOGW("%s: tag 0x%04x missing or unexpected", __func__, field.tag);
+            goto fail;
+        }
+    }
+
+    mGps = exifInfo->enableGps;
+    mThumb = thumb;
+    mGpsMethodLength = gpsMethodLength(exifInfo);
+    if (mGpsMethodLength &&
+        mGpsMethod.length != GPS_METHOD_PREFIX_SIZE + mGpsMethodLength)
+        goto fail;
+
+    ALOGV("%s: %d byte template, gps %d thumbnail %d", __func__, mSize, mGps, mThumb);
+    mValid = true;
+    return true;
+
+fail:
+    ALOGW("%s: unexpected EXIF layout, not using a template", __func__);
+    invalidate();
+    return false;
+}
+
+unsigned int SecCameraExifTemplate::make(unsigned char *app1, const exif_attribute_t *exifInfo,
+                                         const unsigned char *thumb,
+                                         unsigned int thumbSize) const
+{
+    memcpy(app1, mData, mSize);
+
+    for (unsigned int f = 0; f < NUM_EXIF_FIELDS; f++) {
+        const ExifField &field = exifFields[f];
+        const Location &location = mFields[f];
+        const unsigned char *member = (const unsigned char *)exifInfo + field.member;
+
+        if (!location.offset)
+            continue;
+
+        if (field.kind == PATCH_VALUE) {
+            uint32_t value;
+            if (field.size == 1)
+                value = *member;
+            else if (field.size == 2)
+                value = *(const uint16_t *)member;
+            else
+                value = *(const uint32_t *)member;
+            wr32(app1 + location.offset, value);
+        } else {
+            memcpy(app1 + location.offset, member,
+                   location.length < field.size ? location.length : field.size);
+        }
+    }
+
+    if (mGpsMethodLength)
+        memcpy(app1 + mGpsMethod.offset + GPS_METHOD_PREFIX_SIZE,
+               exifInfo->gps_processing_method, mGpsMethodLength);
+
+    unsigned int size = mSize;
+    if (mThumb) {
+        memcpy(app1 + size, thumb, thumbSize);
+        wr32(app1 + mThumbLength.offset, thumbSize);
+        size += thumbSize;
+    }
+
+    /* big endian, the marker isn't counted */
+    app1[2] = (size - 2) >> 8;
+    app1[3] = (size - 2) & 0xff;
+
+    return size;
+}
+
+}; // namespace android
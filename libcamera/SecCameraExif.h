@@ -0,0 +1,84 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_EXIF_H
+#define ANDROID_HARDWARE_CAMERA_SEC_EXIF_H
+
+#include <stdint.h>
+#include "JpegEncoder.h"
+
+namespace android {
+
+/*
+ * The EXIF APP1 block of a capture, kept as a template between shots.
+ * The layout is taken from a block JpegEncoder::makeExif() built, so the
+ * IFD structure and the attributes that only change with the sensor are
+ * serialized once; the next shots with the same layout only patch the
+ * per-shot values in place and append the thumbnail.
+ */
+class SecCameraExifTemplate {
+public:
+    SecCameraExifTemplate();
+
+    /* drops the template, for when the fixed attributes change */
+    void            invalidate(void);
+
+    /* true if a shot with these attributes has the template's layout */
+    bool            matches(const exif_attribute_t *exifInfo, bool thumb) const;
+
+    /* takes the layout of an APP1 block makeExif() built for exifInfo,
+     * false if it can't be used as a template */
+    bool            build(const unsigned char *app1, unsigned int size,
+                          const exif_attribute_t *exifInfo, bool thumb);
+
+    /* size of the APP1 block make() writes with a thumbnail of thumbSize */
+    unsigned int    size(unsigned int thumbSize) const
+                        { return mThumb ? mSize + thumbSize : mSize; }
+
+    /* writes the APP1 block of a shot matching the template, returns its size */
+    unsigned int    make(unsigned char *app1, const exif_attribute_t *exifInfo,
+                         const unsigned char *thumb, unsigned int thumbSize) const;
+
+private:
+    /* FIELD_COUNT is the number of entries in the patch table */
+    enum { MAX_SIZE = 2048, FIELD_COUNT = 28 };
+
+    struct Location {
+        uint16_t    offset;     /* of the value in mData, 0 if absent */
+        uint16_t    length;
+    };
+
+    bool            parseIfd(int ifd, uint32_t start, uint32_t *next,
+                             uint32_t *exif, uint32_t *gps);
+
+    unsigned char   mData[MAX_SIZE];
+    unsigned int    mSize;
+    bool            mValid;
+
+    bool            mGps;
+    bool            mThumb;
+    unsigned int    mGpsMethodLength;
+
+    Location        mFields[FIELD_COUNT];
+    Location        mGpsMethod;
+    Location        mThumbLength;
+    uint32_t        mThumbOffset;
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_EXIF_H
@@ -0,0 +1,860 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SecCameraFakeDevice"
+#include <utils/Log.h>
+
+#include "SecCameraFakeDevice.h"
+#include "SecCameraDevice.h"
+#include "SecCamera.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace android {
+
+#define FAKE_FD_BASE        0x4000      /* far above what the process has open */
+#define FAKE_NODES          2
+#define FAKE_RESET_INPUT    1000        /* VIDIOC_S_INPUT index restarting the sensor */
+#define FAKE_PADDR_BASE     0x40000000
+#define FAKE_ALIGN(x)       (((x) + 0xFFF) & ~0xFFF)
+#define FAKE_DQBUF_TIMEOUT  10000000000LL   /* ns, a blocking DQBUF gives up */
+
+/* CE147 puts the YUYV postview behind the main JPEG */
+#define FAKE_POSTVIEW_SIZE  (BACK_CAMERA_POSTVIEW_WIDE_WIDTH * BACK_CAMERA_POSTVIEW_HEIGHT * \
+                             BACK_CAMERA_POSTVIEW_BPP / 8)
+
+struct FakeBuffer {
+    unsigned char   *mem;       /* for V4L2_MEMORY_MMAP */
+    unsigned long   userptr;    /* for V4L2_MEMORY_USERPTR */
+    size_t          length;
+    nsecs_t         timestamp;  /* monotonic */
+    __u32           sequence;
+    __u32           bytesused;
+};
+
+struct FakeNode {
+    const char      *path;
+    bool            open;
+    int             input;
+
+    __u32           width;
+    __u32           height;
+    __u32           pixelformat;
+    __u32           sizeimage;
+    bool            jpeg;
+
+    enum v4l2_memory memory;
+    int             count;
+    FakeBuffer      buffers[MAX_BUFFERS];
+    int             queued[MAX_BUFFERS];    /* FIFO of buffers the HAL gave us */
+    int             queuedCount;
+    int             done[MAX_BUFFERS];      /* FIFO of filled buffers */
+    int             doneCount;
+
+    bool            streaming;
+    nsecs_t         ideal;      /* when the next frame is due without jitter */
+    nsecs_t         due;        /* when it comes */
+    nsecs_t         captureAt;  /* of a pending JPEG capture, 0 if none */
+    __u32           sequence;
+    __u32           jpegSize;   /* of the last JPEG */
+
+    unsigned int    delivered;
+    unsigned int    dropped;
+};
+
+static const char *fakeNodePaths[FAKE_NODES] = {
+    CAMERA_DEV_NAME,
+    CAMERA_DEV_NAME2,
+};
+
+static const __u32 fakeFormats[] = {
+    V4L2_PIX_FMT_NV12,
+    V4L2_PIX_FMT_NV12T,
+    V4L2_PIX_FMT_NV21,
+    V4L2_PIX_FMT_YUV420,
+    V4L2_PIX_FMT_YVU420,
+    V4L2_PIX_FMT_YUV422P,
+    V4L2_PIX_FMT_YUYV,
+    V4L2_PIX_FMT_UYVY,
+    V4L2_PIX_FMT_RGB565,
+    V4L2_PIX_FMT_JPEG,
+};
+
+static Mutex                        fakeLock;
+static Condition                    fakeCond;
+static SecCameraFakeDevice::Config  fakeConfig;
+static FakeNode                     fakeNodes[FAKE_NODES];
+static int                          fakeFrameRate;  /* the sensor's, 0 for auto */
+static nsecs_t                      fakeStallUntil;
+static bool                         fakeHung;
+static unsigned int                 fakeEsdCount;
+static unsigned int                 fakeResets;
+static unsigned int                 fakeSeed;
+
+// ======================================================================
+// Sensor
+
+static nsecs_t framePeriod(void)
+{
+    int fps = fakeFrameRate > 0 ? fakeFrameRate : fakeConfig.fps;
+    return s2ns(1) / (fps > 0 ? fps : 30);
+}
+
+static nsecs_t frameJitter(void)
+{
+    int jitter = fakeConfig.jitterUs;
+    if (jitter <= 0)
+        return 0;
+    return us2ns((int)(rand_r(&fakeSeed) % (2 * jitter + 1)) - jitter);
+}
+
+static void scheduleFrames(FakeNode *node, nsecs_t now)
+{
+    node->ideal = now + framePeriod();
+    node->due = node->ideal + frameJitter();
+}
+
+static __u32 postviewOffset(void)
+{
+    return FAKE_ALIGN(fakeConfig.jpegSize);
+}
+
+/* rows of a moving gradient in the luma, or in both for packed formats,
+ * flat chroma after it */
+static void fillFrame(unsigned char *dst, size_t size, __u32 width, __u32 height,
+                      __u32 pixelformat, __u32 sequence)
+{
+    bool packed = pixelformat == V4L2_PIX_FMT_YUYV ||
+                  pixelformat == V4L2_PIX_FMT_UYVY ||
+                  pixelformat == V4L2_PIX_FMT_RGB565;
+    size_t row = packed ? width * 2 : width;
+    size_t y;
+
+    for (y = 0; y < height && (y + 1) * row <= size; y++)
+        memset(dst + y * row, (y + sequence * 2) & 0xff, row);
+    memset(dst + y * row, 128, size - y * row);
+}
+
+static void putMarker(unsigned char **p, unsigned char marker, unsigned int length)
+{
+    unsigned char *cur = *p;
+
+    cur[0] = 0xff;
+    cur[1] = marker;
+    cur[2] = length >> 8;
+    cur[3] = length & 0xff;
+    *p = cur + 4;
+}
+
+/* a baseline JPEG of fakeConfig.jpegSize bytes, returns its size */
+static __u32 fillJpeg(const FakeNode *node, unsigned char *dst)
+{
+    unsigned char *cur = dst;
+    unsigned char *end = dst + fakeConfig.jpegSize - 2;
+
+    *cur++ = 0xff;
+    *cur++ = 0xd8;
+
+    putMarker(&cur, 0xdb, 67);
+    *cur++ = 0;
+    for (int i = 0; i < 64; i++)
+        *cur++ = 1 + i / 4;
+
+    putMarker(&cur, 0xc0, 17);
+    *cur++ = 8;
+    *cur++ = node->height >> 8;
+    *cur++ = node->height & 0xff;
+    *cur++ = node->width >> 8;
+    *cur++ = node->width & 0xff;
+    *cur++ = 3;
+    for (int c = 1; c <= 3; c++) {
+        *cur++ = c;
+        *cur++ = c == 1 ? 0x21 : 0x11;
+        *cur++ = c == 1 ? 0 : 1;
+    }
+
+    putMarker(&cur, 0xda, 12);
+    *cur++ = 3;
+    for (int c = 1; c <= 3; c++) {
+        *cur++ = c;
+        *cur++ = c == 1 ? 0x00 : 0x11;
+    }
+    *cur++ = 0;
+    *cur++ = 63;
+    *cur++ = 0;
+
+    /* entropy data, with 0xff stuffed as the encoder does */
+    while (cur < end) {
+        unsigned char b = rand_r(&fakeSeed);
+        if (b == 0xff && cur + 1 < end) {
+            *cur++ = 0xff;
+            b = 0;
+        } else if (b == 0xff) {
+            b = 0xfe;
+        }
+        *cur++ = b;
+    }
+
+    *cur++ = 0xff;
+    *cur++ = 0xd9;
+    return cur - dst;
+}
+
+static void deliver(FakeNode *node, nsecs_t at)
+{
+    int index = node->queued[0];
+    FakeBuffer *buf = &node->buffers[index];
+    unsigned char *dst = node->memory == V4L2_MEMORY_USERPTR ?
+                         (unsigned char *)buf->userptr : buf->mem;
+
+    memmove(node->queued, node->queued + 1, --node->queuedCount * sizeof(int));
+
+    if (node->jpeg) {
+        node->jpegSize = fillJpeg(node, dst);
+        fillFrame(dst + postviewOffset(), FAKE_POSTVIEW_SIZE, BACK_CAMERA_POSTVIEW_WIDE_WIDTH,
+                  BACK_CAMERA_POSTVIEW_HEIGHT, V4L2_PIX_FMT_YUYV, node->sequence);
+        buf->bytesused = buf->length;
+    } else {
+        size_t size = node->sizeimage < buf->length ? node->sizeimage : buf->length;
+        fillFrame(dst, size, node->width, node->height, node->pixelformat, node->sequence);
+        buf->bytesused = size;
+    }
+
+    buf->timestamp = at;
+    buf->sequence = node->sequence++;
+    node->done[node->doneCount++] = index;
+    node->delivered++;
+}
+
+/* brings the node up to 'now', filling or dropping the frames that came due */
+static void advance(FakeNode *node, nsecs_t now)
+{
+    if (!node->streaming)
+        return;
+
+    if (node->jpeg) {
+        if (node->captureAt && node->captureAt <= now && node->queuedCount) {
+            deliver(node, node->captureAt);
+            node->captureAt = 0;
+        }
+        return;
+    }
+
+    if (fakeHung)
+        return;
+
+    nsecs_t period = framePeriod();
+
+    /* nobody looked for a long time, don't walk through every frame */
+    if (now - node->ideal > s2ns(1)) {
+        nsecs_t missed = (now - node->ideal) / period;
+        node->ideal += missed * period;
+        node->due = node->ideal + frameJitter();
+        node->sequence += missed;
+        node->dropped += missed;
+    }
+
+    while (node->due <= now) {
+        nsecs_t at = node->due;
+
+        if (at < fakeStallUntil) {
+            node->ideal = fakeStallUntil;
+            node->due = fakeStallUntil;
+            continue;
+        }
+
+        node->ideal += period;
+        node->due = node->ideal + frameJitter();
+        if (node->due <= at)
+            node->due = at + 1;
+
+        if (!node->queuedCount) {
+            node->sequence++;
+            node->dropped++;
+            continue;
+        }
+        deliver(node, at);
+
+        if (node == &fakeNodes[0] && fakeConfig.esdInterval > 0 &&
+            ++fakeEsdCount >= (unsigned int)fakeConfig.esdInterval) {
+            ALOGI("%s: sensor hangs after %d frames", __func__, fakeEsdCount);
+            fakeEsdCount = 0;
+            fakeHung = true;
+            return;
+        }
+    }
+}
+
+/* when advance() may next have something to do, 0 if only the HAL can tell */
+static nsecs_t nextEvent(const FakeNode *node)
+{
+    if (!node->streaming)
+        return 0;
+    if (node->jpeg)
+        return node->queuedCount ? node->captureAt : 0;
+    if (fakeHung)
+        return 0;
+    return node->due > fakeStallUntil ? node->due : fakeStallUntil;
+}
+
+static void resetSensor(nsecs_t now)
+{
+    ALOGI("%s: sensor restarted", __func__);
+    fakeHung = false;
+    fakeStallUntil = 0;
+    fakeEsdCount = 0;
+    fakeResets++;
+
+    for (int n = 0; n < FAKE_NODES; n++) {
+        if (fakeNodes[n].streaming && !fakeNodes[n].jpeg)
+            scheduleFrames(&fakeNodes[n], now);
+    }
+    fakeCond.broadcast();
+}
+
+// ======================================================================
+// Nodes
+
+static FakeNode *fakeNode(int fd)
+{
+    int n = fd - FAKE_FD_BASE;
+
+    if (n < 0 || n >= FAKE_NODES || !fakeNodes[n].open)
+        return NULL;
+    return &fakeNodes[n];
+}
+
+static void freeBuffers(FakeNode *node)
+{
+    for (int i = 0; i < node->count; i++)
+        free(node->buffers[i].mem);
+    memset(node->buffers, 0, sizeof(node->buffers));
+    node->count = 0;
+    node->queuedCount = 0;
+    node->doneCount = 0;
+}
+
+/* the counters run on until install() */
+static void resetNode(FakeNode *node, const char *path)
+{
+    unsigned int delivered = node->delivered;
+    unsigned int dropped = node->dropped;
+
+    freeBuffers(node);
+    memset(node, 0, sizeof(*node));
+    node->path = path;
+    node->memory = V4L2_MEMORY_MMAP;
+    node->delivered = delivered;
+    node->dropped = dropped;
+}
+
+static int fail(int error)
+{
+    errno = error;
+    return -1;
+}
+
+/* waits for a filled buffer, false once the deadline passed (0 for none) */
+static bool waitDone(FakeNode *node, nsecs_t deadline)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    for (;;) {
+        advance(node, now);
+        if (node->doneCount)
+            return true;
+        if (deadline && now >= deadline)
+            return false;
+
+        nsecs_t wake = nextEvent(node);
+        if (deadline && (!wake || deadline < wake))
+            wake = deadline;
+        if (wake)
+            fakeCond.waitRelative(fakeLock, wake > now ? wake - now : 0);
+        else
+            fakeCond.wait(fakeLock);
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+}
+
+static int reqbufs(FakeNode *node, struct v4l2_requestbuffers *req)
+{
+    if (node->streaming)
+        return fail(EBUSY);
+    if (req->memory != V4L2_MEMORY_MMAP && req->memory != V4L2_MEMORY_USERPTR)
+        return fail(EINVAL);
+
+    freeBuffers(node);
+    node->memory = (enum v4l2_memory)req->memory;
+    node->count = req->count < MAX_BUFFERS ? req->count : MAX_BUFFERS;
+
+    for (int i = 0; i < node->count; i++) {
+        FakeBuffer *buf = &node->buffers[i];
+        if (node->memory == V4L2_MEMORY_USERPTR)
+            continue;
+
+        buf->length = node->jpeg ? postviewOffset() + FAKE_POSTVIEW_SIZE :
+                                   FAKE_ALIGN(node->sizeimage);
+        if (posix_memalign((void **)&buf->mem, getpagesize(), buf->length)) {
+            buf->mem = NULL;
+            freeBuffers(node);
+            return fail(ENOMEM);
+        }
+    }
+
+    req->count = node->count;
+    return 0;
+}
+
+static int qbuf(FakeNode *node, struct v4l2_buffer *v4l2_buf)
+{
+    int index = v4l2_buf->index;
+
+    if (index < 0 || index >= node->count || v4l2_buf->memory != node->memory)
+        return fail(EINVAL);
+    for (int i = 0; i < node->queuedCount; i++) {
+        if (node->queued[i] == index)
+            return fail(EINVAL);
+    }
+    for (int i = 0; i < node->doneCount; i++) {
+        if (node->done[i] == index)
+            return fail(EINVAL);
+    }
+
+    FakeBuffer *buf = &node->buffers[index];
+    if (node->memory == V4L2_MEMORY_USERPTR) {
+        if (!v4l2_buf->m.userptr || v4l2_buf->length < node->sizeimage)
+            return fail(EINVAL);
+        buf->userptr = v4l2_buf->m.userptr;
+        buf->length = v4l2_buf->length;
+    }
+
+    node->queued[node->queuedCount++] = index;
+    fakeCond.broadcast();
+    return 0;
+}
+
+static int dqbuf(FakeNode *node, struct v4l2_buffer *v4l2_buf)
+{
+    if (!node->streaming)
+        return fail(EINVAL);
+    if (!waitDone(node, systemTime(SYSTEM_TIME_MONOTONIC) + FAKE_DQBUF_TIMEOUT))
+        return fail(EAGAIN);
+
+    int index = node->done[0];
+    FakeBuffer *buf = &node->buffers[index];
+    memmove(node->done, node->done + 1, --node->doneCount * sizeof(int));
+
+    /* the driver stamps with do_gettimeofday() */
+    nsecs_t age = systemTime(SYSTEM_TIME_MONOTONIC) - buf->timestamp;
+    nsecs_t stamp = systemTime(SYSTEM_TIME_REALTIME) - age;
+
+    v4l2_buf->index = index;
+    v4l2_buf->memory = node->memory;
+    v4l2_buf->bytesused = buf->bytesused;
+    v4l2_buf->sequence = buf->sequence;
+    v4l2_buf->field = V4L2_FIELD_NONE;
+    v4l2_buf->timestamp.tv_sec = stamp / s2ns(1);
+    v4l2_buf->timestamp.tv_usec = ns2us(stamp % s2ns(1));
+    v4l2_buf->length = buf->length;
+    if (node->memory == V4L2_MEMORY_USERPTR)
+        v4l2_buf->m.userptr = buf->userptr;
+    return 0;
+}
+
+static int gCtrl(FakeNode *node, struct v4l2_control *ctrl)
+{
+    switch (ctrl->id) {
+    case V4L2_CID_CAM_JPEG_MAIN_SIZE:
+        ctrl->value = node->jpegSize;
+        break;
+    case V4L2_CID_CAM_JPEG_MAIN_OFFSET:
+        ctrl->value = 0;
+        break;
+    case V4L2_CID_CAM_JPEG_POSTVIEW_OFFSET:
+        ctrl->value = postviewOffset();
+        break;
+#ifdef ENABLE_ESD_PREVIEW_CHECK
+    case V4L2_CID_ESD_INT:
+        ctrl->value = fakeHung;
+        break;
+#endif // ENABLE_ESD_PREVIEW_CHECK
+    case V4L2_CID_CAMERA_AUTO_FOCUS_RESULT_FIRST:
+        ctrl->value = AF_SUCCESS;
+        break;
+    case V4L2_CID_CAMERA_GET_SHT_TIME:
+        /* us, exposed for the whole frame */
+        ctrl->value = ns2us(framePeriod());
+        break;
+    case V4L2_CID_CAMERA_GET_ISO:
+        ctrl->value = 100;
+        break;
+    default:
+        ctrl->value = 0;
+        break;
+    }
+    return 0;
+}
+
+static int sCtrl(FakeNode *node, struct v4l2_control *ctrl)
+{
+    int n = node - fakeNodes;
+    int index = ctrl->value;
+
+    switch (ctrl->id) {
+    case V4L2_CID_CAMERA_FRAME_RATE:
+        fakeFrameRate = ctrl->value == FRAME_RATE_AUTO ? 0 : ctrl->value;
+        break;
+    case V4L2_CID_CAMERA_CAPTURE:
+        if (node->jpeg && node->streaming) {
+            node->captureAt = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(fakeConfig.captureDelayMs);
+            fakeCond.broadcast();
+        }
+        break;
+    case V4L2_CID_PADDR_Y:
+    case V4L2_CID_PADDR_CBCR:
+        if (index < 0 || index >= node->count)
+            return fail(EINVAL);
+        ctrl->value = FAKE_PADDR_BASE + (n << 26) + index * FAKE_ALIGN(node->sizeimage);
+        if (ctrl->id == V4L2_CID_PADDR_CBCR)
+            ctrl->value += node->width * node->height;
+        return 0;
+    default:
+        break;
+    }
+
+    /* the driver hands back what the sensor returned, which SecCamera
+     * takes as the result */
+    ctrl->value = 0;
+    return 0;
+}
+
+// ======================================================================
+// Device ops
+
+static int fake_open(const char *path, int flags)
+{
+    Mutex::Autolock lock(fakeLock);
+
+    for (int n = 0; n < FAKE_NODES; n++) {
+        if (strcmp(path, fakeNodePaths[n]))
+            continue;
+        if (fakeNodes[n].open)
+            return fail(EBUSY);
+        resetNode(&fakeNodes[n], fakeNodePaths[n]);
+        fakeNodes[n].open = true;
+        return FAKE_FD_BASE + n;
+    }
+    return fail(ENOENT);
+}
+
+static int fake_close(int fd)
+{
+    Mutex::Autolock lock(fakeLock);
+    FakeNode *node = fakeNode(fd);
+
+    if (node == NULL)
+        return fail(EBADF);
+    resetNode(node, node->path);
+    fakeCond.broadcast();
+    return 0;
+}
+
+static int fake_ioctl(int fd, int request, void *arg)
+{
+    Mutex::Autolock lock(fakeLock);
+    FakeNode *node = fakeNode(fd);
+
+    if (node == NULL)
+        return fail(EBADF);
+
+    switch ((unsigned int)request) {
+    case VIDIOC_QUERYCAP: {
+        struct v4l2_capability *cap = (struct v4l2_capability *)arg;
+        memset(cap, 0, sizeof(*cap));
+        strncpy((char *)cap->driver, "fake-fimc", sizeof(cap->driver) - 1);
+        strncpy((char *)cap->card, node->path, sizeof(cap->card) - 1);
+        cap->capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+        return 0;
+    }
+
+    case VIDIOC_ENUMINPUT: {
+        static const char *names[] = { "CE147", "S5KA3DFX" };
+        struct v4l2_input *input = (struct v4l2_input *)arg;
+        if (input->index >= sizeof(names) / sizeof(names[0]))
+            return fail(EINVAL);
+        strncpy((char *)input->name, names[input->index], sizeof(input->name) - 1);
+        input->type = V4L2_INPUT_TYPE_CAMERA;
+        return 0;
+    }
+
+    case VIDIOC_S_INPUT: {
+        int index = *(int *)arg;
+        if (index == FAKE_RESET_INPUT)
+            resetSensor(systemTime(SYSTEM_TIME_MONOTONIC));
+        else
+            node->input = index;
+        return 0;
+    }
+
+    case VIDIOC_ENUM_FMT: {
+        struct v4l2_fmtdesc *fmtdesc = (struct v4l2_fmtdesc *)arg;
+        if (fmtdesc->index >= sizeof(fakeFormats) / sizeof(fakeFormats[0]))
+            return fail(EINVAL);
+        fmtdesc->pixelformat = fakeFormats[fmtdesc->index];
+        return 0;
+    }
+
+    case VIDIOC_S_FMT: {
+        struct v4l2_pix_format *pix = &((struct v4l2_format *)arg)->fmt.pix;
+        if (node->streaming)
+            return fail(EBUSY);
+        node->width = pix->width;
+        node->height = pix->height;
+        node->pixelformat = pix->pixelformat;
+        node->jpeg = pix->pixelformat == V4L2_PIX_FMT_JPEG;
+        node->sizeimage = pix->sizeimage ? pix->sizeimage : pix->width * pix->height * 2;
+        return 0;
+    }
+
+    case VIDIOC_REQBUFS:
+        return reqbufs(node, (struct v4l2_requestbuffers *)arg);
+
+    case VIDIOC_QUERYBUF: {
+        struct v4l2_buffer *buf = (struct v4l2_buffer *)arg;
+        if ((int)buf->index >= node->count || node->memory != V4L2_MEMORY_MMAP)
+            return fail(EINVAL);
+        buf->length = node->buffers[buf->index].length;
+        buf->m.offset = buf->index * getpagesize();
+        return 0;
+    }
+
+    case VIDIOC_QBUF:
+        return qbuf(node, (struct v4l2_buffer *)arg);
+
+    case VIDIOC_DQBUF:
+        return dqbuf(node, (struct v4l2_buffer *)arg);
+
+    case VIDIOC_STREAMON:
+        node->streaming = true;
+        node->sequence = 0;
+        node->captureAt = 0;
+        scheduleFrames(node, systemTime(SYSTEM_TIME_MONOTONIC));
+        fakeCond.broadcast();
+        return 0;
+
+    case VIDIOC_STREAMOFF:
+        node->streaming = false;
+        node->queuedCount = 0;
+        node->doneCount = 0;
+        node->captureAt = 0;
+        fakeCond.broadcast();
+        return 0;
+
+    case VIDIOC_G_CTRL:
+        return gCtrl(node, (struct v4l2_control *)arg);
+
+    case VIDIOC_S_CTRL:
+        return sCtrl(node, (struct v4l2_control *)arg);
+
+    case VIDIOC_S_EXT_CTRLS:
+        return 0;
+
+    case VIDIOC_G_PARM: {
+        struct v4l2_streamparm *parm = (struct v4l2_streamparm *)arg;
+        parm->parm.capture.timeperframe.numerator = 1;
+        parm->parm.capture.timeperframe.denominator = s2ns(1) / framePeriod();
+        return 0;
+    }
+
+    case VIDIOC_S_PARM: {
+        struct v4l2_fract *tpf = &((struct v4l2_streamparm *)arg)->parm.capture.timeperframe;
+        if (tpf->numerator == 1 && tpf->denominator > 0)
+            fakeFrameRate = tpf->denominator;
+        return 0;
+    }
+    }
+
+    ALOGW("%s: unhandled ioctl %#x", __func__, request);
+    return fail(ENOTTY);
+}
+
+static void *fake_mmap(size_t length, int prot, int flags, int fd, off_t offset)
+{
+    Mutex::Autolock lock(fakeLock);
+    FakeNode *node = fakeNode(fd);
+    int index = offset / getpagesize();
+
+    if (node == NULL || node->memory != V4L2_MEMORY_MMAP ||
+        index < 0 || index >= node->count || length > node->buffers[index].length) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    return node->buffers[index].mem;
+}
+
+/* the buffers belong to the node until REQBUFS or close */
+static int fake_munmap(void *addr, size_t length)
+{
+    return 0;
+}
+
+static int fake_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    Mutex::Autolock lock(fakeLock);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t deadline = timeout < 0 ? 0 : now + ms2ns(timeout);
+
+    for (;;) {
+        nsecs_t wake = deadline;
+        int ready = 0;
+
+        for (nfds_t i = 0; i < nfds; i++) {
+            FakeNode *node = fakeNode(fds[i].fd);
+
+            fds[i].revents = 0;
+            if (node == NULL) {
+                fds[i].revents = POLLNVAL;
+                ready++;
+                continue;
+            }
+
+            advance(node, now);
+            if (node->doneCount) {
+                fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
+                ready++;
+                continue;
+            }
+
+            nsecs_t next = nextEvent(node);
+            if (next && (!wake || next < wake))
+                wake = next;
+        }
+
+        if (ready || (deadline && now >= deadline))
+            return ready;
+
+        if (wake)
+            fakeCond.waitRelative(fakeLock, wake > now ? wake - now : 0);
+        else
+            fakeCond.wait(fakeLock);
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+}
+
+static const SecCameraDeviceOps fakeOps = {
+    fake_open,
+    fake_close,
+    fake_ioctl,
+    fake_mmap,
+    fake_munmap,
+    fake_poll,
+};
+
+// ======================================================================
+// Control
+
+void SecCameraFakeDevice::defaultConfig(Config *config)
+{
+    config->fps = 30;
+    config->jitterUs = 2000;
+    config->captureDelayMs = 250;
+    config->jpegSize = 1 << 20;
+    config->esdInterval = 0;
+}
+
+void SecCameraFakeDevice::install(const Config& config)
+{
+    Mutex::Autolock lock(fakeLock);
+
+    for (int n = 0; n < FAKE_NODES; n++) {
+        resetNode(&fakeNodes[n], fakeNodePaths[n]);
+        fakeNodes[n].delivered = 0;
+        fakeNodes[n].dropped = 0;
+    }
+
+    fakeConfig = config;
+    if (fakeConfig.jpegSize < 1024)
+        fakeConfig.jpegSize = 1024;
+    fakeFrameRate = 0;
+    fakeStallUntil = 0;
+    fakeHung = false;
+    fakeEsdCount = 0;
+    fakeResets = 0;
+    fakeSeed = 1;
+
+    setSecCameraDeviceOps(&fakeOps);
+}
+
+void SecCameraFakeDevice::uninstall(void)
+{
+    setSecCameraDeviceOps(NULL);
+}
+
+void SecCameraFakeDevice::stall(nsecs_t duration)
+{
+    Mutex::Autolock lock(fakeLock);
+
+    fakeStallUntil = systemTime(SYSTEM_TIME_MONOTONIC) + duration;
+    fakeCond.broadcast();
+}
+
+void SecCameraFakeDevice::hang(void)
+{
+    Mutex::Autolock lock(fakeLock);
+
+    fakeHung = true;
+    fakeCond.broadcast();
+}
+
+void SecCameraFakeDevice::dump(String8& result)
+{
+    Mutex::Autolock lock(fakeLock);
+
+    result.appendFormat("Fake FIMC: %d fps%s, %d us jitter, sensor resets %u\n",
+                        (int)(s2ns(1) / framePeriod()), fakeFrameRate ? "" : " (auto)",
+                        fakeConfig.jitterUs, fakeResets);
+    for (int n = 0; n < FAKE_NODES; n++) {
+        result.appendFormat("  %s: %u frames, %u dropped\n", fakeNodePaths[n],
+                            fakeNodes[n].delivered, fakeNodes[n].dropped);
+    }
+}
+
+unsigned int SecCameraFakeDevice::delivered(void)
+{
+    Mutex::Autolock lock(fakeLock);
+    return fakeNodes[0].delivered + fakeNodes[1].delivered;
+}
+
+unsigned int SecCameraFakeDevice::dropped(void)
+{
+    Mutex::Autolock lock(fakeLock);
+    return fakeNodes[0].dropped + fakeNodes[1].dropped;
+}
+
+unsigned int SecCameraFakeDevice::resets(void)
+{
+    Mutex::Autolock lock(fakeLock);
+    return fakeResets;
+}
+
+}; // namespace android
@@ -0,0 +1,72 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_FAKE_DEVICE_H
+#define ANDROID_HARDWARE_CAMERA_SEC_FAKE_DEVICE_H
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/*
+ * An in-process FIMC with a sensor behind it, installed as the backend of
+ * SecCameraDevice so SecCamera runs on a workstation.  /dev/video0 and
+ * /dev/video2 stream synthetic YUV frames at the rate the HAL asks for,
+ * with random jitter, and a JPEG capture returns a CE147 style buffer: the
+ * main JPEG at the main offset and a YUYV postview at the postview offset.
+ * Frames that come due while the HAL has no buffer queued are dropped and
+ * counted, like the real driver does.
+ *
+ * The JPEG has valid markers around random entropy data, so it parses but
+ * doesn't decode.
+ */
+class SecCameraFakeDevice {
+public:
+    struct Config {
+        int     fps;                /* when the HAL asks for FRAME_RATE_AUTO */
+        int     jitterUs;           /* frames come up to this much early or late */
+        int     captureDelayMs;     /* from V4L2_CID_CAMERA_CAPTURE to the JPEG */
+        int     jpegSize;           /* of the main JPEG */
+        int     esdInterval;        /* preview frames between sensor hangs, 0 for none */
+    };
+
+    static void     defaultConfig(Config *config);
+
+    /* routes SecCameraDevice to the fake, resetting it and its counters */
+    static void     install(const Config& config);
+    static void     uninstall(void);
+
+    /* no preview frames for a while, as when the sensor hiccups */
+    static void     stall(nsecs_t duration);
+
+    /* the sensor stops until the HAL resets it with VIDIOC_S_INPUT 1000,
+     * V4L2_CID_ESD_INT reads 1 meanwhile */
+    static void     hang(void);
+
+    static void     dump(String8& result);
+
+    /* frames handed to the HAL, dropped for want of a buffer, and sensor
+     * resets, summed over both nodes */
+    static unsigned int delivered(void);
+    static unsigned int dropped(void);
+    static unsigned int resets(void);
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_FAKE_DEVICE_H
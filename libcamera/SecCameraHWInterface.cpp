@@ -22,27 +22,28 @@
 #include <utils/Log.h>
 
 #include "SecCameraHWInterface.h"
+#include "SecCameraParams.h"
 #include "SecCameraUtils.h"
+#include "SecCameraColorConvert.h"
+#include "SecCameraStats.h"
 
+#include <cutils/atomic.h>
+#include <cutils/atomic-inline.h>
 #include <cutils/native_handle.h>
+#include <cutils/properties.h>
 #include <utils/threads.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <camera/Camera.h>
 #include <MetadataBufferType.h>
 
 #define VIDEO_COMMENT_MARKER_H          0xFFBE
 #define VIDEO_COMMENT_MARKER_L          0xFFBF
 #define VIDEO_COMMENT_MARKER_LENGTH     4
-#define JPEG_EOI_MARKER                 0xFFD9
 #define HIBYTE(x) (((x) >> 8) & 0xFF)
 #define LOBYTE(x) ((x) & 0xFF)
 
-#define BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR       "0.10,1.20,Infinity"
-#define BACK_CAMERA_MACRO_FOCUS_DISTANCES_STR      "0.10,0.20,Infinity"
-#define BACK_CAMERA_INFINITY_FOCUS_DISTANCES_STR   "0.10,1.20,Infinity"
-#define FRONT_CAMERA_FOCUS_DISTANCES_STR           "0.20,0.25,Infinity"
-
 // FIXME:
 // -- The actual preview color is set to YV12. The preview frames
 //    returned via preview callback must be generated by color
@@ -72,14 +73,71 @@ struct addrs_cap {
 static const int INITIAL_SKIP_FRAME = 3;
 static const int EFFECT_SKIP_FRAME = 1;
 
+// Preview pacing: shed load once the display and callback work has taken
+// more than HIGH percent of the frame period for ENTER frames in a row, and
+// step back once the lighter setting would stay under LOW for EXIT frames.
+static const int PACING_HIGH_PERCENT = 85;
+static const int PACING_LOW_PERCENT = 70;
+static const int PACING_ENTER_FRAMES = 8;
+static const int PACING_EXIT_FRAMES = 60;
+static const int PACING_MAX_DIVISOR = 4;
+
 gralloc_module_t const* CameraHardwareSec::mGrallocHal;
 
-// Samsung-specific focus mode
-const char FOCUS_MODE_FACEDETECT[] = "facedetect";
+/* gralloc modules whose lock/unlock do no work on a registered buffer,
+ * see lockPreviewBuffer() */
+static const struct {
+    const char  *name;
+    const char  *author;
+} kUnlockedGrallocs[] = {
+    /* hardware/libhardware/modules/gralloc, ashmem buffers */
+    { "Graphics Memory Allocator Module", "The Android Open Source Project" },
+};
+
+static bool grallocNeedsLock(const gralloc_module_t *gralloc)
+{
+    if (!gralloc)
+        return true;
+
+    for (size_t i = 0; i < sizeof(kUnlockedGrallocs) / sizeof(kUnlockedGrallocs[0]); i++) {
+        if (gralloc->common.name && gralloc->common.author &&
+            !strcmp(gralloc->common.name, kUnlockedGrallocs[i].name) &&
+            !strcmp(gralloc->common.author, kUnlockedGrallocs[i].author))
+            return false;
+    }
+
+    return true;
+}
+
+// Burst capture, back camera only.  The interval is in ms.
+const char KEY_BURST_CAPTURE_COUNT[] = "burst-capture-count";
+const char KEY_BURST_CAPTURE_INTERVAL[] = "burst-capture-interval";
+const char KEY_MAX_BURST_CAPTURE_COUNT[] = "max-burst-capture-count";
+static const int MAX_BURST_CAPTURE_COUNT = 10;
+
+// Zero shutter lag, front camera only: shots are taken from the preview
+// stream when the picture size matches it.  Applies from the next
+// startPreview().
+const char KEY_ZSL[] = "zsl";
+const char KEY_SUPPORTED_ZSL_MODES[] = "zsl-values";
+
+// Downscaled preview callbacks for analysis clients: CAMERA_MSG_PREVIEW_FRAME
+// carries a frame of this size instead of the full preview, as NV21 or as
+// the luma plane alone.  "off" keeps the full frame.  Applies from the next
+// startPreview().
+const char KEY_PREVIEW_CALLBACK_SIZE[] = "preview-callback-size";
+const char KEY_SUPPORTED_PREVIEW_CALLBACK_SIZES[] = "preview-callback-size-values";
+const char KEY_PREVIEW_CALLBACK_FORMAT[] = "preview-callback-format";
+const char KEY_SUPPORTED_PREVIEW_CALLBACK_FORMATS[] = "preview-callback-format-values";
+const char PREVIEW_CALLBACK_FORMAT_Y8[] = "y8";
 
 CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
         :
           mCaptureInProgress(false),
+          mPostviewPool("postview"),
+          mThumbnailPool("thumbnail"),
+          mExifPool("exif"),
+          mVideoSnapshotPool("video snapshot"),
           mParameters(),
           mCameraSensorName(NULL),
           mSkipFrame(0),
@@ -88,7 +146,9 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
           mDataCbTimestamp(0),
           mCallbackCookie(0),
           mMsgEnabled(0),
-          mRecordRunning(false),
+          mRecordRunning(0),
+          mRecordBusy(0),
+          mRecordWaiting(0),
           mPostViewWidth(0),
           mPostViewHeight(0),
           mPostViewSize(0),
@@ -98,17 +158,58 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
     int ret = 0;
 
     mPreviewWindow = NULL;
+    mZeroCopyPreview = false;
+    mZeroCopyWindow = NULL;
+    memset(mZeroCopyHandles, 0, sizeof(mZeroCopyHandles));
+    memset(mZeroCopyAddrs, 0, sizeof(mZeroCopyAddrs));
+    mZeroCopyHeld = 0;
+    mZeroCopyMissing = 0;
+    memset(mPreviewMaps, 0, sizeof(mPreviewMaps));
+    mPreviewMapCount = 0;
+    mPreviewMapsStale = 1;
+    mPreviewLocked = false;
+    mPreviewMapHits = 0;
+    mPreviewMapMisses = 0;
     mSecCamera = SecCamera::createInstance();
 
+    mBurstCount = 1;
+    mBurstInterval = 0;
+    invalidateAppliedParams();
+    memset(&mParamStats, 0, sizeof(mParamStats));
+    memset(&mPacing, 0, sizeof(mPacing));
+    mPacing.callbackDivisor = 1;
+    mZslHead = 0;
+    mZslCount = 0;
+    mZslActive = false;
+    mZslCapture = false;
+    mZslShutter = 0;
+    mZslShots = 0;
+    mZslLastOffset = 0;
+
     mRawHeap = NULL;
     mPreviewHeap = NULL;
     mRecordHeap = NULL;
+    mRecordHandlesLive = 0;
+    mNv21Scratch = NULL;
+    mNv21ScratchSize = 0;
+    mScaledHeap = NULL;
+    mScaledWidth = 0;
+    mScaledHeight = 0;
+    mScaledLumaOnly = false;
+    mScaledFrameSize = 0;
+    mScaledIndex = 0;
+    mScaledScratch = NULL;
+    mScaledScratchSize = 0;
 
     if (!mGrallocHal) {
         ret = hw_get_module(GRALLOC_HARDWARE_MODULE_ID, (const hw_module_t **)&mGrallocHal);
         if (ret)
             ALOGE("ERR(%s):Fail on loading gralloc HAL", __func__);
     }
+    mGrallocCached = !grallocNeedsLock(mGrallocHal);
+    if (mGrallocCached)
+        ALOGI("%s: %s needs no lock for known preview buffers", __func__,
+             mGrallocHal->common.name);
 
     ret = mSecCamera->initCamera(cameraId);
     if (ret < 0) {
@@ -122,7 +223,14 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
     initDefaultParameters(cameraId);
 
     mExitAutoFocusThread = false;
+    memset(&mAutoFocusStats, 0, sizeof(mAutoFocusStats));
     mExitPreviewThread = false;
+    mExitJpegThread = false;
+    mJpegJob = NULL;
+    mVideoSnapshotJob = NULL;
+    mVideoSnapshotPending = 0;
+    mVideoSnapshots = 0;
+    mDumpSequence = 0;
     /* whether the PreviewThread is active in preview or stopped.  we
      * create the thread but it is initially in stopped state.
      */
@@ -131,6 +239,7 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
     mPreviewThread = new PreviewThread(this);
     mAutoFocusThread = new AutoFocusThread(this);
     mPictureThread = new PictureThread(this);
+    mJpegThread = new JpegThread(this);
 }
 
 int CameraHardwareSec::getCameraId() const
@@ -328,6 +437,25 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
     p.set("iso-values", "auto,ISO50,ISO100,ISO200,ISO400,ISO800,ISO1600,ISO_SPORTS,ISO_NIGHT");
     p.set("iso", "auto");
 
+    p.set(KEY_BURST_CAPTURE_COUNT, 1);
+    p.set(KEY_BURST_CAPTURE_INTERVAL, 0);
+    p.set(KEY_MAX_BURST_CAPTURE_COUNT,
+          cameraId == SecCamera::CAMERA_ID_BACK ? MAX_BURST_CAPTURE_COUNT : 1);
+    p.set(CameraParameters::KEY_VIDEO_SNAPSHOT_SUPPORTED, CameraParameters::TRUE);
+
+    if (cameraId == SecCamera::CAMERA_ID_BACK) {
+        p.set(KEY_SUPPORTED_ZSL_MODES, "off");
+        p.set(KEY_ZSL, "off");
+    } else {
+        p.set(KEY_SUPPORTED_ZSL_MODES, "off,on");
+        p.set(KEY_ZSL, "on");
+    }
+
+    p.set(KEY_SUPPORTED_PREVIEW_CALLBACK_SIZES, "off,320x240,240x160,176x144,160x120");
+    p.set(KEY_PREVIEW_CALLBACK_SIZE, "off");
+    p.set(KEY_SUPPORTED_PREVIEW_CALLBACK_FORMATS, "yuv420sp,y8");
+    p.set(KEY_PREVIEW_CALLBACK_FORMAT, CameraParameters::PIXEL_FORMAT_YUV420SP);
+
     p.set(CameraParameters::KEY_HORIZONTAL_VIEW_ANGLE, "51.2");
     p.set(CameraParameters::KEY_VERTICAL_VIEW_ANGLE, "39.4");
 
@@ -353,6 +481,18 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
         mSecCamera->setFrameRate(30);
     else
         mSecCamera->setFrameRate(15);
+
+    /* the calls above went around setParameters(), so don't trust mApplied */
+    invalidateAppliedParams();
+}
+
+void CameraHardwareSec::invalidateAppliedParams()
+{
+    /* no setter is ever handed -1, except for exposure compensation which
+     * has its own flag */
+    memset(&mApplied, -1, sizeof(mApplied));
+    mApplied.exposureValid = false;
+    mApplied.gpsValid = false;
 }
 
 CameraHardwareSec::~CameraHardwareSec()
@@ -368,6 +508,9 @@ status_t CameraHardwareSec::setPreviewWindow(preview_stream_ops *w)
     mPreviewWindow = w;
     ALOGV("%s: mPreviewWindow %p", __func__, mPreviewWindow);
 
+    /* the new window comes with its own buffers */
+    android_atomic_release_store(1, &mPreviewMapsStale);
+
     if (!w) {
         ALOGE("preview window is NULL!");
         return OK;
@@ -447,7 +590,7 @@ void CameraHardwareSec::enableMsgType(int32_t msgType)
 {
     ALOGV("%s : msgType = 0x%x, mMsgEnabled before = 0x%x",
          __func__, msgType, mMsgEnabled);
-    mMsgEnabled |= msgType;
+    android_atomic_or(msgType, &mMsgEnabled);
 
     ALOGV("%s : mMsgEnabled = 0x%x", __func__, mMsgEnabled);
 }
@@ -456,7 +599,7 @@ void CameraHardwareSec::disableMsgType(int32_t msgType)
 {
     ALOGV("%s : msgType = 0x%x, mMsgEnabled before = 0x%x",
          __func__, msgType, mMsgEnabled);
-    mMsgEnabled &= ~msgType;
+    android_atomic_and(~msgType, &mMsgEnabled);
     ALOGV("%s : mMsgEnabled = 0x%x", __func__, mMsgEnabled);
 }
 
@@ -468,11 +611,13 @@ bool CameraHardwareSec::msgTypeEnabled(int32_t msgType)
 // ---------------------------------------------------------------------------
 void CameraHardwareSec::setSkipFrame(int frame)
 {
-    Mutex::Autolock lock(mSkipFrameLock);
-    if (frame < mSkipFrame)
-        return;
+    int32_t old;
 
-    mSkipFrame = frame;
+    do {
+        old = mSkipFrame;
+        if (frame < old)
+            return;
+    } while (android_atomic_cmpxchg(old, frame, &mSkipFrame));
 }
 
 int CameraHardwareSec::previewThreadWrapper()
@@ -482,6 +627,8 @@ int CameraHardwareSec::previewThreadWrapper()
         mPreviewLock.lock();
         while (!mPreviewRunning) {
             ALOGI("%s: calling mSecCamera->stopPreview() and waiting", __func__);
+            zslFlush();
+            cancelVideoSnapshot();
             mSecCamera->stopPreview();
             /* signal that we're stopping */
             mPreviewStoppedCondition.signal();
@@ -492,6 +639,8 @@ int CameraHardwareSec::previewThreadWrapper()
 
         if (mExitPreviewThread) {
             ALOGI("%s: exiting", __func__);
+            zslFlush();
+            cancelVideoSnapshot();
             mSecCamera->stopPreview();
             return 0;
         }
@@ -502,10 +651,8 @@ int CameraHardwareSec::previewThreadWrapper()
 int CameraHardwareSec::previewThread()
 {
     int index;
-    nsecs_t timestamp;
     unsigned int phyYAddr;
     unsigned int phyCAddr;
-    struct addrs *addrs;
 
     index = mSecCamera->getPreview();
     if (index < 0) {
@@ -515,25 +662,27 @@ int CameraHardwareSec::previewThread()
 
 //  ALOGV("%s: index %d", __func__, index);
 
-    mSkipFrameLock.lock();
-    if (mSkipFrame > 0) {
-        mSkipFrame--;
-        mSkipFrameLock.unlock();
+    int32_t skip;
+    do {
+        skip = mSkipFrame;
+    } while (skip > 0 && android_atomic_cmpxchg(skip, skip - 1, &mSkipFrame));
+    if (skip > 0) {
         ALOGV("%s: index %d skipping frame", __func__, index);
+        mSecCamera->releasePreviewFrame(index);
         return NO_ERROR;
     }
-    mSkipFrameLock.unlock();
-
-    timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
 
-    phyYAddr = mSecCamera->getPhyAddrY(index);
-    phyCAddr = mSecCamera->getPhyAddrC(index);
+    if (!mZeroCopyPreview) {
+        phyYAddr = mSecCamera->getPhyAddrY(index);
+        phyCAddr = mSecCamera->getPhyAddrC(index);
 
-    if (phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
-        ALOGE("ERR(%s):Fail on SecCamera getPhyAddr Y addr = %0x C addr = %0x",
-             __func__, phyYAddr, phyCAddr);
-        return UNKNOWN_ERROR;
-     }
+        if (phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
+            ALOGE("ERR(%s):Fail on SecCamera getPhyAddr Y addr = %0x C addr = %0x",
+                 __func__, phyYAddr, phyCAddr);
+            mSecCamera->releasePreviewFrame(index);
+            return UNKNOWN_ERROR;
+        }
+    }
 
     int width, height, frame_size, offset;
 
@@ -541,122 +690,547 @@ int CameraHardwareSec::previewThread()
 
     offset = frame_size * index;
 
-    if (mPreviewWindow && mGrallocHal) {
+    // Whether the client gets this frame, decided before the display so the
+    // zero-copy path can still read the window buffer.  The pacing divisor
+    // only changes on this thread.
+    bool callbackWanted = mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME;
+    bool callbackDue = callbackWanted && !(mPacing.frame % mPacing.callbackDivisor);
+    nsecs_t callbackWork = 0;
+    int scaled = -1;
+
+    nsecs_t displayStart = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (mZeroCopyPreview) {
+        // the frame already sits in the window buffer, the client callback
+        // has to take it from there before it goes back to the display
+        if (callbackDue) {
+            nsecs_t t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+            if (mScaledHeap) {
+                scaled = scalePreviewCallback(index, width, height, offset);
+            } else {
+                SecCameraStats::Timer copy(STAGE_PLANE_COPY);
+                copyYv12ToYuv420(((uint8_t *)mPreviewHeap->data) + offset,
+                                 (uint8_t *)mZeroCopyAddrs[index], width,
+                                 width, height);
+            }
+            callbackWork = systemTime(SYSTEM_TIME_MONOTONIC) - t0;
+        }
+
+        swapZeroCopyBuffer(index);
+    } else if (mPreviewWindow && mGrallocHal) {
         buffer_handle_t *buf_handle;
-        int stride;
-        if (0 != mPreviewWindow->dequeue_buffer(mPreviewWindow, &buf_handle, &stride)) {
+        int stride, err;
+        nsecs_t t0, t1;
+
+        t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+        err = mPreviewWindow->dequeue_buffer(mPreviewWindow, &buf_handle, &stride);
+        t1 = systemTime(SYSTEM_TIME_MONOTONIC);
+        SecCameraStats::record(STAGE_WINDOW_DEQUEUE, t1 - t0);
+        if (0 != err) {
             ALOGE("Could not dequeue gralloc buffer!\n");
             goto callbacks;
         }
 
         void *vaddr;
-        if (!mGrallocHal->lock(mGrallocHal,
-                               *buf_handle,
-                               GRALLOC_USAGE_SW_WRITE_OFTEN,
-                               0, 0, width, height, &vaddr)) {
-            char *frame = ((char *)mPreviewHeap->data) + offset;
-
-            // the code below assumes YUV, not RGB
-            {
-                int h;
-                char *src = frame;
-                char *ptr = (char *)vaddr;
-
-                // Copy the Y plane, while observing the stride
-                for (h = 0; h < height; h++) {
-                    memcpy(ptr, src, width);
-                    ptr += stride;
-                    src += width;
-                }
+        err = lockPreviewBuffer(buf_handle, stride, width, height, &vaddr);
+        t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+        SecCameraStats::record(STAGE_GRALLOC_LOCK, t0 - t1);
+        if (!err) {
+            uint8_t *frame = ((uint8_t *)mPreviewHeap->data) + offset;
 
-                {
-                    // U
-                    char *v = ptr;
-                    ptr += stride * height / 4;
-                    for (h = 0; h < height / 2; h++) {
-                        memcpy(ptr, src, width / 2);
-                        ptr += stride / 2;
-                        src += width / 2;
-                    }
-                    // V
-                    ptr = v;
-                    for (h = 0; h < height / 2; h++) {
-                        memcpy(ptr, src, width / 2);
-                        ptr += stride / 2;
-                        src += width / 2;
-                    }
-                }
-            }
+            // FIMC gives us packed YUV420 planar, gralloc wants strided YV12
+            copyYuv420ToYv12((uint8_t *)vaddr, stride, frame, width, height);
 
-            mGrallocHal->unlock(mGrallocHal, *buf_handle);
+            unlockPreviewBuffer(buf_handle);
+            t1 = systemTime(SYSTEM_TIME_MONOTONIC);
+            SecCameraStats::record(STAGE_PLANE_COPY, t1 - t0);
+            t0 = t1;
         }
         else
             ALOGE("%s: could not obtain gralloc buffer", __func__);
 
-        if (0 != mPreviewWindow->enqueue_buffer(mPreviewWindow, buf_handle)) {
+        err = mPreviewWindow->enqueue_buffer(mPreviewWindow, buf_handle);
+        SecCameraStats::record(STAGE_WINDOW_ENQUEUE, systemTime(SYSTEM_TIME_MONOTONIC) - t0);
+        if (0 != err) {
             ALOGE("Could not enqueue gralloc buffer!\n");
             goto callbacks;
         }
     }
 
 callbacks:
-    // Notify the client of a new frame.
-    if (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME) {
-        const char * preview_format = mParameters.getPreviewFormat();
-        if (!strcmp(preview_format, CameraParameters::PIXEL_FORMAT_YUV420SP)) {
-            // Color conversion from YUV420 to NV21
-            char *vu = ((char *)mPreviewHeap->data) + offset + width * height;
-            const int uv_size = (width * height) >> 1;
-            char saved_uv[uv_size];
-            memcpy(saved_uv, vu, uv_size);
-            char *u = saved_uv;
-            char *v = u + (uv_size >> 1);
-
-            int h = 0;
-            while (h < width * height / 4) {
-                *vu++ = *v++;
-                *vu++ = *u++;
-                ++h;
+    nsecs_t displayCost = systemTime(SYSTEM_TIME_MONOTONIC) - displayStart - callbackWork;
+    nsecs_t callbackCost = 0;
+    bool callbackDropped = false;
+    bool nv21 = false;
+
+    // Notify the client of a new frame, unless pacing is thinning them out.
+    if (callbackWanted) {
+        mPacing.frame++;
+        if (!callbackDue) {
+            callbackDropped = true;
+            callbackCost = -1;
+        } else {
+            nsecs_t callbackStart = systemTime(SYSTEM_TIME_MONOTONIC) - callbackWork;
+            if (mScaledHeap) {
+                // scaled from the untouched frame, the full one is never
+                // converted to NV21
+                if (!mZeroCopyPreview)
+                    scaled = scalePreviewCallback(index, width, height, offset);
+                if (scaled >= 0) {
+                    SecCameraStats::Timer callback(STAGE_PREVIEW_CALLBACK);
+                    mDataCb(CAMERA_MSG_PREVIEW_FRAME, mScaledHeap, scaled, NULL,
+                            mCallbackCookie);
+                }
+            } else {
+                const char * preview_format = mParameters.getPreviewFormat();
+                if (!strcmp(preview_format, CameraParameters::PIXEL_FORMAT_YUV420SP) &&
+                    mNv21Scratch) {
+                    // Color conversion from YUV420 to NV21
+                    SecCameraStats::Timer convert(STAGE_NV21_CONVERT);
+                    yuv420ToNv21InPlace(((uint8_t *)mPreviewHeap->data) + offset,
+                                        width, height, mNv21Scratch);
+                    nv21 = true;
+                }
+                SecCameraStats::Timer callback(STAGE_PREVIEW_CALLBACK);
+                mDataCb(CAMERA_MSG_PREVIEW_FRAME, mPreviewHeap, index, NULL, mCallbackCookie);
             }
+            callbackCost = systemTime(SYSTEM_TIME_MONOTONIC) - callbackStart;
         }
-        mDataCb(CAMERA_MSG_PREVIEW_FRAME, mPreviewHeap, index, NULL, mCallbackCookie);
     }
 
-    Mutex::Autolock lock(mRecordLock);
-    if (mRecordRunning == true) {
-        index = mSecCamera->getRecordFrame();
-        if (index < 0) {
-            ALOGE("ERR(%s):Fail on SecCamera->getRecord()", __func__);
-            return UNKNOWN_ERROR;
-        }
+    updatePreviewPacing(displayCost, callbackCost, callbackDropped);
 
-        phyYAddr = mSecCamera->getRecPhyAddrY(index);
-        phyCAddr = mSecCamera->getRecPhyAddrC(index);
+    if (mZslActive)
+        zslPushFrame(index, mSecCamera->getPreviewTimestamp(), nv21);
 
-        if (phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
-            ALOGE("ERR(%s):Fail on SecCamera getRectPhyAddr Y addr = %0x C addr = %0x", __func__,
-                 phyYAddr, phyCAddr);
-            return UNKNOWN_ERROR;
+    /* stopRecording() clears mRecordRunning and then waits for mRecordBusy
+     * to drop, so raise the flag before looking at mRecordRunning */
+    int ret = NO_ERROR;
+    android_atomic_inc(&mRecordBusy);
+    ANDROID_MEMBAR_FULL();
+    if (mRecordRunning)
+        ret = recordFrame();
+    android_atomic_dec(&mRecordBusy);
+    ANDROID_MEMBAR_FULL();
+    if (mRecordWaiting) {
+        Mutex::Autolock lock(mRecordIdleLock);
+        mRecordIdle.broadcast();
+    }
+
+    return ret;
+}
+
+/*
+ * Sets up the downscaled preview callbacks asked for with
+ * preview-callback-size, or goes back to the full frame.  Called from
+ * startPreviewInternal() while the preview thread is idle.
+ */
+void CameraHardwareSec::initScaledCallbacks(int width, int height)
+{
+    int scaledWidth = 0, scaledHeight = 0;
+    const char *size = mParameters.get(KEY_PREVIEW_CALLBACK_SIZE);
+    bool lumaOnly = !strcmp(mParameters.get(KEY_PREVIEW_CALLBACK_FORMAT),
+                            PREVIEW_CALLBACK_FORMAT_Y8);
+
+    if (size && strcmp(size, "off") &&
+        sscanf(size, "%dx%d", &scaledWidth, &scaledHeight) == 2 &&
+        (scaledWidth > width || scaledHeight > height)) {
+        ALOGW("%s: callback size %s larger than the preview, sending full frames",
+              __func__, size);
+        scaledWidth = scaledHeight = 0;
+    }
+
+    if (scaledWidth <= 0 || scaledHeight <= 0) {
+        releaseScaledCallbacks();
+        return;
+    }
+
+    int frameSize = lumaOnly ? scaledWidth * scaledHeight
+                             : scaledWidth * scaledHeight * 3 / 2;
+    if (!mScaledHeap || frameSize != mScaledFrameSize) {
+        if (mScaledHeap)
+            mScaledHeap->release(mScaledHeap);
+        mScaledHeap = mGetMemoryCb(-1, frameSize, kBufferCount, 0);
+        if (!mScaledHeap) {
+            ALOGE("ERR(%s):Fail on scaled callback heap creation", __func__);
+            releaseScaledCallbacks();
+            return;
         }
+    }
 
-        addrs = (struct addrs *)mRecordHeap->data;
+    size_t scratchSize = scaleYuv420ScratchSize(width, scaledWidth, scaledHeight);
+    if (scratchSize != mScaledScratchSize) {
+        free(mScaledScratch);
+        mScaledScratch = (uint8_t *)malloc(scratchSize);
+        mScaledScratchSize = mScaledScratch ? scratchSize : 0;
+        if (!mScaledScratch) {
+            ALOGE("ERR(%s):Fail on scaled callback scratch allocation", __func__);
+            releaseScaledCallbacks();
+            return;
+        }
+    }
 
-        addrs[index].type = kMetadataBufferTypeNativeHandleSource;
+    mScaledWidth = scaledWidth;
+    mScaledHeight = scaledHeight;
+    mScaledLumaOnly = lumaOnly;
+    mScaledFrameSize = frameSize;
+    ALOGV("%s: %dx%d %s preview callbacks", __func__, scaledWidth, scaledHeight,
+          lumaOnly ? PREVIEW_CALLBACK_FORMAT_Y8 : "nv21");
+}
 
-        addrs[index].pHandle = native_handle_create(0 /*numFds*/, 3 /*numInts*/);
-        addrs[index].pHandle->data[0] = phyYAddr;
-        addrs[index].pHandle->data[1] = phyCAddr;
-        addrs[index].pHandle->data[2] = index;
+void CameraHardwareSec::releaseScaledCallbacks(void)
+{
+    if (mScaledHeap) {
+        mScaledHeap->release(mScaledHeap);
+        mScaledHeap = NULL;
+    }
+    free(mScaledScratch);
+    mScaledScratch = NULL;
+    mScaledScratchSize = 0;
+    mScaledWidth = 0;
+    mScaledHeight = 0;
+    mScaledFrameSize = 0;
+}
 
-        // Notify the client of a new frame.
-        if (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME) {
-            mDataCbTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME,
-                             mRecordHeap, index, mCallbackCookie);
-        } else {
-            mSecCamera->releaseRecordFrame(index);
+/*
+ * Downscales preview frame index into the next buffer of mScaledHeap,
+ * straight from the window buffer with zero-copy preview.  Returns the
+ * buffer index, or -1 if the frame couldn't be scaled.
+ */
+int CameraHardwareSec::scalePreviewCallback(int index, int width, int height, int offset)
+{
+    const uint8_t *y, *u, *v;
+    int cstride;
+
+    if (mZeroCopyPreview) {
+        /* YV12 with the luma stride equal to the width */
+        cstride = ((width / 2) + 15) & ~15;
+        y = (const uint8_t *)mZeroCopyAddrs[index];
+        v = y + width * height;
+        u = v + cstride * (height / 2);
+    } else {
+        cstride = width / 2;
+        y = (const uint8_t *)mPreviewHeap->data + offset;
+        u = y + width * height;
+        v = u + cstride * (height / 2);
+    }
+
+    int scaled = mScaledIndex++ % kBufferCount;
+    SecCameraStats::Timer scale(STAGE_CALLBACK_SCALE);
+    if (!scaleDownYuv420((uint8_t *)mScaledHeap->data + mScaledFrameSize * scaled,
+                         mScaledWidth, mScaledHeight, mScaledLumaOnly,
+                         y, u, v, width, cstride, width, height, mScaledScratch)) {
+        ALOGE("ERR(%s):Fail on scaling %dx%d to %dx%d", __func__,
+              width, height, mScaledWidth, mScaledHeight);
+        return -1;
+    }
+
+    return scaled;
+}
+
+/*
+ * Keeps previewThread() from falling behind the driver when the consumers
+ * are slow.  The display is served every frame; when the work per frame
+ * stays over budget the preview callbacks are thinned out first, down to
+ * one in PACING_MAX_DIVISOR, and only then is the sensor asked for half the
+ * frame rate.  Steps are undone one at a time, in reverse, once the lighter
+ * setting has had a clear margin for a while.  The rate is left alone
+ * while recording, the encoder was set up for it.
+ *
+ * displayCost is the time spent getting the frame to the window,
+ * callbackCost the NV21 conversion or downscale plus mDataCb, or -1 if the
+ * callback was skipped.
+ */
+void CameraHardwareSec::updatePreviewPacing(nsecs_t displayCost,
+                                            nsecs_t callbackCost,
+                                            bool callbackDropped)
+{
+    // dump() and startRecording() only hold it briefly, dropping this
+    // frame's sample is cheaper than stalling the preview
+    if (mPacingLock.tryLock() != NO_ERROR)
+        return;
+
+    PreviewPacing &p = mPacing;
+
+    if (callbackDropped)
+        p.callbacksDropped++;
+    if (p.displayCost == 0)
+        p.displayCost = displayCost;
+    else
+        p.displayCost += (displayCost - p.displayCost) / 8;
+    if (callbackCost >= 0) {
+        if (p.callbackCost == 0)
+            p.callbackCost = callbackCost;
+        else
+            p.callbackCost += (callbackCost - p.callbackCost) / 8;
+    }
+
+    // what the driver actually delivers, the requested rate until known;
+    // at the reduced rate the measured period trails the switch, so go by
+    // what was asked for
+    nsecs_t budget = p.state == PACING_REDUCED_RATE ? 0 : mSecCamera->getPreviewFramePeriod();
+    if (budget <= 0) {
+        int fps = p.state == PACING_REDUCED_RATE ? p.nominalFps / 2 : p.nominalFps;
+        if (fps <= 0) {
+            mPacingLock.unlock();
+            return;
+        }
+        budget = seconds(1) / fps;
+    }
+
+    nsecs_t load = p.displayCost + p.callbackCost / p.callbackDivisor;
+
+    if (load * 100 > budget * PACING_HIGH_PERCENT) {
+        p.underBudget = 0;
+        if (++p.overBudget < PACING_ENTER_FRAMES) {
+            mPacingLock.unlock();
+            return;
+        }
+        p.overBudget = 0;
+
+        if (p.callbackCost > 0 && p.callbackDivisor < PACING_MAX_DIVISOR) {
+            p.callbackDivisor *= 2;
+            p.state = PACING_SKIP_CALLBACKS;
+            ALOGI("%s: load %lldus over budget %lldus, preview callbacks 1/%d",
+                  __func__, ns2us(load), ns2us(budget), p.callbackDivisor);
+        } else if (p.state != PACING_REDUCED_RATE && !mRecordRunning &&
+                   p.nominalFps / 2 > 0) {
+            // stopRecord() may have left the sensor at FRAME_RATE_AUTO,
+            // that's what to go back to rather than the configured rate
+            int fps = mSecCamera->getSensorFrameRate();
+            if (mSecCamera->setSensorFrameRate(p.nominalFps / 2) == 0) {
+                p.restoreFps = fps;
+                p.state = PACING_REDUCED_RATE;
+                p.rateReductions++;
+                ALOGI("%s: load %lldus over budget %lldus, preview at %d fps",
+                      __func__, ns2us(load), ns2us(budget), p.nominalFps / 2);
+            }
+        }
+    } else {
+        p.overBudget = 0;
+
+        // budget and load once the last step taken is undone
+        nsecs_t lighter = load;
+        if (p.state == PACING_REDUCED_RATE)
+            budget /= 2;
+        else if (p.callbackDivisor > 1)
+            lighter = p.displayCost + p.callbackCost / (p.callbackDivisor / 2);
+
+        if (p.state == PACING_NORMAL ||
+            lighter * 100 >= budget * PACING_LOW_PERCENT) {
+            p.underBudget = 0;
+        } else if (++p.underBudget >= PACING_EXIT_FRAMES) {
+            p.underBudget = 0;
+            if (p.state == PACING_REDUCED_RATE) {
+                restorePreviewRateLocked();
+            } else {
+                p.callbackDivisor /= 2;
+                if (p.callbackDivisor == 1)
+                    p.state = PACING_NORMAL;
+            }
+            ALOGI("%s: load %lldus, preview callbacks 1/%d at %d fps", __func__,
+                  ns2us(load), p.callbackDivisor,
+                  p.state == PACING_REDUCED_RATE ? p.nominalFps / 2 : p.nominalFps);
         }
     }
 
+    mPacingLock.unlock();
+}
+
+/* back to the rate the sensor ran at before the reduction, mPacingLock held */
+void CameraHardwareSec::restorePreviewRateLocked()
+{
+    if (mPacing.state != PACING_REDUCED_RATE)
+        return;
+
+    if (mSecCamera->setSensorFrameRate(mPacing.restoreFps) < 0)
+        ALOGE("ERR(%s):Fail on restoring %d fps", __func__, mPacing.restoreFps);
+    mPacing.state = mPacing.callbackDivisor > 1 ? PACING_SKIP_CALLBACKS : PACING_NORMAL;
+    mPacing.rateRestores++;
+}
+
+/* called with the preview thread idle, before the driver is started; the
+ * reduction only ever touched the sensor, which startPreview() sets back to
+ * the configured rate */
+void CameraHardwareSec::resetPreviewPacing()
+{
+    Mutex::Autolock lock(mPacingLock);
+
+    mPacing.state = PACING_NORMAL;
+    mPacing.callbackDivisor = 1;
+    mPacing.frame = 0;
+    mPacing.nominalFps = mSecCamera->getFrameRate();
+    mPacing.displayCost = 0;
+    mPacing.callbackCost = 0;
+    mPacing.overBudget = 0;
+    mPacing.underBudget = 0;
+}
+
+//======================================================================
+// Zero shutter lag
+//
+// With ZSL on, the front camera's mmap'ed preview buffers are held by
+// previewThread() instead of going straight back to the driver.  The last
+// ZSL_RING_SIZE of them stay in a ring, the rest of the MAX_BUFFERS keep
+// the stream going.  When the picture size is the preview size,
+// takePicture() leaves the preview running and pictureThread() converts
+// the ring frame closest to the shutter to YUYV for the JPEG encoder.
+
+/* previewThread() hands over every frame it's done with */
+void CameraHardwareSec::zslPushFrame(int index, nsecs_t timestamp, bool nv21)
+{
+    Mutex::Autolock lock(mZslLock);
+
+    if (mZslCount == ZSL_RING_SIZE) {
+        mSecCamera->releasePreviewFrame(mZslRing[mZslHead].index);
+        mZslHead = (mZslHead + 1) % ZSL_RING_SIZE;
+        mZslCount--;
+    }
+
+    ZslFrame &frame = mZslRing[(mZslHead + mZslCount) % ZSL_RING_SIZE];
+    frame.index = index;
+    frame.timestamp = timestamp;
+    frame.nv21 = nv21;
+    mZslCount++;
+    mZslCondition.broadcast();
+}
+
+/* gives the held frames back, before the preview stream is stopped */
+void CameraHardwareSec::zslFlush()
+{
+    Mutex::Autolock lock(mZslLock);
+
+    while (mZslCount) {
+        mSecCamera->releasePreviewFrame(mZslRing[mZslHead].index);
+        mZslHead = (mZslHead + 1) % ZSL_RING_SIZE;
+        mZslCount--;
+    }
+    mZslActive = false;
+    mSecCamera->setPreviewHold(false);
+    mZslCondition.broadcast();
+}
+
+/* whether the next shot can come from the ring, called by takePicture() */
+bool CameraHardwareSec::zslReady()
+{
+    int preview_width, preview_height, preview_size;
+    int snapshot_width, snapshot_height, snapshot_size;
+
+    {
+        Mutex::Autolock lock(mPreviewLock);
+        if (!mPreviewRunning || mPreviewStartDeferred || !mZslActive)
+            return false;
+    }
+
+    mSecCamera->getPreviewSize(&preview_width, &preview_height, &preview_size);
+    mSecCamera->getSnapshotSize(&snapshot_width, &snapshot_height, &snapshot_size);
+
+    /* the encoder takes YUYV, which is what a JPEG picture is shot in */
+    return preview_width == snapshot_width && preview_height == snapshot_height &&
+           mSecCamera->getSnapshotPixelFormat() == V4L2_PIX_FMT_YUYV;
+}
+
+int CameraHardwareSec::zslCapture(uint8_t *yuyv, nsecs_t shutter)
+{
+    int width, height, frame_size;
+    SecCameraStats::Timer capture(STAGE_SNAPSHOT_CAPTURE);
+
+    Mutex::Autolock lock(mZslLock);
+
+    /* the next frame may be closer to the shutter than the newest one
+     * held, give it up to two frame periods to arrive */
+    nsecs_t period = mSecCamera->getPreviewFramePeriod();
+    if (period <= 0)
+        period = ms2ns(100);
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + 2 * period;
+    while (mZslActive) {
+        if (mZslCount) {
+            const ZslFrame &newest = mZslRing[(mZslHead + mZslCount - 1) % ZSL_RING_SIZE];
+            if (newest.timestamp + period / 2 >= shutter)
+                break;
+        }
+        nsecs_t left = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (left <= 0 || mZslCondition.waitRelative(mZslLock, left) != NO_ERROR)
+            break;
+    }
+
+    if (!mZslActive || !mZslCount) {
+        ALOGE("ERR(%s):no preview frame to take the picture from", __func__);
+        return -1;
+    }
+
+    int best = mZslHead;
+    for (int i = 1; i < mZslCount; i++) {
+        int slot = (mZslHead + i) % ZSL_RING_SIZE;
+        if (llabs(mZslRing[slot].timestamp - shutter) <
+            llabs(mZslRing[best].timestamp - shutter))
+            best = slot;
+    }
+    const ZslFrame &frame = mZslRing[best];
+
+    /* the frame stays held, and the ring locked, while it is read */
+    mSecCamera->getPreviewSize(&width, &height, &frame_size);
+    yuv420ToYuyv(yuyv, (uint8_t *)mPreviewHeap->data + frame_size * frame.index,
+                 width, height, frame.nv21);
+
+    mZslShots++;
+    mZslLastOffset = frame.timestamp - shutter;
+    ALOGV("%s: frame %d, %lldus from the shutter", __func__, frame.index,
+          ns2us(mZslLastOffset));
+
+    return 0;
+}
+
+int CameraHardwareSec::recordFrame()
+{
+    int index;
+    unsigned int phyYAddr;
+    unsigned int phyCAddr;
+    struct addrs *addrs;
+
+    /* buffers the encoder is done with, requeued from this thread only */
+    while ((index = mRecordReturns.pop()) >= 0)
+        mSecCamera->releaseRecordFrame(index);
+
+    /* with every buffer at the encoder, waiting on the record node would
+     * stall the preview until a frame comes back, which only happens here */
+    if (!mSecCamera->getRecordQueued())
+        return NO_ERROR;
+
+    index = mSecCamera->getRecordFrame();
+    if (index < 0) {
+        ALOGE("ERR(%s):Fail on SecCamera->getRecord()", __func__);
+        return UNKNOWN_ERROR;
+    }
+
+    phyYAddr = mSecCamera->getRecPhyAddrY(index);
+    phyCAddr = mSecCamera->getRecPhyAddrC(index);
+
+    if (phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
+        ALOGE("ERR(%s):Fail on SecCamera getRectPhyAddr Y addr = %0x C addr = %0x", __func__,
+             phyYAddr, phyCAddr);
+        return UNKNOWN_ERROR;
+    }
+
+    /* copied out before the encoder has the frame */
+    if (mVideoSnapshotPending)
+        grabVideoSnapshot(index, phyYAddr, phyCAddr);
+
+    /* the slot's handle was set up by startRecording(), just refresh it */
+    addrs = (struct addrs *)mRecordHeap->data;
+    addrs[index].pHandle->data[0] = phyYAddr;
+    addrs[index].pHandle->data[1] = phyCAddr;
+    addrs[index].pHandle->data[2] = index;
+
+    // Notify the client of a new frame, stamped with its capture time
+    if (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME) {
+        SecCameraStats::Timer callback(STAGE_RECORD_CALLBACK);
+        mDataCbTimestamp(mSecCamera->getRecordTimestamp(), CAMERA_MSG_VIDEO_FRAME,
+                         mRecordHeap, index, mCallbackCookie);
+    } else {
+        mSecCamera->releaseRecordFrame(index);
+    }
+
     return NO_ERROR;
 }
 
@@ -700,14 +1274,37 @@ status_t CameraHardwareSec::startPreviewInternal()
 {
     ALOGV("%s", __func__);
 
+    bool zeroCopy = (initZeroCopyPreview() == NO_ERROR);
+
+    resetPreviewPacing();
+
     int ret  = mSecCamera->startPreview();
     ALOGV("%s : mSecCamera->startPreview() returned %d", __func__, ret);
 
+    if (ret < 0 && zeroCopy) {
+        ALOGW("%s: FIMC rejected zero-copy preview, falling back to copy", __func__);
+        releaseZeroCopyPreview();
+        ret = mSecCamera->startPreview();
+    }
+
     if (ret < 0) {
         ALOGE("ERR(%s):Fail on mSecCamera->startPreview()", __func__);
         return UNKNOWN_ERROR;
     }
 
+    /* ZSL holds on to the mmap'ed buffers, the window's are the display's */
+    mZslLock.lock();
+    mZslActive = !mZeroCopyPreview &&
+                 mSecCamera->getCameraId() == SecCamera::CAMERA_ID_FRONT &&
+                 !strcmp(mParameters.get(KEY_ZSL), "on");
+    mSecCamera->setPreviewHold(mZslActive);
+    mZslLock.unlock();
+
+    /* starting the sensor resets its zoom, face detection and touch AF */
+    mApplied.zoom = -1;
+    mApplied.focusMode = -1;
+    mApplied.touchAF = -1;
+
     setSkipFrame(INITIAL_SKIP_FRAME);
 
     int width, height, frame_size;
@@ -721,11 +1318,25 @@ status_t CameraHardwareSec::startPreviewInternal()
         mPreviewHeap = 0;
     }
 
-    mPreviewHeap = mGetMemoryCb((int)mSecCamera->getCameraFd(),
+    /* in zero-copy mode the FIMC buffers are not mmap'ed, so the callback
+     * frames get their own memory */
+    mPreviewHeap = mGetMemoryCb(mZeroCopyPreview ? -1 : (int)mSecCamera->getCameraFd(),
                                 frame_size,
                                 kBufferCount,
                                 0); // no cookie
 
+    /* staging area for the NV21 callback conversion, kept across frames */
+    size_t scratch_size = nv21ScratchSize(width, height);
+    if (scratch_size != mNv21ScratchSize) {
+        free(mNv21Scratch);
+        mNv21Scratch = (uint8_t *)malloc(scratch_size);
+        mNv21ScratchSize = mNv21Scratch ? scratch_size : 0;
+        if (!mNv21Scratch)
+            ALOGE("ERR(%s):Fail on NV21 scratch allocation", __func__);
+    }
+
+    initScaledCallbacks(width, height);
+
     mSecCamera->getPostViewConfig(&mPostViewWidth, &mPostViewHeight, &mPostViewSize);
     ALOGV("CameraHardwareSec: mPostViewWidth = %d mPostViewHeight = %d mPostViewSize = %d",
          mPostViewWidth,mPostViewHeight,mPostViewSize);
@@ -749,86 +1360,433 @@ void CameraHardwareSec::stopPreviewInternal()
             ALOGV("%s : preview running but deferred, doing nothing", __func__);
     } else
         ALOGI("%s : preview not running, doing nothing", __func__);
+
+    releaseZeroCopyPreview();
 }
 
-void CameraHardwareSec::stopPreview()
+//======================================================================
+// Zero-copy preview
+//
+// With camera.preview.zerocopy set, the window buffers are handed to the
+// FIMC as V4L2_MEMORY_USERPTR and filled in YV12 directly, so previewThread
+// only has to pass them on to the display.  This needs buffers the FIMC can
+// write without padding (stride == width); whenever that or the driver
+// setup fails we fall back to capturing into the mmap'ed buffers and
+// copying each frame into the window.
+
+status_t CameraHardwareSec::initZeroCopyPreview()
 {
-    ALOGV("%s :", __func__);
+    char prop[PROPERTY_VALUE_MAX];
+    int min_bufs;
 
-    /* request that the preview thread stop. */
-    mPreviewLock.lock();
-    stopPreviewInternal();
-    mPreviewLock.unlock();
-}
+    property_get("camera.preview.zerocopy", prop, "0");
+    if (!atoi(prop))
+        return INVALID_OPERATION;
 
-bool CameraHardwareSec::previewEnabled()
-{
-    Mutex::Autolock lock(mPreviewLock);
-    ALOGV("%s : %d", __func__, mPreviewRunning);
-    return mPreviewRunning;
-}
+    if (!mPreviewWindow || !mGrallocHal)
+        return INVALID_OPERATION;
 
-// ---------------------------------------------------------------------------
+    if (mPreviewWindow->get_min_undequeued_buffer_count(mPreviewWindow, &min_bufs)) {
+        ALOGE("%s: could not retrieve min undequeued buffer count", __func__);
+        return INVALID_OPERATION;
+    }
 
-status_t CameraHardwareSec::startRecording()
-{
-    ALOGV("%s :", __func__);
+    mZeroCopyWindow = mPreviewWindow;
 
-    Mutex::Autolock lock(mRecordLock);
+    for (int i = 0; i < kBufferCount - min_bufs; i++) {
+        buffer_handle_t *buf_handle;
+        int stride;
 
-    if (mRecordHeap) {
-        mRecordHeap->release(mRecordHeap);
-        mRecordHeap = 0;
-    }
-    mRecordHeap = mGetMemoryCb(-1, sizeof(struct addrs), kBufferCount, NULL);
-    if (!mRecordHeap) {
-        ALOGE("ERR(%s): Record heap creation fail", __func__);
-        return UNKNOWN_ERROR;
-    }
+        if (mZeroCopyWindow->dequeue_buffer(mZeroCopyWindow, &buf_handle, &stride)) {
+            ALOGE("%s: could not dequeue gralloc buffer", __func__);
+            releaseZeroCopyPreview();
+            return UNKNOWN_ERROR;
+        }
 
-    if (mRecordRunning == false) {
-        if (mSecCamera->startRecord() < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->startRecord()", __func__);
+        if (queueZeroCopyBuffer(buf_handle, stride) < 0) {
+            mZeroCopyWindow->cancel_buffer(mZeroCopyWindow, buf_handle);
+            releaseZeroCopyPreview();
             return UNKNOWN_ERROR;
         }
-        mRecordRunning = true;
     }
+
+    mZeroCopyPreview = true;
+    ALOGI("%s: preview buffers shared with the display", __func__);
     return NO_ERROR;
 }
 
-void CameraHardwareSec::stopRecording()
+void CameraHardwareSec::releaseZeroCopyPreview()
 {
-    ALOGV("%s :", __func__);
-
-    Mutex::Autolock lock(mRecordLock);
-
-    if (mRecordRunning == true) {
-        if (mSecCamera->stopRecord() < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->stopRecord()", __func__);
-            return;
+    for (int i = 0; i < kBufferCount; i++) {
+        if (mZeroCopyHandles[i] && (mZeroCopyHeld & (1 << i))) {
+            mGrallocHal->unlock(mGrallocHal, *mZeroCopyHandles[i]);
+            mZeroCopyWindow->cancel_buffer(mZeroCopyWindow, mZeroCopyHandles[i]);
         }
-        mRecordRunning = false;
+        mZeroCopyHandles[i] = NULL;
+        mZeroCopyAddrs[i] = NULL;
     }
-}
-
-bool CameraHardwareSec::recordingEnabled()
-{
-    ALOGV("%s :", __func__);
+    mZeroCopyHeld = 0;
+    mZeroCopyMissing = 0;
+    mZeroCopyWindow = NULL;
+    mZeroCopyPreview = false;
 
-    return mRecordRunning;
+    mSecCamera->clearPreviewUserPtrs();
 }
 
-void CameraHardwareSec::releaseRecordingFrame(const void *opaque)
+/*
+ * Give a buffer just dequeued from the window to the FIMC.  Buffers seen
+ * before keep their slot; new ones take a free slot.  The buffer stays
+ * locked for as long as we hold it, so the address the FIMC writes
+ * through is valid until swapZeroCopyBuffer() gives it to the display.
+ * Returns the slot, or -1 (with the buffer unlocked) if the buffer can't
+ * be captured into.
+ */
+int CameraHardwareSec::queueZeroCopyBuffer(buffer_handle_t *buf_handle, int stride)
 {
-    struct addrs *addrs = (struct addrs *)opaque;
-    mSecCamera->releaseRecordFrame(addrs->pHandle->data[2]);
-    native_handle_close(addrs->pHandle);
-    native_handle_delete(addrs->pHandle);
-}
+    int width, height, frame_size;
+    int slot = -1;
 
-// ---------------------------------------------------------------------------
+    mSecCamera->getPreviewSize(&width, &height, &frame_size);
 
-int CameraHardwareSec::autoFocusThread()
+    for (int i = 0; i < kBufferCount; i++) {
+        if (mZeroCopyHandles[i] && *mZeroCopyHandles[i] == *buf_handle) {
+            slot = i;
+            break;
+        }
+        if (!mZeroCopyHandles[i] && slot < 0)
+            slot = i;
+    }
+
+    if (slot < 0) {
+        ALOGE("ERR(%s):no free slot for gralloc buffer", __func__);
+        return -1;
+    }
+
+    /* the FIMC writes YV12 without padding between rows */
+    if (!mZeroCopyHandles[slot] && (stride != width || (width % 32) != 0)) {
+        ALOGI("%s: stride %d doesn't match width %d", __func__, stride, width);
+        return -1;
+    }
+
+    void *vaddr;
+    if (mGrallocHal->lock(mGrallocHal, *buf_handle,
+                          GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN,
+                          0, 0, width, height, &vaddr)) {
+        ALOGE("ERR(%s):could not lock gralloc buffer", __func__);
+        return -1;
+    }
+
+    if (mZeroCopyHandles[slot]) {
+        /* the FIMC slot is bound to the address it was set up with */
+        if (vaddr != mZeroCopyAddrs[slot]) {
+            ALOGE("ERR(%s):gralloc buffer moved from %p to %p", __func__,
+                 mZeroCopyAddrs[slot], vaddr);
+            mGrallocHal->unlock(mGrallocHal, *buf_handle);
+            return -1;
+        }
+        if (mSecCamera->releasePreviewFrame(slot) < 0) {
+            mGrallocHal->unlock(mGrallocHal, *buf_handle);
+            return -1;
+        }
+        mZeroCopyHeld |= (1 << slot);
+        return slot;
+    }
+
+    if (mSecCamera->setPreviewUserPtr(slot, (unsigned long)vaddr, frame_size) < 0) {
+        mGrallocHal->unlock(mGrallocHal, *buf_handle);
+        return -1;
+    }
+
+    mZeroCopyHandles[slot] = buf_handle;
+    mZeroCopyAddrs[slot] = vaddr;
+    mZeroCopyHeld |= (1 << slot);
+
+    return slot;
+}
+
+/*
+ * Hand the filled buffer in slot index to the display and give the FIMC
+ * whichever buffer the window returns in exchange.  Buffers the window
+ * failed to return earlier are asked for again, so a transient dequeue
+ * error doesn't starve the FIMC for good.
+ */
+int CameraHardwareSec::swapZeroCopyBuffer(int index)
+{
+    buffer_handle_t *buf_handle = mZeroCopyHandles[index];
+    int stride;
+    int ret = NO_ERROR;
+
+    mGrallocHal->unlock(mGrallocHal, *buf_handle);
+    mZeroCopyHeld &= ~(1 << index);
+
+    if (mZeroCopyWindow->enqueue_buffer(mZeroCopyWindow, buf_handle)) {
+        ALOGE("Could not enqueue gralloc buffer!\n");
+        /* still ours, back to the FIMC */
+        if (queueZeroCopyBuffer(buf_handle, 0) < 0) {
+            mZeroCopyWindow->cancel_buffer(mZeroCopyWindow, buf_handle);
+            mZeroCopyMissing++;
+        }
+        return -1;
+    }
+    mZeroCopyMissing++;
+
+    while (mZeroCopyMissing > 0) {
+        if (mZeroCopyWindow->dequeue_buffer(mZeroCopyWindow, &buf_handle, &stride)) {
+            ALOGE("Could not dequeue gralloc buffer!\n");
+            return -1;
+        }
+        mZeroCopyMissing--;
+
+        if (queueZeroCopyBuffer(buf_handle, stride) < 0) {
+            ALOGE("ERR(%s):gralloc buffer can't be used for capture", __func__);
+            mZeroCopyWindow->cancel_buffer(mZeroCopyWindow, buf_handle);
+            /* asked for again on the next frame */
+            mZeroCopyMissing++;
+            ret = -1;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+//======================================================================
+// Window buffer mappings
+//
+// The copy path writes each frame into a buffer dequeued from the window,
+// which cycles through the same few buffers.  By default each frame is
+// written between a gralloc lock and unlock, which is where gralloc does
+// its cache and GPU synchronization, and the address and stride every
+// buffer was locked at are kept to count how stable the mappings are
+// (hits/misses in dump()).
+//
+// A gralloc in kUnlockedGrallocs maps each buffer once, when it is
+// registered, hands that mapping back from lock() and does nothing in
+// unlock(), so the lock/unlock pair is pure overhead there: a buffer seen
+// before, dequeued with the stride it was locked at, is written through
+// its kept address without one.  A gralloc joins the table only after
+// its lock/unlock have been read to do no more than that.
+
+int CameraHardwareSec::lockPreviewBuffer(buffer_handle_t *buf_handle, int stride,
+                                         int width, int height, void **vaddr)
+{
+    if (android_atomic_cmpxchg(1, 0, &mPreviewMapsStale) == 0)
+        mPreviewMapCount = 0;
+
+    PreviewMapping *map = NULL;
+    for (int i = 0; i < mPreviewMapCount; i++) {
+        if (mPreviewMaps[i].handle == *buf_handle) {
+            map = &mPreviewMaps[i];
+            break;
+        }
+    }
+
+    if (map && mGrallocCached && map->stride == stride) {
+        mPreviewMapHits++;
+        mPreviewLocked = false;
+        *vaddr = map->vaddr;
+        return 0;
+    }
+
+    int err = mGrallocHal->lock(mGrallocHal, *buf_handle, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                0, 0, width, height, vaddr);
+    if (err)
+        return err;
+    mPreviewLocked = true;
+
+    if (!map) {
+        /* more buffers than the window was asked for, start over */
+        if (mPreviewMapCount == kBufferCount) {
+            ALOGW("%s: window cycles through more than %d buffers", __func__, kBufferCount);
+            mPreviewMapCount = 0;
+        }
+        map = &mPreviewMaps[mPreviewMapCount++];
+        map->handle = *buf_handle;
+        mPreviewMapMisses++;
+    } else if (map->vaddr != *vaddr || map->stride != stride) {
+        mPreviewMapMisses++;
+    } else {
+        mPreviewMapHits++;
+    }
+    map->vaddr = *vaddr;
+    map->stride = stride;
+
+    return 0;
+}
+
+void CameraHardwareSec::unlockPreviewBuffer(buffer_handle_t *buf_handle)
+{
+    if (mPreviewLocked)
+        mGrallocHal->unlock(mGrallocHal, *buf_handle);
+    mPreviewLocked = false;
+}
+
+void CameraHardwareSec::stopPreview()
+{
+    ALOGV("%s :", __func__);
+
+    /* request that the preview thread stop. */
+    mPreviewLock.lock();
+    stopPreviewInternal();
+    mPreviewLock.unlock();
+}
+
+bool CameraHardwareSec::previewEnabled()
+{
+    Mutex::Autolock lock(mPreviewLock);
+    ALOGV("%s : %d", __func__, mPreviewRunning);
+    return mPreviewRunning;
+}
+
+// ---------------------------------------------------------------------------
+
+status_t CameraHardwareSec::startRecording()
+{
+    ALOGV("%s :", __func__);
+
+    Mutex::Autolock lock(mRecordLock);
+
+    if (mRecordHeap) {
+        destroyRecordHandles();
+        mRecordHeap->release(mRecordHeap);
+        mRecordHeap = 0;
+    }
+    mRecordHeap = mGetMemoryCb(-1, sizeof(struct addrs), kBufferCount, NULL);
+    if (!mRecordHeap) {
+        ALOGE("ERR(%s): Record heap creation fail", __func__);
+        return UNKNOWN_ERROR;
+    }
+
+    if (!mRecordRunning) {
+        if (createRecordHandles() < 0) {
+            ALOGE("ERR(%s):Fail on createRecordHandles()", __func__);
+            return UNKNOWN_ERROR;
+        }
+        /* record at the rate the preview was started with; pacing can't
+         * lower it again until mRecordRunning is up */
+        Mutex::Autolock pacingLock(mPacingLock);
+        restorePreviewRateLocked();
+        if (mSecCamera->startRecord() < 0) {
+            ALOGE("ERR(%s):Fail on mSecCamera->startRecord()", __func__);
+            destroyRecordHandles();
+            return UNKNOWN_ERROR;
+        }
+        mRecordReturns.reset();
+
+        /* video snapshots: a copy of the record frame and its conversion */
+        int width, height;
+        size_t length = 0;
+        mSecCamera->getRecordFrameSize(&width, &height);
+        mSecCamera->getRecordBuffer(0, &length);
+        if (length < (size_t)width * height * 2)
+            length = width * height * 2;
+        mVideoSnapshotPool.resize(length, 0);
+
+        android_atomic_release_store(1, &mRecordRunning);
+    }
+    return NO_ERROR;
+}
+
+/*
+ * One metadata handle per record buffer, created for the whole recording
+ * session.  previewThread() only rewrites the addresses in it per frame.
+ */
+int CameraHardwareSec::createRecordHandles()
+{
+    struct addrs *addrs = (struct addrs *)mRecordHeap->data;
+
+    for (int i = 0; i < kBufferCount; i++) {
+        addrs[i].type = kMetadataBufferTypeNativeHandleSource;
+        addrs[i].pHandle = native_handle_create(0 /*numFds*/, 3 /*numInts*/);
+        if (addrs[i].pHandle == NULL) {
+            destroyRecordHandles();
+            return -1;
+        }
+        addrs[i].pHandle->data[2] = i;
+        mRecordHandlesLive++;
+    }
+
+    return 0;
+}
+
+void CameraHardwareSec::destroyRecordHandles()
+{
+    if (!mRecordHeap)
+        return;
+
+    struct addrs *addrs = (struct addrs *)mRecordHeap->data;
+
+    for (int i = 0; i < kBufferCount; i++) {
+        if (addrs[i].pHandle) {
+            native_handle_close(addrs[i].pHandle);
+            native_handle_delete(addrs[i].pHandle);
+            addrs[i].pHandle = NULL;
+            mRecordHandlesLive--;
+        }
+    }
+}
+
+void CameraHardwareSec::stopRecording()
+{
+    ALOGV("%s :", __func__);
+
+    Mutex::Autolock lock(mRecordLock);
+
+    if (mRecordRunning) {
+        /* let previewThread() get out of the record path first */
+        android_atomic_release_store(0, &mRecordRunning);
+        ANDROID_MEMBAR_FULL();
+        mRecordIdleLock.lock();
+        android_atomic_release_store(1, &mRecordWaiting);
+        ANDROID_MEMBAR_FULL();
+        while (mRecordBusy)
+            mRecordIdle.wait(mRecordIdleLock);
+        android_atomic_release_store(0, &mRecordWaiting);
+        mRecordIdleLock.unlock();
+
+        /* no record frame to take it from any more */
+        cancelVideoSnapshot();
+
+        if (mSecCamera->stopRecord() < 0) {
+            ALOGE("ERR(%s):Fail on mSecCamera->stopRecord()", __func__);
+            return;
+        }
+        destroyRecordHandles();
+        /* heaps a snapshot still being encoded holds go away with it */
+        mVideoSnapshotPool.resize(0, 0);
+    }
+}
+
+bool CameraHardwareSec::recordingEnabled()
+{
+    ALOGV("%s :", __func__);
+
+    return mRecordRunning != 0;
+}
+
+void CameraHardwareSec::releaseRecordingFrame(const void *opaque)
+{
+    /* frames may come back after stopRecording() freed the handles, so
+     * go by the slot in mRecordHeap rather than the handle's contents */
+    if (!mRecordHeap)
+        return;
+
+    int index = (struct addrs *)opaque - (struct addrs *)mRecordHeap->data;
+
+    if (index < 0 || kBufferCount <= index) {
+        ALOGE("ERR(%s):Invalid recording frame %p", __func__, opaque);
+        return;
+    }
+
+    /* previewThread() requeues it, so this never waits on the record node */
+    Mutex::Autolock lock(mRecordReturnLock);
+    if (!mRecordReturns.push(index))
+        ALOGE("ERR(%s):Return ring full, dropping frame %d", __func__, index);
+}
+
+// ---------------------------------------------------------------------------
+
+int CameraHardwareSec::autoFocusThread()
 {
     int count =0;
     int af_status =0 ;
@@ -858,12 +1816,14 @@ int CameraHardwareSec::autoFocusThread()
     mFocusLock.unlock();
 
     ALOGV("%s : calling setAutoFocus", __func__);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
     if (mSecCamera->setAutofocus() < 0) {
         ALOGE("ERR(%s):Fail on mSecCamera->setAutofocus()", __func__);
         return UNKNOWN_ERROR;
     }
 
     af_status = mSecCamera->getAutoFocusResult();
+    recordAutoFocus(systemTime(SYSTEM_TIME_MONOTONIC) - start, af_status);
 
     if (af_status == 0x01) {
         ALOGV("%s : AF Success!!", __func__);
@@ -889,6 +1849,19 @@ int CameraHardwareSec::autoFocusThread()
     return NO_ERROR;
 }
 
+void CameraHardwareSec::recordAutoFocus(nsecs_t duration, int status)
+{
+    SecCameraStats::record(STAGE_AUTOFOCUS, duration);
+
+    Mutex::Autolock lock(mFocusLock);
+    if (status == 0x01)
+        mAutoFocusStats.success++;
+    else if (status == 0x02)
+        mAutoFocusStats.cancel++;
+    else
+        mAutoFocusStats.fail++;
+}
+
 status_t CameraHardwareSec::autoFocus()
 {
     ALOGV("%s :", __func__);
@@ -915,132 +1888,87 @@ status_t CameraHardwareSec::cancelAutoFocus()
     return NO_ERROR;
 }
 
-int CameraHardwareSec::save_jpeg( unsigned char *real_jpeg, int jpeg_size)
-{
-    FILE *yuv_fp = NULL;
-    char filename[100], *buffer = NULL;
-
-    /* file create/open, note to "wb" */
-    yuv_fp = fopen("/data/camera_dump.jpeg", "wb");
-    if (yuv_fp == NULL) {
-        ALOGE("Save jpeg file open error");
-        return -1;
-    }
-
-    ALOGV("[BestIQ]  real_jpeg size ========>  %d\n", jpeg_size);
-    buffer = (char *) malloc(jpeg_size);
-    if (buffer == NULL) {
-        ALOGE("Save YUV] buffer alloc failed");
-        if (yuv_fp)
-            fclose(yuv_fp);
-
-        return -1;
-    }
+//======================================================================
+// Debug dumps
+//
+// camera.debug.dump is a mask of DUMP_JPEG and DUMP_POSTVIEW, read for
+// every shot so it can be flipped on a running device.  The files go out
+// on the dump writer's thread; camera.debug.dump.depth sets how many shots
+// may be waiting for it before further dumps are dropped.
+
+enum {
+    DUMP_JPEG       = 1 << 0,
+    DUMP_POSTVIEW   = 1 << 1,
+};
 
-    memcpy(buffer, real_jpeg, jpeg_size);
+/* keeps a client buffer alive for the dump writer */
+class CameraMemoryRef : public RefBase {
+public:
+    CameraMemoryRef(camera_memory_t *mem) : mMem(mem) { }
+    virtual ~CameraMemoryRef() { mMem->release(mMem); }
+private:
+    camera_memory_t *mMem;
+};
 
-    fflush(stdout);
+int CameraHardwareSec::debugDumps()
+{
+    char prop[PROPERTY_VALUE_MAX];
 
-    fwrite(buffer, 1, jpeg_size, yuv_fp);
+    property_get("camera.debug.dump", prop, "0");
+    int dumps = atoi(prop) & (DUMP_JPEG | DUMP_POSTVIEW);
+    if (!dumps)
+        return 0;
 
-    fflush(yuv_fp);
+    property_get("camera.debug.dump.depth", prop, "4");
 
-    if (yuv_fp)
-            fclose(yuv_fp);
-    if (buffer)
-            free(buffer);
+    Mutex::Autolock lock(mJpegLock);
+    if (mDumpWriter == NULL)
+        mDumpWriter = new SecCameraDumpWriter();
+    mDumpWriter->setDepth(atoi(prop));
 
-    return 0;
+    return dumps;
 }
 
-void CameraHardwareSec::save_postview(const char *fname, uint8_t *buf, uint32_t size)
+/* takes over the buffer, it is released once written or dropped */
+int CameraHardwareSec::save_jpeg(camera_memory_t *jpeg)
 {
-    int nw;
-    int cnt = 0;
-    uint32_t written = 0;
+    char filename[64];
 
-    ALOGD("opening file [%s]\n", fname);
-    int fd = open(fname, O_RDWR | O_CREAT, 0600);
-    if (fd < 0) {
-        ALOGE("failed to create file [%s]: %s", fname, strerror(errno));
-    return;
-    }
+    sp<RefBase> owner = new CameraMemoryRef(jpeg);
+    snprintf(filename, sizeof(filename), "/data/camera_dump_%04u.jpeg", mDumpSequence);
 
-    ALOGD("writing %d bytes to file [%s]\n", size, fname);
-    while (written < size) {
-        nw = ::write(fd, buf + written, size - written);
-        if (nw < 0) {
-            ALOGE("failed to write to file %d [%s]: %s",written,fname, strerror(errno));
-            break;
-        }
-        written += nw;
-        cnt++;
-    }
-    ALOGD("done writing %d bytes to file [%s] in %d passes\n",size, fname, cnt);
-    ::close(fd);
+    Mutex::Autolock lock(mJpegLock);
+    if (mDumpWriter == NULL)
+        return -1;
+    return mDumpWriter->queue(filename, owner, jpeg->data, jpeg->size) ? 0 : -1;
 }
 
-bool CameraHardwareSec::scaleDownYuv422(char *srcBuf, uint32_t srcWidth, uint32_t srcHeight,
-                                        char *dstBuf, uint32_t dstWidth, uint32_t dstHeight)
+int CameraHardwareSec::save_postview(const sp<MemoryHeapBase>& heap, uint32_t size)
 {
-    int32_t step_x, step_y;
-    int32_t iXsrc, iXdst;
-    int32_t x, y, src_y_start_pos, dst_pos, src_pos;
-
-    if (dstWidth % 2 != 0 || dstHeight % 2 != 0){
-        ALOGE("scale_down_yuv422: invalid width, height for scaling");
-        return false;
-    }
-
-    step_x = srcWidth / dstWidth;
-    step_y = srcHeight / dstHeight;
+    char filename[64];
 
-    dst_pos = 0;
-    for (uint32_t y = 0; y < dstHeight; y++) {
-        src_y_start_pos = (y * step_y * (srcWidth * 2));
+    snprintf(filename, sizeof(filename), "/data/camera_postview_%04u.yuv", mDumpSequence);
 
-        for (uint32_t x = 0; x < dstWidth; x += 2) {
-            src_pos = src_y_start_pos + (x * (step_x * 2));
-
-            dstBuf[dst_pos++] = srcBuf[src_pos    ];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 1];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 2];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 3];
-        }
-    }
-
-    return true;
+    Mutex::Autolock lock(mJpegLock);
+    if (mDumpWriter == NULL)
+        return -1;
+    return mDumpWriter->queue(filename, heap, heap->base(), size) ? 0 : -1;
 }
 
-bool CameraHardwareSec::YUY2toNV21(void *srcBuf, void *dstBuf, uint32_t srcWidth, uint32_t srcHeight)
+/*
+ * The size the ISP reports for a JPEG may run past EOI into padding, only
+ * hand the stream itself to the client.
+ */
+static int ispJpegSize(const unsigned char *jpeg, int size)
 {
-    int32_t        x, y, src_y_start_pos, dst_cbcr_pos, dst_pos, src_pos;
-    unsigned char *srcBufPointer = (unsigned char *)srcBuf;
-    unsigned char *dstBufPointer = (unsigned char *)dstBuf;
-
-    dst_pos = 0;
-    dst_cbcr_pos = srcWidth*srcHeight;
-    for (uint32_t y = 0; y < srcHeight; y++) {
-        src_y_start_pos = (y * (srcWidth * 2));
-
-        for (uint32_t x = 0; x < (srcWidth * 2); x += 2) {
-            src_pos = src_y_start_pos + x;
-
-            dstBufPointer[dst_pos++] = srcBufPointer[src_pos];
-        }
-    }
-    for (uint32_t y = 0; y < srcHeight; y += 2) {
-        src_y_start_pos = (y * (srcWidth * 2));
-
-        for (uint32_t x = 0; x < (srcWidth * 2); x += 4) {
-            src_pos = src_y_start_pos + x;
+    JpegMarkers markers;
 
-            dstBufPointer[dst_cbcr_pos++] = srcBufPointer[src_pos + 3];
-            dstBufPointer[dst_cbcr_pos++] = srcBufPointer[src_pos + 1];
-        }
+    if (!parseJpegMarkers(jpeg, size, &markers)) {
+        ALOGW("WARN(%s):no EOI in the %d byte ISP JPEG", __func__, size);
+        return size;
     }
 
-    return true;
+    return markers.eoi + 2;
 }
 
 int CameraHardwareSec::pictureThread()
@@ -1050,29 +1978,21 @@ int CameraHardwareSec::pictureThread()
     int jpeg_size = 0;
     int ret = NO_ERROR;
     unsigned char *jpeg_data = NULL;
-    int postview_offset = 0;
-    unsigned char *postview_data = NULL;
 
-    unsigned char *addr = NULL;
     int mPostViewWidth, mPostViewHeight, mPostViewSize;
-    int mThumbWidth, mThumbHeight, mThumbSize;
     int cap_width, cap_height, cap_frame_size;
-    int JpegImageSize, JpegExifSize;
 
-    unsigned int output_size = 0;
+    if (mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK && mBurstCount > 1) {
+        ret = burstCapture(mBurstCount, mBurstInterval);
+        mSecCamera->endSnapshot();
+        finishCapture();
+        return ret;
+    }
 
     mSecCamera->getPostViewConfig(&mPostViewWidth, &mPostViewHeight, &mPostViewSize);
-    mSecCamera->getThumbnailConfig(&mThumbWidth, &mThumbHeight, &mThumbSize);
     int postviewHeapSize = mPostViewSize;
     mSecCamera->getSnapshotSize(&cap_width, &cap_height, &cap_frame_size);
-    int mJpegHeapSize;
-    if (mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK)
-        mJpegHeapSize = cap_frame_size * SecCamera::getJpegRatio();
-    else
-        mJpegHeapSize = cap_frame_size;
 
-    LOG_TIME_DEFINE(0)
-    LOG_TIME_START(0)
 //    sp<MemoryBase> buffer = new MemoryBase(mRawHeap, 0, mPostViewSize + 8);
 
     struct addrs_cap *addrs = (struct addrs_cap *)mRawHeap->data;
@@ -1081,16 +2001,18 @@ int CameraHardwareSec::pictureThread()
     addrs[0].height = mPostViewHeight;
     ALOGV("[5B] mPostViewWidth = %d mPostViewHeight = %d\n",mPostViewWidth,mPostViewHeight);
 
-    camera_memory_t *JpegHeap = mGetMemoryCb(-1, mJpegHeapSize, 1, 0);
-    sp<MemoryHeapBase> PostviewHeap = new MemoryHeapBase(mPostViewSize);
-    sp<MemoryHeapBase> ThumbnailHeap = new MemoryHeapBase(mThumbSize);
-
-    LOG_TIME_DEFINE(1)
-    LOG_TIME_START(1)
-
-    int picture_size, picture_width, picture_height;
-    mSecCamera->getSnapshotSize(&picture_width, &picture_height, &picture_size);
-    int picture_format = mSecCamera->getSnapshotPixelFormat();
+    JpegJob *job = new JpegJob;
+    job->cameraId = mSecCamera->getCameraId();
+    job->jpeg = NULL;
+    job->postview = mPostviewPool.get();
+    job->nv12t = false;
+    job->postviewWidth = mPostViewWidth;
+    job->postviewHeight = mPostViewHeight;
+    job->snapshotWidth = cap_width;
+    job->snapshotHeight = cap_height;
+    mSecCamera->getThumbnailConfig(&job->thumbnailWidth, &job->thumbnailHeight,
+                                   &job->thumbnailSize);
+    job->jpegQuality = mSecCamera->getJpegQuality();
 
     unsigned int phyAddr;
 
@@ -1108,29 +2030,36 @@ int CameraHardwareSec::pictureThread()
             ret = UNKNOWN_ERROR;
             goto out;
         }
+    } else if (mZslCapture) {
+        if (zslCapture((uint8_t *)job->postview->base(), mZslShutter) < 0) {
+            ret = UNKNOWN_ERROR;
+            goto out;
+        }
     } else {
-        if (mSecCamera->getSnapshotAndJpeg((unsigned char*)PostviewHeap->base(),
-                (unsigned char*)JpegHeap->data, &output_size) < 0) {
+        if (mSecCamera->getSnapshot((unsigned char*)job->postview->base()) < 0) {
             ret = UNKNOWN_ERROR;
             goto out;
         }
-        ALOGI("snapshotandjpeg done\n");
+        ALOGI("snapshot done\n");
     }
 
-    LOG_TIME_END(1)
-    LOG_CAMERA("getSnapshotAndJpeg interval: %lu us", LOG_TIME(1));
-
     if (mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK) {
         // TODO: copy postview to PostviewHeap->base()
-        memcpy(JpegHeap->data, jpeg_data, jpeg_size);
-        JpegImageSize = jpeg_size;
+        // the ISP buffer goes away with endSnapshot(), so copy it once
+        // into the buffer handed to the client
+        jpeg_size = ispJpegSize(jpeg_data, jpeg_size);
+        job->jpeg = mGetMemoryCb(-1, jpeg_size, 1, 0);
+        if (!job->jpeg) {
+            ALOGE("ERR(%s):Fail on jpeg heap creation", __func__);
+            ret = UNKNOWN_ERROR;
+            goto out;
+        }
+        memcpy(job->jpeg->data, jpeg_data, jpeg_size);
     } else {
-        JpegImageSize = static_cast<int>(output_size);
+        mSecCamera->getExifInfo(&job->exifInfo);
     }
-    scaleDownYuv422((char *)PostviewHeap->base(), mPostViewWidth, mPostViewHeight,
-                    (char *)ThumbnailHeap->base(), mThumbWidth, mThumbHeight);
 
-    memcpy(mRawHeap->data, PostviewHeap->base(), postviewHeapSize);
+    memcpy(mRawHeap->data, job->postview->base(), postviewHeapSize);
 
     if (mMsgEnabled & CAMERA_MSG_RAW_IMAGE) {
         mDataCb(CAMERA_MSG_RAW_IMAGE, mRawHeap, 0, NULL, mCallbackCookie);
@@ -1138,52 +2067,460 @@ int CameraHardwareSec::pictureThread()
         mNotifyCb(CAMERA_MSG_RAW_IMAGE_NOTIFY, 0, 0, mCallbackCookie);
     }
 
+    ALOGV("%s : pictureThread end", __func__);
+
+out:
+    mSecCamera->endSnapshot();
+
+    /* EXIF and the final JPEG are put together by the jpeg thread, the
+     * sensor is free for preview or the next shot from here on */
+    if (ret == NO_ERROR) {
+        queueJpegJob(job);
+    } else {
+        releaseJpegJob(job);
+    }
+
+    finishCapture();
+
+    return ret;
+}
+
+void CameraHardwareSec::finishCapture()
+{
+    mCaptureLock.lock();
+    mCaptureInProgress = false;
+    mCaptureCondition.broadcast();
+    mCaptureLock.unlock();
+}
+
+/*
+ * Burst capture on the CE147: the JPEG stream is set up once and the ISP
+ * is re-triggered for every frame.  When the driver gives us more than one
+ * buffer the next frame is captured while the previous JPEG is copied out.
+ * Each frame goes through the jpeg thread as CAMERA_MSG_COMPRESSED_IMAGE.
+ */
+int CameraHardwareSec::burstCapture(int count, int interval)
+{
+    ALOGV("%s(count(%d), interval(%d))", __func__, count, interval);
+
+    int ret = NO_ERROR;
+    nsecs_t last = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (mSecCamera->setSnapshotCmd(count) < 0) {
+        ALOGE("ERR(%s):Fail on SecCamera->setSnapshotCmd(%d)", __func__, count);
+        return UNKNOWN_ERROR;
+    }
+    bool overlap = (mSecCamera->getCaptureBufferCount() > 1);
+
+    if (mMsgEnabled & CAMERA_MSG_SHUTTER) {
+        mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
+    }
+
+    for (int n = 0; n < count; n++) {
+        int jpeg_size, index;
+        unsigned char *jpeg_data = mSecCamera->getBurstJpeg(&jpeg_size, &index);
+        if (jpeg_data == NULL) {
+            ALOGE("ERR(%s):Fail on SecCamera->getBurstJpeg() frame %d", __func__, n);
+            ret = UNKNOWN_ERROR;
+            break;
+        }
+
+        bool more = (n + 1 < count);
+        if (more && overlap && triggerBurstFrame(&last, interval) < 0) {
+            ret = UNKNOWN_ERROR;
+            more = false;
+        }
+
+        jpeg_size = ispJpegSize(jpeg_data, jpeg_size);
+        JpegJob *job = new JpegJob;
+        job->cameraId = SecCamera::CAMERA_ID_BACK;
+        job->nv12t = false;
+        job->jpeg = mGetMemoryCb(-1, jpeg_size, 1, 0);
+        if (job->jpeg)
+            memcpy(job->jpeg->data, jpeg_data, jpeg_size);
+        mSecCamera->releaseBurstJpeg(index);
+
+        if (!job->jpeg) {
+            ALOGE("ERR(%s):Fail on jpeg heap creation", __func__);
+            delete job;
+            ret = UNKNOWN_ERROR;
+            break;
+        }
+
+        if (more && !overlap && triggerBurstFrame(&last, interval) < 0) {
+            ret = UNKNOWN_ERROR;
+            more = false;
+        }
+
+        queueJpegJob(job);
+
+        if (!more)
+            break;
+    }
+
+    mSecCamera->stopBurst();
+
+    return ret;
+}
+
+/*
+ * Start the next burst frame, no sooner than interval ms after the last one.
+ */
+int CameraHardwareSec::triggerBurstFrame(nsecs_t *last, int interval)
+{
+    nsecs_t wait = *last + ms2ns(interval) - systemTime(SYSTEM_TIME_MONOTONIC);
+    if (wait > 0)
+        usleep(ns2us(wait));
+
+    if (mSecCamera->triggerBurstCapture() < 0) {
+        ALOGE("ERR(%s):Fail on SecCamera->triggerBurstCapture()", __func__);
+        return -1;
+    }
+    *last = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (mMsgEnabled & CAMERA_MSG_SHUTTER) {
+        mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
+    }
+
+    return 0;
+}
+
+//======================================================================
+// JPEG assembly
+
+/*
+ * Hand a captured shot to the jpeg thread.  Only one shot waits while the
+ * previous one is being assembled, so a burst of takePicture() calls
+ * throttles on the capture side instead of piling up buffers.
+ */
+status_t CameraHardwareSec::queueJpegJob(JpegJob *job)
+{
+    Mutex::Autolock lock(mJpegLock);
+
+    while (mJpegJob && !mExitJpegThread)
+        mJpegCondition.wait(mJpegLock);
+
+    if (mExitJpegThread) {
+        releaseJpegJob(job);
+        return INVALID_OPERATION;
+    }
+
+    mJpegJob = job;
+    mJpegCondition.broadcast();
+    return NO_ERROR;
+}
+
+int CameraHardwareSec::jpegThread()
+{
+    mJpegLock.lock();
+    while (!mJpegJob && !mExitJpegThread)
+        mJpegCondition.wait(mJpegLock);
+
+    JpegJob *job = mJpegJob;
+    mJpegJob = NULL;
+    mJpegCondition.broadcast();
+
+    if (mExitJpegThread) {
+        mJpegLock.unlock();
+        if (job)
+            releaseJpegJob(job);
+        ALOGV("%s : exiting on request", __func__);
+        return NO_ERROR;
+    }
+    mJpegLock.unlock();
+
+    assembleJpeg(job);
+    releaseJpegJob(job);
+
+    return NO_ERROR;
+}
+
+/*
+ * Stretch the APP1 block at app1 to size bytes, to fill the room left for
+ * it in front of the stream.  EXIF readers go by the offsets inside the
+ * block and skip the rest of the segment.
+ */
+static void padExif(uint8_t *app1, unsigned int exifSize, unsigned int size)
+{
+    memset(app1 + exifSize, 0, size - exifSize);
+
+    /* big endian, the marker isn't counted */
+    app1[2] = (size - 2) >> 8;
+    app1[3] = (size - 2) & 0xff;
+}
+
+void CameraHardwareSec::assembleJpeg(JpegJob *job)
+{
+    int JpegExifSize = 0;
+    nsecs_t t0, t1;
+
+    int dumps = debugDumps();
+    mDumpSequence++;
+
     if (mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE) {
-        if (mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK) {
+        if (job->jpeg) {
             // Aries' back camera already has EXIF data
-            camera_memory_t *mem = mGetMemoryCb(-1, JpegImageSize, 1, 0);
-            memcpy(mem->data, JpegHeap->data, JpegImageSize);
-            mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, mem, 0, NULL, mCallbackCookie);
-            mem->release(mem);
+            SecCameraStats::Timer callback(STAGE_JPEG_CALLBACK);
+            mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, job->jpeg, 0, NULL, mCallbackCookie);
+            callback.stop();
+            if (dumps & DUMP_JPEG) {
+                save_jpeg(job->jpeg);
+                job->jpeg = NULL;
+            }
         } else {
-            camera_memory_t *ExifHeap =
-                mGetMemoryCb(-1, EXIF_FILE_SIZE + JPG_STREAM_BUF_SIZE, 1, 0);
-            JpegExifSize = mSecCamera->getExif((unsigned char *)ExifHeap->data,
-                                               (unsigned char *)ThumbnailHeap->base());
+            // the front camera's snapshot, or a preview frame for a video
+            // snapshot, to be encoded here
+            sp<MemoryHeapBase> yuyv = job->postview;
+            if (job->nv12t) {
+                size_t size = job->snapshotWidth * job->snapshotHeight * 2;
+                job->yuyv = mVideoSnapshotPool.get();
+                if (job->yuyv->getHeapID() < 0 || job->yuyv->getSize() < size) {
+                    ALOGE("ERR(%s):Fail on video snapshot heap creation", __func__);
+                    return;
+                }
+                const uint8_t *frame = (uint8_t *)job->postview->base();
+                nv12tToYuyv((uint8_t *)job->yuyv->base(), frame, frame + job->cbcrOffset,
+                            job->snapshotWidth, job->snapshotHeight);
+                yuyv = job->yuyv;
+            }
+
+            if (dumps & DUMP_POSTVIEW)
+                save_postview(yuyv, job->snapshotWidth * job->snapshotHeight * 2);
+
+            t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+            sp<MemoryHeapBase> ThumbnailHeap = mThumbnailPool.get();
+            if (ThumbnailHeap->getSize() < (size_t)job->thumbnailSize) {
+                /* the pool was resized for the other camera since */
+                ThumbnailHeap = new MemoryHeapBase(job->thumbnailSize);
+            }
+            if (!scaleDownYuv422((uint8_t *)ThumbnailHeap->base(),
+                                 job->thumbnailWidth, job->thumbnailHeight,
+                                 (uint8_t *)yuyv->base(),
+                                 job->postviewWidth, job->postviewHeight))
+                ALOGE("ERR(%s):Fail on thumbnail downscale", __func__);
+            t1 = systemTime(SYSTEM_TIME_MONOTONIC);
+            SecCameraStats::record(STAGE_THUMBNAIL, t1 - t0);
+
+            SecCamera::SnapshotJpeg jpeg;
+            if (mSecCamera->encodeSnapshot((unsigned char *)yuyv->base(),
+                                           job->snapshotWidth, job->snapshotHeight,
+                                           job->jpegQuality, &jpeg) < 0) {
+                ALOGE("ERR(%s):Fail on SecCamera->encodeSnapshot()", __func__);
+                mThumbnailPool.put(ThumbnailHeap);
+                return;
+            }
+            t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+            SecCameraStats::record(STAGE_ENCODE, t0 - t1);
+
+            // the JPEG block only writes to its own output buffer, so the
+            // stream is copied once, to where it ends up in the client
+            // buffer: behind SOI and room for the EXIF block
+            camera_memory_t *mem = mGetMemoryCb(-1, jpeg.size() + EXIF_FILE_SIZE, 1, 0);
+            if (!mem) {
+                ALOGE("ERR(%s):Fail on jpeg heap creation", __func__);
+                mThumbnailPool.put(ThumbnailHeap);
+                return;
+            }
+            uint8_t *ptr = (uint8_t *) mem->data;
+            memcpy(ptr, jpeg.data(), 2);
+            memcpy(ptr + 2 + EXIF_FILE_SIZE, jpeg.data() + 2, jpeg.size() - 2);
+            unsigned int jpegSize = jpeg.size();
+            jpeg.release();
+            t1 = systemTime(SYSTEM_TIME_MONOTONIC);
+            SecCameraStats::record(STAGE_JPEG_ASSEMBLE, t1 - t0);
+
+            JpegExifSize = mSecCamera->getExif(ptr + 2, EXIF_FILE_SIZE,
+                                               (unsigned char *)ThumbnailHeap->base(),
+                                               job->thumbnailWidth, job->thumbnailHeight,
+                                               &job->exifInfo);
+            if (JpegExifSize > EXIF_FILE_SIZE) {
+                // no template for this layout yet, or a thumbnail too
+                // large for the room: built aside, and the stream moves
+                mem = spliceExif(mem, jpegSize, ThumbnailHeap, job);
+                JpegExifSize = mem ? mem->size - jpegSize : -1;
+            } else if (JpegExifSize >= 0) {
+                padExif(ptr + 2, JpegExifSize, EXIF_FILE_SIZE);
+            }
+            t0 = systemTime(SYSTEM_TIME_MONOTONIC);
+            SecCameraStats::record(STAGE_EXIF, t0 - t1);
 
             ALOGV("JpegExifSize=%d", JpegExifSize);
 
+            mThumbnailPool.put(ThumbnailHeap);
+
             if (JpegExifSize < 0) {
-                ret = UNKNOWN_ERROR;
-                ExifHeap->release(ExifHeap);
-                goto out;
+                ALOGE("ERR(%s):Fail on SecCamera->getExif()", __func__);
+                if (mem)
+                    mem->release(mem);
+                return;
             }
 
-            camera_memory_t *mem = mGetMemoryCb(-1, JpegImageSize + JpegExifSize, 1, 0);
-            uint8_t *ptr = (uint8_t *) mem->data;
-            memcpy(ptr, JpegHeap->data, 2); ptr += 2;
-            memcpy(ptr, ExifHeap->data, JpegExifSize); ptr += JpegExifSize;
-            memcpy(ptr, (uint8_t *) JpegHeap->data + 2, JpegImageSize - 2);
             mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, mem, 0, NULL, mCallbackCookie);
-            mem->release(mem);
-            ExifHeap->release(ExifHeap);
+            SecCameraStats::record(STAGE_JPEG_CALLBACK, systemTime(SYSTEM_TIME_MONOTONIC) - t0);
+            if (dumps & DUMP_JPEG)
+                save_jpeg(mem);
+            else
+                mem->release(mem);
+        }
+    }
+}
+
+/*
+ * The EXIF block didn't fit in the room assembleJpeg() left for it: build
+ * it in a pooled heap and put it together with the stream in a buffer of
+ * the exact size.  mem, holding SOI and the stream behind EXIF_FILE_SIZE
+ * bytes, is released; returns the new buffer, or NULL.
+ */
+camera_memory_t *CameraHardwareSec::spliceExif(camera_memory_t *mem, unsigned int jpegSize,
+                                               const sp<MemoryHeapBase>& thumbnail,
+                                               JpegJob *job)
+{
+    sp<MemoryHeapBase> ExifHeap = mExifPool.get();
+    camera_memory_t *out = NULL;
+
+    int exifSize = mSecCamera->getExif((unsigned char *)ExifHeap->base(), ExifHeap->getSize(),
+                                       (unsigned char *)thumbnail->base(),
+                                       job->thumbnailWidth, job->thumbnailHeight,
+                                       &job->exifInfo);
+    if (exifSize >= 0 && (size_t)exifSize <= ExifHeap->getSize()) {
+        out = mGetMemoryCb(-1, jpegSize + exifSize, 1, 0);
+        if (out) {
+            uint8_t *src = (uint8_t *)mem->data;
+            uint8_t *dst = (uint8_t *)out->data;
+
+            memcpy(dst, src, 2);
+            memcpy(dst + 2, ExifHeap->base(), exifSize);
+            memcpy(dst + 2 + exifSize, src + 2 + EXIF_FILE_SIZE, jpegSize - 2);
+        } else {
+            ALOGE("ERR(%s):Fail on jpeg heap creation", __func__);
         }
     }
 
-    LOG_TIME_END(0)
-    LOG_CAMERA("pictureThread interval: %lu us", LOG_TIME(0));
+    mExifPool.put(ExifHeap);
+    mem->release(mem);
+    return out;
+}
 
-    ALOGV("%s : pictureThread end", __func__);
+void CameraHardwareSec::releaseJpegJob(JpegJob *job)
+{
+    if (job->jpeg)
+        job->jpeg->release(job->jpeg);
+    if (job->nv12t) {
+        mVideoSnapshotPool.put(job->postview);
+        mVideoSnapshotPool.put(job->yuyv);
+    } else {
+        mPostviewPool.put(job->postview);
+    }
+    delete job;
+}
 
-out:
-    JpegHeap->release(JpegHeap);
-    mSecCamera->endSnapshot();
-    mCaptureLock.lock();
-    mCaptureInProgress = false;
-    mCaptureCondition.broadcast();
-    mCaptureLock.unlock();
+//======================================================================
+// Capture heap pool
+//
+// The postview, thumbnail, EXIF and video snapshot heaps only live inside
+// the HAL, so they are kept across shots instead of being created and torn
+// down every time.
+// Buffers handed to the client (raw and compressed image callbacks) are not
+// pooled since the client may hold on to them after the callback returns.
 
-    return ret;
+CameraHardwareSec::CaptureHeapPool::CaptureHeapPool(const char *name)
+    : mName(name),
+      mSize(0),
+      mHits(0),
+      mMisses(0)
+{
+}
+
+/*
+ * Switch the pool to heaps of the given size, dropping any of another size,
+ * and make sure count of them are ready for the next shot.
+ */
+void CameraHardwareSec::CaptureHeapPool::resize(size_t size, int count)
+{
+    Mutex::Autolock lock(mLock);
+
+    /* MemoryHeapBase rounds up to whole pages, and put() compares against
+     * the size a heap reports */
+    size_t page = getpagesize();
+    size = (size + page - 1) & ~(page - 1);
+
+    if (size != mSize) {
+        mFree.clear();
+        mSize = size;
+    }
+
+    while (mSize && (int)mFree.size() < count) {
+        sp<MemoryHeapBase> heap = new MemoryHeapBase(mSize);
+        if (heap->getHeapID() < 0) {
+            ALOGE("ERR(%s):Fail on %s heap creation(%d)", __func__, mName, mSize);
+            break;
+        }
+        mFree.push(heap);
+    }
+}
+
+sp<MemoryHeapBase> CameraHardwareSec::CaptureHeapPool::get()
+{
+    Mutex::Autolock lock(mLock);
+
+    if (!mFree.isEmpty()) {
+        sp<MemoryHeapBase> heap = mFree.top();
+        mFree.pop();
+        mHits++;
+        return heap;
+    }
+
+    mMisses++;
+    return new MemoryHeapBase(mSize);
+}
+
+void CameraHardwareSec::CaptureHeapPool::put(const sp<MemoryHeapBase>& heap)
+{
+    Mutex::Autolock lock(mLock);
+
+    /* heaps from before a size change just go away, and so do heaps
+     * someone else (the dump writer) still holds on to */
+    if (heap != 0 && heap->getSize() == mSize && heap->getStrongCount() == 1)
+        mFree.push(heap);
+}
+
+void CameraHardwareSec::CaptureHeapPool::clear()
+{
+    Mutex::Autolock lock(mLock);
+    mFree.clear();
+}
+
+void CameraHardwareSec::CaptureHeapPool::dump(String8& result) const
+{
+    char buffer[256];
+    Mutex::Autolock lock(mLock);
+
+    snprintf(buffer, 255, " %s pool: size(%d) free(%d) hits(%u) misses(%u) bytes held(%d)\n",
+             mName, mSize, mFree.size(), mHits, mMisses, mSize * mFree.size());
+    result.append(buffer);
+}
+
+void CameraHardwareSec::resizeCapturePools()
+{
+    int postview_width, postview_height, postview_size;
+    int thumb_width, thumb_height, thumb_size;
+    int cap_width, cap_height, cap_frame_size;
+    bool front = (mSecCamera->getCameraId() != SecCamera::CAMERA_ID_BACK);
+
+    mSecCamera->getPostViewConfig(&postview_width, &postview_height, &postview_size);
+    mSecCamera->getThumbnailConfig(&thumb_width, &thumb_height, &thumb_size);
+    mSecCamera->getSnapshotSize(&cap_width, &cap_height, &cap_frame_size);
+
+    /* the front camera captures the whole YUV422 frame into the postview */
+    if (front && cap_width * cap_height * 2 > postview_size)
+        postview_size = cap_width * cap_height * 2;
+
+    /* one shot capturing, one queued and one being assembled */
+    mPostviewPool.resize(postview_size, 3);
+    mThumbnailPool.resize(thumb_size, front ? 1 : 0);
+    /* EXIF blocks are built in the JPEG buffer itself once a shot's
+     * layout has a template, the first shot of a layout needs this */
+    mExifPool.resize(EXIF_MAX_BUILD_SIZE, front ? 1 : 0);
 }
 
 status_t CameraHardwareSec::waitCaptureCompletion() {
@@ -1206,8 +2543,23 @@ status_t CameraHardwareSec::takePicture()
 {
     ALOGV("%s :", __func__);
 
-    stopPreview();
+    /* stopping the preview would end the recording */
+    if (mRecordRunning)
+        return takeVideoSnapshot();
+
+    /* a ZSL shot leaves the preview running, it reports itself enabled
+     * so the client's next startPreview() is a no-op */
+    nsecs_t shutter = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool zsl = zslReady();
+    if (!zsl)
+        stopPreview();
 
+    mSecCamera->getPostViewConfig(&mPostViewWidth, &mPostViewHeight, &mPostViewSize);
+    if (mRawHeap && mRawHeap->size != (size_t)mPostViewSize) {
+        /* the postview size follows the preview size */
+        mRawHeap->release(mRawHeap);
+        mRawHeap = 0;
+    }
     if (!mRawHeap) {
         int rawHeapSize = mPostViewSize;
         ALOGV("mRawHeap : MemoryHeapBase(previewHeapSize(%d))", rawHeapSize);
@@ -1221,17 +2573,137 @@ status_t CameraHardwareSec::takePicture()
         return TIMED_OUT;
     }
 
-    if (mPictureThread->run("CameraPictureThread", PRIORITY_DEFAULT) != NO_ERROR) {
-        ALOGE("%s : couldn't run picture thread", __func__);
-        return INVALID_OPERATION;
-    }
+    mZslCapture = zsl;
+    mZslShutter = shutter;
+    if (mPictureThread->run("CameraPictureThread", PRIORITY_DEFAULT) != NO_ERROR) {
+        ALOGE("%s : couldn't run picture thread", __func__);
+        return INVALID_OPERATION;
+    }
+    mCaptureLock.lock();
+    mCaptureInProgress = true;
+    mCaptureLock.unlock();
+
+    return NO_ERROR;
+}
+
+//======================================================================
+// Video snapshot
+//
+// While recording, takePicture() must not touch the stream.  The still is
+// taken from the next record frame instead, at the recording size the
+// client asked for.  The record thread only copies the NV12T frame out
+// before it goes to the encoder, the jpeg thread detiles, converts and
+// encodes it.
+
+status_t CameraHardwareSec::takeVideoSnapshot()
+{
+    int width, height;
+
+    ALOGV("%s :", __func__);
+
+    if (waitCaptureCompletion() != NO_ERROR) {
+        return TIMED_OUT;
+    }
+
+    mSecCamera->getRecordFrameSize(&width, &height);
+
+    JpegJob *job = new JpegJob;
+    job->cameraId = mSecCamera->getCameraId();
+    job->jpeg = NULL;
+    job->postview = mVideoSnapshotPool.get();
+    if (job->postview->getHeapID() < 0) {
+        ALOGE("ERR(%s):Fail on video snapshot heap creation", __func__);
+        delete job;
+        return NO_MEMORY;
+    }
+    job->nv12t = true;
+    job->cbcrOffset = 0;
+    job->postviewWidth = width;
+    job->postviewHeight = height;
+    job->snapshotWidth = width;
+    job->snapshotHeight = height;
+    mSecCamera->getThumbnailConfig(&job->thumbnailWidth, &job->thumbnailHeight,
+                                   &job->thumbnailSize);
+    job->jpegQuality = mSecCamera->getJpegQuality();
+    mSecCamera->getExifInfo(&job->exifInfo);
+    job->exifInfo.width = width;
+    job->exifInfo.height = height;
+
     mCaptureLock.lock();
     mCaptureInProgress = true;
     mCaptureLock.unlock();
 
+    mJpegLock.lock();
+    mVideoSnapshotJob = job;
+    android_atomic_release_store(1, &mVideoSnapshotPending);
+    mJpegLock.unlock();
+
     return NO_ERROR;
 }
 
+/* recordFrame(), with a video snapshot pending */
+void CameraHardwareSec::grabVideoSnapshot(int index, unsigned int phyYAddr,
+                                          unsigned int phyCAddr)
+{
+    mJpegLock.lock();
+
+    /* the jpeg thread takes one job at a time; waiting for it here would
+     * cost video frames, so try again with the next frame */
+    JpegJob *job = mVideoSnapshotJob;
+    if (!job || mJpegJob) {
+        mJpegLock.unlock();
+        return;
+    }
+
+    mVideoSnapshotJob = NULL;
+    android_atomic_release_store(0, &mVideoSnapshotPending);
+
+    /* the chroma plane follows the luma one, wherever FIMC put it */
+    size_t length = 0;
+    const unsigned char *frame = mSecCamera->getRecordBuffer(index, &length);
+    size_t lumaSize = nv12tPlaneSize(job->snapshotWidth, job->snapshotHeight);
+    size_t cbcrOffset = phyCAddr - phyYAddr;
+    size_t size = cbcrOffset + nv12tPlaneSize(job->snapshotWidth, job->snapshotHeight / 2);
+    if (!frame || phyCAddr < phyYAddr || cbcrOffset < lumaSize ||
+        size > length || size > job->postview->getSize()) {
+        ALOGE("ERR(%s):Fail on record frame %d (%zu of %zu bytes, chroma at %zu)",
+              __func__, index, size, length, cbcrOffset);
+        mJpegLock.unlock();
+        releaseJpegJob(job);
+        finishCapture();
+        return;
+    }
+
+    memcpy(job->postview->base(), frame, size);
+    job->cbcrOffset = cbcrOffset;
+
+    mVideoSnapshots++;
+    mJpegJob = job;
+    mJpegCondition.broadcast();
+    mJpegLock.unlock();
+
+    if (mMsgEnabled & CAMERA_MSG_SHUTTER)
+        mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
+
+    finishCapture();
+}
+
+/* the preview or recording is stopping, a snapshot not grabbed yet won't be */
+void CameraHardwareSec::cancelVideoSnapshot()
+{
+    mJpegLock.lock();
+    JpegJob *job = mVideoSnapshotJob;
+    mVideoSnapshotJob = NULL;
+    android_atomic_release_store(0, &mVideoSnapshotPending);
+    mJpegLock.unlock();
+
+    if (job) {
+        ALOGW("%s: stopped before the video snapshot was taken", __func__);
+        releaseJpegJob(job);
+        finishCapture();
+    }
+}
+
 status_t CameraHardwareSec::cancelPicture()
 {
     ALOGV("%s", __func__);
@@ -1259,39 +2731,6 @@ bool CameraHardwareSec::CheckVideoStartMarker(unsigned char *pBuf)
     return false;
 }
 
-bool CameraHardwareSec::CheckEOIMarker(unsigned char *pBuf)
-{
-    if (!pBuf) {
-        ALOGE("CheckEOIMarker() => pBuf is NULL\n");
-        return false;
-    }
-
-    // EOI marker [FF D9]
-    if (HIBYTE(JPEG_EOI_MARKER) == *pBuf && LOBYTE(JPEG_EOI_MARKER) == *(pBuf + 1))
-        return true;
-
-    return false;
-}
-
-bool CameraHardwareSec::FindEOIMarkerInJPEG(unsigned char *pBuf, int dwBufSize, int *pnJPEGsize)
-{
-    if (NULL == pBuf || 0 >= dwBufSize) {
-        ALOGE("FindEOIMarkerInJPEG() => There is no contents.");
-        return false;
-    }
-
-    unsigned char *pBufEnd = pBuf + dwBufSize;
-
-    while (pBuf < pBufEnd) {
-        if (CheckEOIMarker(pBuf++))
-            return true;
-
-        (*pnJPEGsize)++;
-    }
-
-    return false;
-}
-
 status_t CameraHardwareSec::dump(int fd) const
 {
     const size_t SIZE = 256;
@@ -1305,6 +2744,64 @@ status_t CameraHardwareSec::dump(int fd) const
         mInternalParameters.dump(fd, args);
         snprintf(buffer, 255, " preview running(%s)\n", mPreviewRunning?"true": "false");
         result.append(buffer);
+        snprintf(buffer, 255, " preview path(%s)\n", mZeroCopyPreview ? "zero-copy" : "copy");
+        result.append(buffer);
+        snprintf(buffer, 255, " window buffer mappings(%d) hits(%u) misses(%u) locked(%s)\n",
+                 mPreviewMapCount, mPreviewMapHits, mPreviewMapMisses,
+                 mGrallocCached ? "first use" : "every frame");
+        result.append(buffer);
+
+        mZslLock.lock();
+        snprintf(buffer, 255, " zsl(%s) frames held(%d) shots(%u) last frame offset(%lldus)\n",
+                 mZslActive ? "on" : "off", mZslCount, mZslShots, ns2us(mZslLastOffset));
+        mZslLock.unlock();
+        result.append(buffer);
+        if (mScaledHeap)
+            snprintf(buffer, 255, " preview callbacks(%dx%d %s)\n", mScaledWidth, mScaledHeight,
+                     mScaledLumaOnly ? PREVIEW_CALLBACK_FORMAT_Y8 : "nv21");
+        else
+            snprintf(buffer, 255, " preview callbacks(full frame)\n");
+        result.append(buffer);
+        snprintf(buffer, 255, " video snapshots(%u) pending(%s)\n", mVideoSnapshots,
+                 mVideoSnapshotPending ? "true" : "false");
+        result.append(buffer);
+        snprintf(buffer, 255, " recording running(%s) metadata handles live(%d)\n",
+                 mRecordRunning ? "true" : "false", mRecordHandlesLive);
+        result.append(buffer);
+
+        static const char *pacingStates[] = { "normal", "skip-callbacks", "reduced-rate" };
+        mPacingLock.lock();
+        PreviewPacing pacing = mPacing;
+        mPacingLock.unlock();
+        snprintf(buffer, 255, " preview pacing(%s) callbacks(1/%d) fps(%d) display(%lldus) callback(%lldus)\n",
+                 pacingStates[pacing.state], pacing.callbackDivisor,
+                 pacing.state == PACING_REDUCED_RATE ? pacing.nominalFps / 2 : pacing.nominalFps,
+                 ns2us(pacing.displayCost), ns2us(pacing.callbackCost));
+        result.append(buffer);
+        snprintf(buffer, 255, " preview pacing callbacks dropped(%u) rate reductions(%u) restores(%u)\n",
+                 pacing.callbacksDropped, pacing.rateReductions, pacing.rateRestores);
+        result.append(buffer);
+
+        mPostviewPool.dump(result);
+        mThumbnailPool.dump(result);
+        mExifPool.dump(result);
+        mVideoSnapshotPool.dump(result);
+        snprintf(buffer, 255, " setParameters calls(%u) unchanged(%u) setters called(%u)\n",
+                 mParamStats.calls, mParamStats.unchanged, mParamStats.dispatched);
+        result.append(buffer);
+
+        mFocusLock.lock();
+        AutoFocusStats af = mAutoFocusStats;
+        mFocusLock.unlock();
+        snprintf(buffer, 255, " autofocus success(%u) fail(%u) cancel(%u)\n",
+                 af.success, af.fail, af.cancel);
+        result.append(buffer);
+        mJpegLock.lock();
+        sp<SecCameraDumpWriter> dumpWriter = mDumpWriter;
+        mJpegLock.unlock();
+        if (dumpWriter != NULL)
+            dumpWriter->dump(result);
+        SecCameraStats::dump(result);
     } else {
         result.append("No camera client yet.\n");
     }
@@ -1353,11 +2850,18 @@ bool CameraHardwareSec::isSupportedParameter(const char * const parm,
     /* NOTREACHED */
 }
 
+/*
+ * setParameters() is called for every zoom step and touch-AF tap, with the
+ * full parameter set each time.  Keys are looked up in the tables in
+ * SecCameraParams.cpp and only values that differ from mApplied, i.e. from
+ * what was last handed to SecCamera, are dispatched to its setters.
+ */
 status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 {
     ALOGV("%s :", __func__);
 
     status_t ret = NO_ERROR;
+    int dispatched = 0;
 
     /* if someone calls us while picture thread is running, it could screw
      * up the sensor quite a bit so return error.
@@ -1366,6 +2870,8 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         return TIMED_OUT;
     }
 
+    mParamStats.calls++;
+
     // preview size
     int new_preview_width  = 0;
     int new_preview_height = 0;
@@ -1413,11 +2919,13 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
                     mPreviewWindow->set_buffers_geometry(mPreviewWindow,
                                                          new_preview_width, new_preview_height,
                                                          new_preview_format);
+                    android_atomic_release_store(1, &mPreviewMapsStale);
                     ALOGV("%s: DONE mPreviewWindow (%p) set_buffers_geometry", __func__, mPreviewWindow);
                 }
 
                 mParameters.setPreviewSize(new_preview_width, new_preview_height);
                 mParameters.setPreviewFormat(new_str_preview_format);
+                dispatched++;
             }
         }
         else ALOGV("%s: preview size and format has not changed", __func__);
@@ -1433,14 +2941,19 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 
     params.getPictureSize(&new_picture_width, &new_picture_height);
     ALOGV("%s : new_picture_width x new_picture_height = %dx%d", __func__, new_picture_width, new_picture_height);
-    if (0 < new_picture_width && 0 < new_picture_height) {
+    if (0 < new_picture_width && 0 < new_picture_height &&
+        (new_picture_width != mApplied.pictureWidth ||
+         new_picture_height != mApplied.pictureHeight)) {
         ALOGV("%s: setSnapshotSize", __func__);
+        dispatched++;
         if (mSecCamera->setSnapshotSize(new_picture_width, new_picture_height) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setSnapshotSize(width(%d), height(%d))",
                     __func__, new_picture_width, new_picture_height);
             ret = UNKNOWN_ERROR;
         } else {
             mParameters.setPictureSize(new_picture_width, new_picture_height);
+            mApplied.pictureWidth = new_picture_width;
+            mApplied.pictureHeight = new_picture_height;
         }
     }
 
@@ -1448,36 +2961,18 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     const char *new_str_picture_format = params.getPictureFormat();
     ALOGV("%s : new_str_picture_format %s", __func__, new_str_picture_format);
     if (new_str_picture_format != NULL) {
-        int new_picture_format = 0;
-
-        if (!strcmp(new_str_picture_format, CameraParameters::PIXEL_FORMAT_RGB565))
-            new_picture_format = V4L2_PIX_FMT_RGB565;
-        else if (!strcmp(new_str_picture_format, CameraParameters::PIXEL_FORMAT_RGBA8888))
-            new_picture_format = V4L2_PIX_FMT_RGB32;
-        else if (!strcmp(new_str_picture_format, CameraParameters::PIXEL_FORMAT_YUV420SP))
-            new_picture_format = V4L2_PIX_FMT_NV21;
-        else if (!strcmp(new_str_picture_format, "yuv420sp_custom"))
-            new_picture_format = V4L2_PIX_FMT_NV12T;
-        else if (!strcmp(new_str_picture_format, "yuv420p"))
-            new_picture_format = V4L2_PIX_FMT_YUV420;
-        else if (!strcmp(new_str_picture_format, "yuv422i"))
-            new_picture_format = V4L2_PIX_FMT_YUYV;
-        else if (!strcmp(new_str_picture_format, "uyv422i_custom")) //Zero copy UYVY format
-            new_picture_format = V4L2_PIX_FMT_UYVY;
-        else if (!strcmp(new_str_picture_format, "uyv422i")) //Non-zero copy UYVY format
-            new_picture_format = V4L2_PIX_FMT_UYVY;
-        else if (!strcmp(new_str_picture_format, CameraParameters::PIXEL_FORMAT_JPEG))
-            new_picture_format = V4L2_PIX_FMT_YUYV;
-        else if (!strcmp(new_str_picture_format, "yuv422p"))
-            new_picture_format = V4L2_PIX_FMT_YUV422P;
-        else
-            new_picture_format = V4L2_PIX_FMT_NV21; //for 3rd party
+        const ParamEnum *format = lookupParam(pictureFormats, new_str_picture_format);
+        int new_picture_format = format ? format->value : V4L2_PIX_FMT_NV21; //for 3rd party
 
-        if (mSecCamera->setSnapshotPixelFormat(new_picture_format) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setSnapshotPixelFormat(format(%d))", __func__, new_picture_format);
-            ret = UNKNOWN_ERROR;
-        } else {
-            mParameters.setPictureFormat(new_str_picture_format);
+        if (new_picture_format != mApplied.pictureFormat) {
+            dispatched++;
+            if (mSecCamera->setSnapshotPixelFormat(new_picture_format) < 0) {
+                ALOGE("ERR(%s):Fail on mSecCamera->setSnapshotPixelFormat(format(%d))", __func__, new_picture_format);
+                ret = UNKNOWN_ERROR;
+            } else {
+                mParameters.setPictureFormat(new_str_picture_format);
+                mApplied.pictureFormat = new_picture_format;
+            }
         }
     }
 
@@ -1485,25 +2980,33 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     int new_jpeg_quality = params.getInt(CameraParameters::KEY_JPEG_QUALITY);
     ALOGV("%s : new_jpeg_quality %d", __func__, new_jpeg_quality);
     /* we ignore bad values */
-    if (new_jpeg_quality >=1 && new_jpeg_quality <= 100) {
+    if (new_jpeg_quality >=1 && new_jpeg_quality <= 100 &&
+        new_jpeg_quality != mApplied.jpegQuality) {
+        dispatched++;
         if (mSecCamera->setJpegQuality(new_jpeg_quality) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setJpegQuality(quality(%d))", __func__, new_jpeg_quality);
             ret = UNKNOWN_ERROR;
         } else {
             mParameters.set(CameraParameters::KEY_JPEG_QUALITY, new_jpeg_quality);
+            mApplied.jpegQuality = new_jpeg_quality;
         }
     }
 
     // JPEG thumbnail size
     int new_jpeg_thumbnail_width = params.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH);
     int new_jpeg_thumbnail_height= params.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT);
-    if (0 <= new_jpeg_thumbnail_width && 0 <= new_jpeg_thumbnail_height) {
+    if (0 <= new_jpeg_thumbnail_width && 0 <= new_jpeg_thumbnail_height &&
+        (new_jpeg_thumbnail_width != mApplied.thumbnailWidth ||
+         new_jpeg_thumbnail_height != mApplied.thumbnailHeight)) {
+        dispatched++;
         if (mSecCamera->setJpegThumbnailSize(new_jpeg_thumbnail_width, new_jpeg_thumbnail_height) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setJpegThumbnailSize(width(%d), height(%d))", __func__, new_jpeg_thumbnail_width, new_jpeg_thumbnail_height);
             ret = UNKNOWN_ERROR;
         } else {
             mParameters.set(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH, new_jpeg_thumbnail_width);
             mParameters.set(CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT, new_jpeg_thumbnail_height);
+            mApplied.thumbnailWidth = new_jpeg_thumbnail_width;
+            mApplied.thumbnailHeight = new_jpeg_thumbnail_height;
         }
     }
 
@@ -1520,13 +3023,15 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     // rotation
     int new_rotation = params.getInt(CameraParameters::KEY_ROTATION);
     ALOGV("%s : new_rotation %d", __func__, new_rotation);
-    if (0 <= new_rotation) {
+    if (0 <= new_rotation && new_rotation != mApplied.rotation) {
         ALOGV("%s : set orientation:%d\n", __func__, new_rotation);
+        dispatched++;
         if (mSecCamera->setExifOrientationInfo(new_rotation) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setExifOrientationInfo(%d)", __func__, new_rotation);
             ret = UNKNOWN_ERROR;
         } else {
             mParameters.set(CameraParameters::KEY_ROTATION, new_rotation);
+            mApplied.rotation = new_rotation;
         }
     }
 
@@ -1536,12 +3041,16 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     int min_exposure_compensation = params.getInt(CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION);
     ALOGV("%s : new_exposure_compensation %d", __func__, new_exposure_compensation);
     if ((min_exposure_compensation <= new_exposure_compensation) &&
-        (max_exposure_compensation >= new_exposure_compensation)) {
+        (max_exposure_compensation >= new_exposure_compensation) &&
+        (!mApplied.exposureValid || new_exposure_compensation != mApplied.exposure)) {
+        dispatched++;
         if (mSecCamera->setBrightness(new_exposure_compensation) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setBrightness(brightness(%d))", __func__, new_exposure_compensation);
             ret = UNKNOWN_ERROR;
         } else {
             mParameters.set(CameraParameters::KEY_EXPOSURE_COMPENSATION, new_exposure_compensation);
+            mApplied.exposure = new_exposure_compensation;
+            mApplied.exposureValid = true;
         }
     }
 
@@ -1549,72 +3058,94 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     const char *new_iso_str = params.get("iso");
     ALOGV("%s : new_iso_str %s", __func__, new_iso_str);
     if (new_iso_str != NULL) {
-        int new_iso = -1;
-
-        if (!strcmp(new_iso_str, "auto")) {
-            new_iso = ISO_AUTO;
-        } else if (!strcmp(new_iso_str, "ISO50")) {
-            new_iso = ISO_50;
-        } else if (!strcmp(new_iso_str, "ISO100")) {
-            new_iso = ISO_100;
-        } else if (!strcmp(new_iso_str, "ISO200")) {
-            new_iso = ISO_200;
-        } else if (!strcmp(new_iso_str, "ISO400")) {
-            new_iso = ISO_400;
-        } else if (!strcmp(new_iso_str, "ISO800")) {
-            new_iso = ISO_800;
-        } else if (!strcmp(new_iso_str, "ISO1600")) {
-            new_iso = ISO_1600;
-        } else if (!strcmp(new_iso_str, "ISO_SPORTS")) {
-            new_iso = ISO_SPORTS;
-        } else if (!strcmp(new_iso_str, "ISO_NIGHT")) {
-            new_iso = ISO_NIGHT;
-        } else {
+        const ParamEnum *iso = lookupParam(isoValues, new_iso_str);
+
+        if (iso == NULL) {
             ALOGE("ERR(%s):Invalid iso value(%s)", __func__, new_iso_str);
             ret = UNKNOWN_ERROR;
-        }
-
-        if (0 <= new_iso) {
-            if (mSecCamera->setISO(new_iso) < 0) {
-                ALOGE("ERR(%s):Fail on mSecCamera->setISO(new_iso(%d))", __func__, new_iso);
+        } else if (iso->value != mApplied.iso) {
+            dispatched++;
+            if (mSecCamera->setISO(iso->value) < 0) {
+                ALOGE("ERR(%s):Fail on mSecCamera->setISO(new_iso(%d))", __func__, iso->value);
                 ret = UNKNOWN_ERROR;
             } else {
                 mParameters.set("iso", new_iso_str);
+                mApplied.iso = iso->value;
             }
         }
     }
 
+    // burst capture
+    int new_burst_count = params.getInt(KEY_BURST_CAPTURE_COUNT);
+    ALOGV("%s : new_burst_count %d", __func__, new_burst_count);
+    if (0 < new_burst_count) {
+        if (new_burst_count > mParameters.getInt(KEY_MAX_BURST_CAPTURE_COUNT)) {
+            ALOGE("ERR(%s):Invalid burst capture count(%d)", __func__, new_burst_count);
+            ret = UNKNOWN_ERROR;
+        } else {
+            mBurstCount = new_burst_count;
+            mParameters.set(KEY_BURST_CAPTURE_COUNT, new_burst_count);
+        }
+    }
+
+    int new_burst_interval = params.getInt(KEY_BURST_CAPTURE_INTERVAL);
+    ALOGV("%s : new_burst_interval %d", __func__, new_burst_interval);
+    if (0 <= new_burst_interval) {
+        mBurstInterval = new_burst_interval;
+        mParameters.set(KEY_BURST_CAPTURE_INTERVAL, new_burst_interval);
+    }
+
+    // zero shutter lag
+    const char *new_zsl_str = params.get(KEY_ZSL);
+    if (new_zsl_str != NULL) {
+        if (isSupportedParameter(new_zsl_str, mParameters.get(KEY_SUPPORTED_ZSL_MODES))) {
+            mParameters.set(KEY_ZSL, new_zsl_str);
+        } else {
+            ALOGE("ERR(%s):Invalid zsl mode(%s)", __func__, new_zsl_str);
+            ret = UNKNOWN_ERROR;
+        }
+    }
+
+    // downscaled preview callbacks
+    const char *new_callback_size_str = params.get(KEY_PREVIEW_CALLBACK_SIZE);
+    if (new_callback_size_str != NULL) {
+        if (isSupportedParameter(new_callback_size_str,
+                                 mParameters.get(KEY_SUPPORTED_PREVIEW_CALLBACK_SIZES))) {
+            mParameters.set(KEY_PREVIEW_CALLBACK_SIZE, new_callback_size_str);
+        } else {
+            ALOGE("ERR(%s):Invalid preview callback size(%s)", __func__, new_callback_size_str);
+            ret = UNKNOWN_ERROR;
+        }
+    }
+
+    const char *new_callback_format_str = params.get(KEY_PREVIEW_CALLBACK_FORMAT);
+    if (new_callback_format_str != NULL) {
+        if (isSupportedParameter(new_callback_format_str,
+                                 mParameters.get(KEY_SUPPORTED_PREVIEW_CALLBACK_FORMATS))) {
+            mParameters.set(KEY_PREVIEW_CALLBACK_FORMAT, new_callback_format_str);
+        } else {
+            ALOGE("ERR(%s):Invalid preview callback format(%s)", __func__, new_callback_format_str);
+            ret = UNKNOWN_ERROR;
+        }
+    }
+
     // whitebalance
     const char *new_white_str = params.get(CameraParameters::KEY_WHITE_BALANCE);
     ALOGV("%s : new_white_str %s", __func__, new_white_str);
     if (new_white_str != NULL) {
-        int new_white = -1;
-
-        if (!strcmp(new_white_str, CameraParameters::WHITE_BALANCE_AUTO))
-            new_white = WHITE_BALANCE_AUTO;
-        else if (!strcmp(new_white_str,
-                         CameraParameters::WHITE_BALANCE_DAYLIGHT))
-            new_white = WHITE_BALANCE_SUNNY;
-        else if (!strcmp(new_white_str,
-                         CameraParameters::WHITE_BALANCE_CLOUDY_DAYLIGHT))
-            new_white = WHITE_BALANCE_CLOUDY;
-        else if (!strcmp(new_white_str,
-                         CameraParameters::WHITE_BALANCE_FLUORESCENT))
-            new_white = WHITE_BALANCE_FLUORESCENT;
-        else if (!strcmp(new_white_str,
-                         CameraParameters::WHITE_BALANCE_INCANDESCENT))
-            new_white = WHITE_BALANCE_TUNGSTEN;
-        else {
+        const ParamEnum *white = lookupParam(whiteBalances, new_white_str);
+
+        if (white == NULL) {
             ALOGE("ERR(%s):Invalid white balance(%s)", __func__, new_white_str); //twilight, shade, warm_flourescent
             ret = UNKNOWN_ERROR;
-        }
-
-        if (0 <= new_white) {
-            if (mSecCamera->setWhiteBalance(new_white) < 0) {
-                ALOGE("ERR(%s):Fail on mSecCamera->setWhiteBalance(white(%d))", __func__, new_white);
+        } else if (white->value != mApplied.whiteBalance) {
+            dispatched++;
+            if (mSecCamera->setWhiteBalance(white->value) < 0) {
+                ALOGE("ERR(%s):Fail on mSecCamera->setWhiteBalance(white(%d))", __func__, white->value);
                 ret = UNKNOWN_ERROR;
             } else {
                 mParameters.set(CameraParameters::KEY_WHITE_BALANCE, new_white_str);
+                mApplied.whiteBalance = white->value;
             }
         }
     }
@@ -1653,155 +3184,58 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     const char *new_focus_mode_str = params.get(CameraParameters::KEY_FOCUS_MODE);
 
     if (mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK) {
-        int  new_scene_mode = -1;
+        const SceneModeParam *scene = lookupParam(sceneModes, new_scene_mode_str);
 
 #ifdef HAVE_FLASH
         const char *new_flash_mode_str = params.get(CameraParameters::KEY_FLASH_MODE);
 #endif
 
-        // fps range is (15000,30000) by default.
-        mParameters.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE, "(15000,30000)");
-        mParameters.set(CameraParameters::KEY_PREVIEW_FPS_RANGE,
-                "15000,30000");
-
-        if (!strcmp(new_scene_mode_str, CameraParameters::SCENE_MODE_AUTO)) {
-            new_scene_mode = SCENE_MODE_NONE;
-#ifdef HAVE_FLASH
-            mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "on,off,auto,torch");
-#endif
-        } else {
+        if (scene == NULL) {
+            ALOGE("%s::unmatched scene_mode(%s)",
+                    __func__, new_scene_mode_str); //action, night-portrait, theatre, steadyphoto
+            ret = UNKNOWN_ERROR;
+        } else if (scene->value != SCENE_MODE_NONE) {
             // defaults for non-auto scene modes
-            if (mSecCamera->getCameraId() == SecCamera::CAMERA_ID_BACK) {
-                new_focus_mode_str = CameraParameters::FOCUS_MODE_AUTO;
-            }
-#ifdef HAVE_FLASH
-            new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-#endif
-
-            if (!strcmp(new_scene_mode_str,
-                       CameraParameters::SCENE_MODE_PORTRAIT)) {
-                new_scene_mode = SCENE_MODE_PORTRAIT;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_AUTO;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "auto");
-#endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_LANDSCAPE)) {
-                new_scene_mode = SCENE_MODE_LANDSCAPE;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
-#endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_SPORTS)) {
-                new_scene_mode = SCENE_MODE_SPORTS;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
-#endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_PARTY)) {
-                new_scene_mode = SCENE_MODE_PARTY_INDOOR;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_AUTO;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "auto");
-#endif
-            } else if ((!strcmp(new_scene_mode_str,
-                                CameraParameters::SCENE_MODE_BEACH)) ||
-                        (!strcmp(new_scene_mode_str,
-                                 CameraParameters::SCENE_MODE_SNOW))) {
-                new_scene_mode = SCENE_MODE_BEACH_SNOW;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
-#endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_SUNSET)) {
-                new_scene_mode = SCENE_MODE_SUNSET;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
-#endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_NIGHT)) {
-                new_scene_mode = SCENE_MODE_NIGHTSHOT;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE, "(4000,30000)");
-                mParameters.set(CameraParameters::KEY_PREVIEW_FPS_RANGE,
-                                "4000,30000");
+            new_focus_mode_str = CameraParameters::FOCUS_MODE_AUTO;
 #ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
+            new_flash_mode_str = scene->flashMode;
 #endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_FIREWORKS)) {
-                new_scene_mode = SCENE_MODE_FIREWORKS;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
-#endif
-            } else if (!strcmp(new_scene_mode_str,
-                               CameraParameters::SCENE_MODE_CANDLELIGHT)) {
-                new_scene_mode = SCENE_MODE_CANDLE_LIGHT;
-#ifdef HAVE_FLASH
-                new_flash_mode_str = CameraParameters::FLASH_MODE_OFF;
-                mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, "off");
-#endif
-            } else {
-                ALOGE("%s::unmatched scene_mode(%s)",
-                        __func__, new_scene_mode_str); //action, night-portrait, theatre, steadyphoto
-                ret = UNKNOWN_ERROR;
-            }
         }
 
         // focus mode
         if (new_focus_mode_str != NULL) {
-            int  new_focus_mode = -1;
+            const FocusModeParam *focus = lookupParam(focusModes, new_focus_mode_str);
 
-            if (!strcmp(new_focus_mode_str,
-                        CameraParameters::FOCUS_MODE_AUTO)) {
-                new_focus_mode = FOCUS_MODE_AUTO;
-                mParameters.set(CameraParameters::KEY_FOCUS_DISTANCES,
-                                BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR);
-            }
-            else if (!strcmp(new_focus_mode_str,
-                             CameraParameters::FOCUS_MODE_MACRO)) {
-                new_focus_mode = FOCUS_MODE_MACRO;
-                mParameters.set(CameraParameters::KEY_FOCUS_DISTANCES,
-                                BACK_CAMERA_MACRO_FOCUS_DISTANCES_STR);
-            }
-            else if (!strcmp(new_focus_mode_str,
-                             CameraParameters::FOCUS_MODE_INFINITY)) {
-                new_focus_mode = FOCUS_MODE_INFINITY;
-                mParameters.set(CameraParameters::KEY_FOCUS_DISTANCES,
-                                BACK_CAMERA_INFINITY_FOCUS_DISTANCES_STR);
-            }
-            else if (!strcmp(new_focus_mode_str, FOCUS_MODE_FACEDETECT)) {
-                // Enable face detect here, SecCamera will take care of the rest
-                if (mSecCamera->setFaceDetect(FACE_DETECTION_ON) < 0) {
-                    ALOGE("%s::mSecCamera->setFaceDetect(%d) fail", __func__, FACE_DETECTION_ON);
-                    ret = UNKNOWN_ERROR;
-                }
-                mParameters.set(CameraParameters::KEY_FOCUS_MODE, new_focus_mode_str);
-                mParameters.set(CameraParameters::KEY_FOCUS_DISTANCES,
-                                BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR);
-            }
-            else {
+            if (focus == NULL) {
                 ALOGE("%s::unmatched focus_mode(%s)", __func__, new_focus_mode_str);
                 ret = UNKNOWN_ERROR;
-            }
+            } else if (focus->value != mApplied.focusMode) {
+                dispatched++;
+                if (focus->value == FOCUS_MODE_FACEDETECT_ON) {
+                    // Enable face detect here, SecCamera will take care of the rest
+                    if (mSecCamera->setFaceDetect(FACE_DETECTION_ON) < 0) {
+                        ALOGE("%s::mSecCamera->setFaceDetect(%d) fail", __func__, FACE_DETECTION_ON);
+                        ret = UNKNOWN_ERROR;
+                    }
+                    mParameters.set(CameraParameters::KEY_FOCUS_MODE, new_focus_mode_str);
+                    mParameters.set(CameraParameters::KEY_FOCUS_DISTANCES, focus->distances);
+                    mApplied.focusMode = focus->value;
+                } else {
+                    mParameters.set(CameraParameters::KEY_FOCUS_DISTANCES, focus->distances);
 
-            if (0 <= new_focus_mode) {
-                // Disable face-detect
-                if (mSecCamera->setFaceDetect(FACE_DETECTION_OFF) < 0) {
-                    ALOGE("%s::mSecCamera->setFaceDetect(%d) fail", __func__, FACE_DETECTION_OFF);
-                    ret = UNKNOWN_ERROR;
-                }
+                    // Disable face-detect
+                    if (mSecCamera->setFaceDetect(FACE_DETECTION_OFF) < 0) {
+                        ALOGE("%s::mSecCamera->setFaceDetect(%d) fail", __func__, FACE_DETECTION_OFF);
+                        ret = UNKNOWN_ERROR;
+                    }
 
-                if (mSecCamera->setFocusMode(new_focus_mode) < 0) {
-                    ALOGE("%s::mSecCamera->setFocusMode(%d) fail", __func__, new_focus_mode);
-                    ret = UNKNOWN_ERROR;
-                } else {
-                    mParameters.set(CameraParameters::KEY_FOCUS_MODE, new_focus_mode_str);
+                    if (mSecCamera->setFocusMode(focus->value) < 0) {
+                        ALOGE("%s::mSecCamera->setFocusMode(%d) fail", __func__, focus->value);
+                        ret = UNKNOWN_ERROR;
+                    } else {
+                        mParameters.set(CameraParameters::KEY_FOCUS_MODE, new_focus_mode_str);
+                        mApplied.focusMode = focus->value;
+                    }
                 }
             }
         }
@@ -1809,65 +3243,89 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 #ifdef HAVE_FLASH
         // flash..
         if (new_flash_mode_str != NULL) {
-            int  new_flash_mode = -1;
-
-            if (!strcmp(new_flash_mode_str, CameraParameters::FLASH_MODE_OFF))
-                new_flash_mode = FLASH_MODE_OFF;
-            else if (!strcmp(new_flash_mode_str, CameraParameters::FLASH_MODE_AUTO))
-                new_flash_mode = FLASH_MODE_AUTO;
-            else if (!strcmp(new_flash_mode_str, CameraParameters::FLASH_MODE_ON))
-                new_flash_mode = FLASH_MODE_ON;
-            else if (!strcmp(new_flash_mode_str, CameraParameters::FLASH_MODE_TORCH))
-                new_flash_mode = FLASH_MODE_TORCH;
-            else {
+            const ParamEnum *flash = lookupParam(flashModes, new_flash_mode_str);
+
+            if (flash == NULL) {
                 ALOGE("%s::unmatched flash_mode(%s)", __func__, new_flash_mode_str); //red-eye
                 ret = UNKNOWN_ERROR;
-            }
-            if (0 <= new_flash_mode) {
-                if (mSecCamera->setFlashMode(new_flash_mode) < 0) {
-                    ALOGE("%s::mSecCamera->setFlashMode(%d) fail", __func__, new_flash_mode);
+            } else if (flash->value != mApplied.flashMode) {
+                dispatched++;
+                if (mSecCamera->setFlashMode(flash->value) < 0) {
+                    ALOGE("%s::mSecCamera->setFlashMode(%d) fail", __func__, flash->value);
                     ret = UNKNOWN_ERROR;
                 } else {
                     mParameters.set(CameraParameters::KEY_FLASH_MODE, new_flash_mode_str);
+                    mApplied.flashMode = flash->value;
                 }
             }
         }
 #endif
 
         //  scene..
-        if (0 <= new_scene_mode) {
-            if (mSecCamera->setSceneMode(new_scene_mode) < 0) {
-                ALOGE("%s::mSecCamera->setSceneMode(%d) fail", __func__, new_scene_mode);
+        if (scene != NULL && scene->value != mApplied.sceneMode) {
+            // fps range is (15000,30000) by default.
+            if (scene->value == SCENE_MODE_NIGHTSHOT) {
+                mParameters.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE, "(4000,30000)");
+                mParameters.set(CameraParameters::KEY_PREVIEW_FPS_RANGE, "4000,30000");
+            } else {
+                mParameters.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE, "(15000,30000)");
+                mParameters.set(CameraParameters::KEY_PREVIEW_FPS_RANGE, "15000,30000");
+            }
+#ifdef HAVE_FLASH
+            mParameters.set(CameraParameters::KEY_SUPPORTED_FLASH_MODES, scene->supportedFlashModes);
+#endif
+
+            dispatched++;
+            if (mSecCamera->setSceneMode(scene->value) < 0) {
+                ALOGE("%s::mSecCamera->setSceneMode(%d) fail", __func__, scene->value);
                 ret = UNKNOWN_ERROR;
             } else {
                 mParameters.set(CameraParameters::KEY_SCENE_MODE, new_scene_mode_str);
+                mApplied.sceneMode = scene->value;
             }
         }
 
-        // touch to focus
+        // touch to focus, the area string itself is kept in mParameters
         const char *new_focus_area = params.get(CameraParameters::KEY_FOCUS_AREAS);
         if (new_focus_area != NULL) {
             ALOGV("focus area: %s", new_focus_area);
             SecCameraArea area(new_focus_area);
+            int val = area.isDummy() ? 0 : 1;
+            int x = -1, y = -1;
 
-            if (!area.isDummy()) {
+            if (val) {
                 int width, height, frame_size;
                 mSecCamera->getPreviewSize(&width, &height, &frame_size);
 
-                int x = area.getX(width);
-                int y = area.getY(height);
+                x = area.getX(width);
+                y = area.getY(height);
+            }
+
+            if (val != mApplied.touchAF || x != mApplied.touchX || y != mApplied.touchY) {
+                bool applied = true;
+
+                dispatched++;
+                if (val) {
+                    ALOGV("area=%s, x=%i, y=%i", area.toString8().string(), x, y);
+                    if (mSecCamera->setObjectPosition(x, y) < 0) {
+                        ALOGE("ERR(%s):Fail on mSecCamera->setObjectPosition(%s)", __func__, new_focus_area);
+                        ret = UNKNOWN_ERROR;
+                        applied = false;
+                    }
+                }
 
-                ALOGV("area=%s, x=%i, y=%i", area.toString8().string(), x, y);
-                if (mSecCamera->setObjectPosition(x, y) < 0) {
-                    ALOGE("ERR(%s):Fail on mSecCamera->setObjectPosition(%s)", __func__, new_focus_area);
+                if (mSecCamera->setTouchAFStartStop(val) < 0) {
+                    ALOGE("ERR(%s):Fail on mSecCamera->setTouchAFStartStop(%d)", __func__, val);
                     ret = UNKNOWN_ERROR;
+                    applied = false;
                 }
-            }
 
-            int val = area.isDummy() ? 0 : 1;
-            if (mSecCamera->setTouchAFStartStop(val) < 0) {
-                ALOGE("ERR(%s):Fail on mSecCamera->setTouchAFStartStop(%d)", __func__, val);
-                ret = UNKNOWN_ERROR;
+                if (applied) {
+                    mParameters.set(CameraParameters::KEY_FOCUS_AREAS, new_focus_area);
+                    mApplied.touchAF = val;
+                    mApplied.touchX = x;
+                    mApplied.touchY = y;
+                }
             }
         }
 
@@ -1875,13 +3333,15 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         int new_zoom = params.getInt(CameraParameters::KEY_ZOOM);
         int max_zoom = params.getInt(CameraParameters::KEY_MAX_ZOOM);
         ALOGV("%s : new_zoom %d", __func__, new_zoom);
-        if (0 <= new_zoom && new_zoom <= max_zoom) {
+        if (0 <= new_zoom && new_zoom <= max_zoom && new_zoom != mApplied.zoom) {
             ALOGV("%s : set zoom:%d\n", __func__, new_zoom);
+            dispatched++;
             if (mSecCamera->setZoom(new_zoom) < 0) {
                 ALOGE("ERR(%s):Fail on mSecCamera->setZoom(%d)", __func__, new_zoom);
                 ret = UNKNOWN_ERROR;
             } else {
                 mParameters.set(CameraParameters::KEY_ZOOM, new_zoom);
+                mApplied.zoom = new_zoom;
             }
         }
     } else {
@@ -1897,28 +3357,16 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     // image effect
     const char *new_image_effect_str = params.get(CameraParameters::KEY_EFFECT);
     if (new_image_effect_str != NULL) {
+        const ParamEnum *effect = lookupParam(imageEffects, new_image_effect_str);
 
-        int  new_image_effect = -1;
-
-        if (!strcmp(new_image_effect_str, CameraParameters::EFFECT_NONE))
-            new_image_effect = IMAGE_EFFECT_NONE;
-        else if (!strcmp(new_image_effect_str, CameraParameters::EFFECT_MONO))
-            new_image_effect = IMAGE_EFFECT_BNW;
-        else if (!strcmp(new_image_effect_str, CameraParameters::EFFECT_SEPIA))
-            new_image_effect = IMAGE_EFFECT_SEPIA;
-        else if (!strcmp(new_image_effect_str, CameraParameters::EFFECT_AQUA))
-            new_image_effect = IMAGE_EFFECT_AQUA;
-        else if (!strcmp(new_image_effect_str, CameraParameters::EFFECT_NEGATIVE))
-            new_image_effect = IMAGE_EFFECT_NEGATIVE;
-        else {
+        if (effect == NULL) {
             //posterize, whiteboard, blackboard, solarize
             ALOGE("ERR(%s):Invalid effect(%s)", __func__, new_image_effect_str);
             ret = UNKNOWN_ERROR;
-        }
-
-        if (new_image_effect >= 0) {
-            if (mSecCamera->setImageEffect(new_image_effect) < 0) {
-                ALOGE("ERR(%s):Fail on mSecCamera->setImageEffect(effect(%d))", __func__, new_image_effect);
+        } else if (effect->value != mApplied.effect) {
+            dispatched++;
+            if (mSecCamera->setImageEffect(effect->value) < 0) {
+                ALOGE("ERR(%s):Fail on mSecCamera->setImageEffect(effect(%d))", __func__, effect->value);
                 ret = UNKNOWN_ERROR;
             } else {
                 const char *old_image_effect_str = mParameters.get(CameraParameters::KEY_EFFECT);
@@ -1930,131 +3378,99 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
                 }
 
                 mParameters.set(CameraParameters::KEY_EFFECT, new_image_effect_str);
+                mApplied.effect = effect->value;
             }
         }
     }
 
-    //vt mode
-    int new_vtmode = mInternalParameters.getInt("vtmode");
-    if (0 <= new_vtmode) {
-        if (mSecCamera->setVTmode(new_vtmode) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setVTMode(%d)", __func__, new_vtmode);
-            ret = UNKNOWN_ERROR;
-        }
-    }
-
-    //contrast
-    int new_contrast = mInternalParameters.getInt("contrast");
-
-    if (0 <= new_contrast) {
-        if (mSecCamera->setContrast(new_contrast) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setContrast(%d)", __func__, new_contrast);
-            ret = UNKNOWN_ERROR;
-        }
-    }
-
-    //WDR
-    int new_wdr = mInternalParameters.getInt("wdr");
+    // internal integer settings: vt mode, contrast, WDR, anti shake,
+    // camcorder fix fps, shot mode, blur for video call, chk_dataline
+    static const struct {
+        const char  *key;
+        int         AppliedParams::*applied;
+        int         (SecCamera::*set)(int);
+        const char  *setter;
+    } internalParams[] = {
+        { "vtmode",       &AppliedParams::vtMode,     &SecCamera::setVTmode,        "setVTmode" },
+        { "contrast",     &AppliedParams::contrast,   &SecCamera::setContrast,      "setContrast" },
+        { "wdr",          &AppliedParams::wdr,        &SecCamera::setWDR,           "setWDR" },
+        { "anti-shake",   &AppliedParams::antiShake,  &SecCamera::setAntiShake,     "setAntiShake" },
+        { "cam_mode",     &AppliedParams::sensorMode, &SecCamera::setSensorMode,    "setSensorMode" },
+        { "shot_mode",    &AppliedParams::shotMode,   &SecCamera::setShotMode,      "setShotMode" },
+        { "blur",         &AppliedParams::blur,       &SecCamera::setBlur,          "setBlur" },
+        { "chk_dataline", &AppliedParams::dataline,   &SecCamera::setDataLineCheck, "setDataLineCheck" },
+    };
 
-    if (0 <= new_wdr) {
-        if (mSecCamera->setWDR(new_wdr) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setWDR(%d)", __func__, new_wdr);
-            ret = UNKNOWN_ERROR;
-        }
-    }
+    for (size_t i = 0; i < sizeof(internalParams) / sizeof(internalParams[0]); i++) {
+        int value = mInternalParameters.getInt(internalParams[i].key);
 
-    //anti shake
-    int new_anti_shake = mInternalParameters.getInt("anti-shake");
+        if (value < 0 || value == mApplied.*internalParams[i].applied)
+            continue;
 
-    if (0 <= new_anti_shake) {
-        if (mSecCamera->setAntiShake(new_anti_shake) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setWDR(%d)", __func__, new_anti_shake);
+        dispatched++;
+        if ((mSecCamera->*internalParams[i].set)(value) < 0) {
+            ALOGE("ERR(%s):Fail on mSecCamera->%s(%d)", __func__, internalParams[i].setter, value);
             ret = UNKNOWN_ERROR;
-        }
-    }
-
-    // gps latitude
-    const char *new_gps_latitude_str = params.get(CameraParameters::KEY_GPS_LATITUDE);
-    if (mSecCamera->setGPSLatitude(new_gps_latitude_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSLatitude(%s) fail", __func__, new_gps_latitude_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_latitude_str) {
-            mParameters.set(CameraParameters::KEY_GPS_LATITUDE, new_gps_latitude_str);
-        } else {
-            mParameters.remove(CameraParameters::KEY_GPS_LATITUDE);
-        }
-    }
-
-    // gps longitude
-    const char *new_gps_longitude_str = params.get(CameraParameters::KEY_GPS_LONGITUDE);
-
-    if (mSecCamera->setGPSLongitude(new_gps_longitude_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSLongitude(%s) fail", __func__, new_gps_longitude_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_longitude_str) {
-            mParameters.set(CameraParameters::KEY_GPS_LONGITUDE, new_gps_longitude_str);
-        } else {
-            mParameters.remove(CameraParameters::KEY_GPS_LONGITUDE);
-        }
-    }
-
-    // gps altitude
-    const char *new_gps_altitude_str = params.get(CameraParameters::KEY_GPS_ALTITUDE);
-
-    if (mSecCamera->setGPSAltitude(new_gps_altitude_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSAltitude(%s) fail", __func__, new_gps_altitude_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_altitude_str) {
-            mParameters.set(CameraParameters::KEY_GPS_ALTITUDE, new_gps_altitude_str);
         } else {
-            mParameters.remove(CameraParameters::KEY_GPS_ALTITUDE);
+            mApplied.*internalParams[i].applied = value;
         }
     }
 
-    // gps timestamp
-    const char *new_gps_timestamp_str = params.get(CameraParameters::KEY_GPS_TIMESTAMP);
+    // gps latitude, longitude, altitude, timestamp, processing method
+    static const struct {
+        const char  *key;
+        int         (SecCamera::*set)(const char *);
+        const char  *setter;
+    } gpsParams[] = {
+        { CameraParameters::KEY_GPS_LATITUDE,          &SecCamera::setGPSLatitude,         "setGPSLatitude" },
+        { CameraParameters::KEY_GPS_LONGITUDE,         &SecCamera::setGPSLongitude,        "setGPSLongitude" },
+        { CameraParameters::KEY_GPS_ALTITUDE,          &SecCamera::setGPSAltitude,         "setGPSAltitude" },
+        { CameraParameters::KEY_GPS_TIMESTAMP,         &SecCamera::setGPSTimeStamp,        "setGPSTimeStamp" },
+        { CameraParameters::KEY_GPS_PROCESSING_METHOD, &SecCamera::setGPSProcessingMethod, "setGPSProcessingMethod" },
+    };
 
-    if (mSecCamera->setGPSTimeStamp(new_gps_timestamp_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSTimeStamp(%s) fail", __func__, new_gps_timestamp_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_timestamp_str) {
-            mParameters.set(CameraParameters::KEY_GPS_TIMESTAMP, new_gps_timestamp_str);
-        } else {
-            mParameters.remove(CameraParameters::KEY_GPS_TIMESTAMP);
-        }
-    }
+    for (size_t i = 0; i < sizeof(gpsParams) / sizeof(gpsParams[0]); i++) {
+        const char *new_gps_str = params.get(gpsParams[i].key);
+        const char *current_gps_str = mParameters.get(gpsParams[i].key);
 
-    // gps processing method
-    const char *new_gps_processing_method_str = params.get(CameraParameters::KEY_GPS_PROCESSING_METHOD);
+        /* mParameters holds whatever was last applied, or nothing */
+        if (mApplied.gpsValid &&
+            (new_gps_str == current_gps_str ||
+             (new_gps_str && current_gps_str && !strcmp(new_gps_str, current_gps_str))))
+            continue;
 
-    if (mSecCamera->setGPSProcessingMethod(new_gps_processing_method_str) < 0) {
-        ALOGE("%s::mSecCamera->setGPSProcessingMethod(%s) fail", __func__, new_gps_processing_method_str);
-        ret = UNKNOWN_ERROR;
-    } else {
-        if (new_gps_processing_method_str) {
-            mParameters.set(CameraParameters::KEY_GPS_PROCESSING_METHOD, new_gps_processing_method_str);
+        dispatched++;
+        if ((mSecCamera->*gpsParams[i].set)(new_gps_str) < 0) {
+            ALOGE("%s::mSecCamera->%s(%s) fail", __func__, gpsParams[i].setter, new_gps_str);
+            ret = UNKNOWN_ERROR;
         } else {
-            mParameters.remove(CameraParameters::KEY_GPS_PROCESSING_METHOD);
+            if (new_gps_str) {
+                mParameters.set(gpsParams[i].key, new_gps_str);
+            } else {
+                mParameters.remove(gpsParams[i].key);
+            }
         }
     }
+    mApplied.gpsValid = true;
 
     // Recording size
     int new_recording_width = mInternalParameters.getInt("recording-size-width");
     int new_recording_height= mInternalParameters.getInt("recording-size-height");
 
-    if (0 < new_recording_width && 0 < new_recording_height) {
+    if (new_recording_width <= 0 || new_recording_height <= 0) {
+        new_recording_width = new_preview_width;
+        new_recording_height = new_preview_height;
+    }
+
+    if (new_recording_width != mApplied.recordingWidth ||
+        new_recording_height != mApplied.recordingHeight) {
+        dispatched++;
         if (mSecCamera->setRecordingSize(new_recording_width, new_recording_height) < 0) {
             ALOGE("ERR(%s):Fail on mSecCamera->setRecordingSize(width(%d), height(%d))", __func__, new_recording_width, new_recording_height);
             ret = UNKNOWN_ERROR;
-        }
-    } else {
-        if (mSecCamera->setRecordingSize(new_preview_width, new_preview_height) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setRecordingSize(width(%d), height(%d))", __func__, new_preview_width, new_preview_height);
-            ret = UNKNOWN_ERROR;
+        } else {
+            mApplied.recordingWidth = new_recording_width;
+            mApplied.recordingHeight = new_recording_height;
         }
     }
 
@@ -2062,20 +3478,18 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     const char *new_gamma_str = mInternalParameters.get("video_recording_gamma");
 
     if (new_gamma_str != NULL) {
-        int new_gamma = -1;
-        if (!strcmp(new_gamma_str, "off"))
-            new_gamma = GAMMA_OFF;
-        else if (!strcmp(new_gamma_str, "on"))
-            new_gamma = GAMMA_ON;
-        else {
+        const ParamEnum *gamma = lookupParam(gammaModes, new_gamma_str);
+
+        if (gamma == NULL) {
             ALOGE("%s::unmatched gamma(%s)", __func__, new_gamma_str);
             ret = UNKNOWN_ERROR;
-        }
-
-        if (0 <= new_gamma) {
-            if (mSecCamera->setGamma(new_gamma) < 0) {
-                ALOGE("%s::mSecCamera->setGamma(%d) fail", __func__, new_gamma);
+        } else if (gamma->value != mApplied.gamma) {
+            dispatched++;
+            if (mSecCamera->setGamma(gamma->value) < 0) {
+                ALOGE("%s::mSecCamera->setGamma(%d) fail", __func__, gamma->value);
                 ret = UNKNOWN_ERROR;
+            } else {
+                mApplied.gamma = gamma->value;
             }
         }
     }
@@ -2084,80 +3498,45 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
     const char *new_slow_ae_str = mInternalParameters.get("slow_ae");
 
     if (new_slow_ae_str != NULL) {
-        int new_slow_ae = -1;
+        const ParamEnum *slow_ae = lookupParam(slowAeModes, new_slow_ae_str);
 
-        if (!strcmp(new_slow_ae_str, "off"))
-            new_slow_ae = SLOW_AE_OFF;
-        else if (!strcmp(new_slow_ae_str, "on"))
-            new_slow_ae = SLOW_AE_ON;
-        else {
+        if (slow_ae == NULL) {
             ALOGE("%s::unmatched slow_ae(%s)", __func__, new_slow_ae_str);
             ret = UNKNOWN_ERROR;
-        }
-
-        if (0 <= new_slow_ae) {
-            if (mSecCamera->setSlowAE(new_slow_ae) < 0) {
-                ALOGE("%s::mSecCamera->setSlowAE(%d) fail", __func__, new_slow_ae);
+        } else if (slow_ae->value != mApplied.slowAe) {
+            dispatched++;
+            if (mSecCamera->setSlowAE(slow_ae->value) < 0) {
+                ALOGE("%s::mSecCamera->setSlowAE(%d) fail", __func__, slow_ae->value);
                 ret = UNKNOWN_ERROR;
+            } else {
+                mApplied.slowAe = slow_ae->value;
             }
         }
     }
 
-    /*Camcorder fix fps*/
-    int new_sensor_mode = mInternalParameters.getInt("cam_mode");
-
-    if (0 <= new_sensor_mode) {
-        if (mSecCamera->setSensorMode(new_sensor_mode) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setSensorMode(%d)", __func__, new_sensor_mode);
-            ret = UNKNOWN_ERROR;
-        }
-    } else {
-        new_sensor_mode=0;
-    }
-
-    /*Shot mode*/
-    int new_shot_mode = mInternalParameters.getInt("shot_mode");
-
-    if (0 <= new_shot_mode) {
-        if (mSecCamera->setShotMode(new_shot_mode) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setShotMode(%d)", __func__, new_shot_mode);
-            ret = UNKNOWN_ERROR;
-        }
-    } else {
-        new_shot_mode=0;
-    }
-
-    //blur for Video call
-    int new_blur_level = mInternalParameters.getInt("blur");
-
-    if (0 <= new_blur_level) {
-        if (mSecCamera->setBlur(new_blur_level) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setBlur(%d)", __func__, new_blur_level);
-            ret = UNKNOWN_ERROR;
-        }
-    }
-
-
-    // chk_dataline
-    int new_dataline = mInternalParameters.getInt("chk_dataline");
-
-    if (0 <= new_dataline) {
-        if (mSecCamera->setDataLineCheck(new_dataline) < 0) {
-            ALOGE("ERR(%s):Fail on mSecCamera->setDataLineCheck(%d)", __func__, new_dataline);
+    /* nothing new for the sensor, no need to make it re-read its settings */
+    if (dispatched) {
+        if (mSecCamera->setBatchReflection()) {
+            ALOGE("ERR(%s):Fail on mSecCamera->setBatchReflection()", __func__);
             ret = UNKNOWN_ERROR;
         }
+        resizeCapturePools();
     }
 
-    if (mSecCamera->setBatchReflection()) {
-        ALOGE("ERR(%s):Fail on mSecCamera->setBatchReflection()", __func__);
-        ret = UNKNOWN_ERROR;
-    }
+    mParamStats.dispatched += dispatched;
+    if (!dispatched)
+        mParamStats.unchanged++;
 
-    ALOGV("%s return ret = %d", __func__, ret);
+    ALOGV("%s return ret = %d, %d setters called", __func__, ret, dispatched);
 
     return ret;
 }
 
+CameraHardwareSec::ParamStats CameraHardwareSec::getParamStats() const
+{
+    return mParamStats;
+}
+
 CameraParameters CameraHardwareSec::getParameters() const
 {
     ALOGV("%s :", __func__);
@@ -2171,6 +3550,10 @@ status_t CameraHardwareSec::sendCommand(int32_t command, int32_t arg1, int32_t a
         // Pretend there's no error so Camera doesn't crash
         return NO_ERROR;
     }
+    if (command == CAMERA_CMD_RESET_PIPELINE_STATS) {
+        SecCameraStats::reset();
+        return NO_ERROR;
+    }
     return BAD_VALUE;
 }
 
@@ -2196,6 +3579,7 @@ void CameraHardwareSec::release()
         mPreviewThread->requestExitAndWait();
         mPreviewThread.clear();
     }
+    releaseZeroCopyPreview();
     if (mAutoFocusThread != NULL) {
         /* this thread is normally already in it's threadLoop but blocked
          * on the condition variable.  signal it so it wakes up and can exit.
@@ -2212,19 +3596,43 @@ void CameraHardwareSec::release()
         mPictureThread->requestExitAndWait();
         mPictureThread.clear();
     }
+    if (mJpegThread != NULL) {
+        /* a shot still waiting for assembly is dropped */
+        mJpegLock.lock();
+        mJpegThread->requestExit();
+        mExitJpegThread = true;
+        mJpegCondition.broadcast();
+        mJpegLock.unlock();
+        mJpegThread->requestExitAndWait();
+        mJpegThread.clear();
+    }
+    if (mDumpWriter != NULL) {
+        /* dumps still queued are dropped */
+        mDumpWriter->stop();
+        mDumpWriter.clear();
+    }
 
     if (mRawHeap) {
         mRawHeap->release(mRawHeap);
         mRawHeap = 0;
     }
+    mPostviewPool.clear();
+    mThumbnailPool.clear();
+    mExifPool.clear();
+    mVideoSnapshotPool.clear();
     if (mPreviewHeap) {
         mPreviewHeap->release(mPreviewHeap);
         mPreviewHeap = 0;
     }
     if (mRecordHeap) {
+        destroyRecordHandles();
         mRecordHeap->release(mRecordHeap);
         mRecordHeap = 0;
     }
+    free(mNv21Scratch);
+    mNv21Scratch = NULL;
+    mNv21ScratchSize = 0;
+    releaseScaledCallbacks();
 
      /* close after all the heaps are cleared since those
      * could have dup'd our file descriptor.
@@ -20,6 +20,8 @@
 #define ANDROID_HARDWARE_CAMERA_HARDWARE_SEC_H
 
 #include "SecCamera.h"
+#include "SecCameraDumpWriter.h"
+#include "SecCameraUtils.h"
 #include <utils/threads.h>
 #include <utils/RefBase.h>
 #include <binder/MemoryBase.h>
@@ -30,6 +32,9 @@
 
 namespace android {
 
+/* vendor sendCommand() that clears the pipeline stage histograms */
+#define CAMERA_CMD_RESET_PIPELINE_STATS 0x5EC0
+
 struct AriesCameraInfo {
     /**
      * The direction that the camera faces to. It should be CAMERA_FACING_BACK
@@ -87,11 +92,23 @@ public:
 
     inline  int         getCameraId() const;
 
+    /* setParameters() calls, those that changed nothing, and setters called */
+    struct ParamStats {
+        unsigned int        calls;
+        unsigned int        unchanged;
+        unsigned int        dispatched;
+    };
+            ParamStats  getParamStats() const;
+
     CameraHardwareSec(int cameraId, camera_device_t *dev);
     virtual             ~CameraHardwareSec();
 private:
     status_t    startPreviewInternal();
     void stopPreviewInternal();
+    status_t    initZeroCopyPreview();
+    void        releaseZeroCopyPreview();
+    int         queueZeroCopyBuffer(buffer_handle_t *buf_handle, int stride);
+    int         swapZeroCopyBuffer(int index);
 
     static  const int   kBufferCount = MAX_BUFFERS;
     static  const int   kBufferCountForRecord = MAX_BUFFERS;
@@ -123,6 +140,135 @@ private:
         }
     };
 
+    class JpegThread : public Thread {
+        CameraHardwareSec *mHardware;
+    public:
+        JpegThread(CameraHardwareSec *hw): Thread(false), mHardware(hw) { }
+        virtual void onFirstRef() {
+            run("CameraJpegThread", PRIORITY_DEFAULT);
+        }
+        virtual bool threadLoop() {
+            mHardware->jpegThread();
+            return true;
+        }
+    };
+
+    /* recycles the internal per-shot heaps between captures */
+    class CaptureHeapPool {
+    public:
+        CaptureHeapPool(const char *name);
+        void                resize(size_t size, int count);
+        sp<MemoryHeapBase>  get();
+        void                put(const sp<MemoryHeapBase>& heap);
+        void                clear();
+        void                dump(String8& result) const;
+    private:
+        const char          *mName;
+        mutable Mutex       mLock;
+        Vector< sp<MemoryHeapBase> > mFree;
+        size_t              mSize;
+        unsigned int        mHits;
+        unsigned int        mMisses;
+    };
+
+    /* one captured shot on its way from pictureThread to jpegThread */
+    struct JpegJob {
+        int                 cameraId;
+        /* back camera: the ISP's JPEG, already complete with EXIF */
+        camera_memory_t     *jpeg;
+        /* front camera: the YUV frame, encoded by the jpeg thread */
+        sp<MemoryHeapBase>  postview;
+        /* postview is an NV12T record frame rather than YUYV, its chroma
+         * plane cbcrOffset bytes in; the jpeg thread converts it to yuyv */
+        bool                nv12t;
+        int                 cbcrOffset;
+        sp<MemoryHeapBase>  yuyv;
+        int                 postviewWidth;
+        int                 postviewHeight;
+        int                 snapshotWidth;
+        int                 snapshotHeight;
+        /* YUYV thumbnail the jpeg thread scales the postview to */
+        int                 thumbnailWidth;
+        int                 thumbnailHeight;
+        int                 thumbnailSize;
+        int                 jpegQuality;
+        exif_attribute_t    exifInfo;
+    };
+
+    /* a preview frame held back from the driver for zero shutter lag */
+    struct ZslFrame {
+        int                 index;
+        nsecs_t             timestamp;
+        bool                nv21;       /* converted in place for the callback */
+    };
+
+    /* AF outcomes, the search times go to STAGE_AUTOFOCUS */
+    struct AutoFocusStats {
+        unsigned int        success;
+        unsigned int        fail;
+        unsigned int        cancel;
+    };
+
+    /* values setParameters() last handed to SecCamera, -1 if none yet */
+    struct AppliedParams {
+        int                 pictureWidth;
+        int                 pictureHeight;
+        int                 pictureFormat;
+        int                 jpegQuality;
+        int                 thumbnailWidth;
+        int                 thumbnailHeight;
+        int                 rotation;
+        int                 exposure;
+        bool                exposureValid;
+        int                 iso;
+        int                 whiteBalance;
+        int                 sceneMode;
+        int                 focusMode;
+        int                 flashMode;
+        int                 zoom;
+        /* touch AF on or off, and the sensor position it was given */
+        int                 touchAF;
+        int                 touchX;
+        int                 touchY;
+        int                 effect;
+        int                 vtMode;
+        int                 contrast;
+        int                 wdr;
+        int                 antiShake;
+        int                 sensorMode;
+        int                 shotMode;
+        int                 blur;
+        int                 dataline;
+        /* the GPS strings themselves are kept in mParameters */
+        bool                gpsValid;
+        int                 recordingWidth;
+        int                 recordingHeight;
+        int                 gamma;
+        int                 slowAe;
+    };
+
+    /* previewThread() load shedding, see updatePreviewPacing() */
+    enum PacingState {
+        PACING_NORMAL,
+        PACING_SKIP_CALLBACKS,
+        PACING_REDUCED_RATE,
+    };
+
+    struct PreviewPacing {
+        int                 state;
+        int                 callbackDivisor;    /* deliver one callback in N */
+        unsigned int        frame;
+        int                 nominalFps;
+        int                 restoreFps;         /* the sensor's rate before the reduction */
+        nsecs_t             displayCost;        /* smoothed, per frame */
+        nsecs_t             callbackCost;       /* smoothed, per callback */
+        int                 overBudget;         /* consecutive frames */
+        int                 underBudget;
+        unsigned int        callbacksDropped;
+        unsigned int        rateReductions;
+        unsigned int        rateRestores;
+    };
+
     class AutoFocusThread : public Thread {
         CameraHardwareSec *mHardware;
     public:
@@ -138,21 +284,53 @@ private:
 
             void        initDefaultParameters(int cameraId);
             void        initHeapLocked();
+            void        invalidateAppliedParams();
+            AppliedParams mApplied;
+            ParamStats  mParamStats;
 
     sp<PreviewThread>   mPreviewThread;
             int         previewThread();
             int         previewThreadWrapper();
+            void        resetPreviewPacing();
+            void        updatePreviewPacing(nsecs_t displayCost,
+                                            nsecs_t callbackCost,
+                                            bool callbackDropped);
+            void        restorePreviewRateLocked();
+            void        zslPushFrame(int index, nsecs_t timestamp, bool nv21);
+            void        zslFlush();
+            bool        zslReady();
+            int         zslCapture(uint8_t *yuyv, nsecs_t shutter);
+            status_t    takeVideoSnapshot();
+            void        grabVideoSnapshot(int index, unsigned int phyYAddr,
+                                          unsigned int phyCAddr);
+            void        cancelVideoSnapshot();
 
     sp<AutoFocusThread> mAutoFocusThread;
             int         autoFocusThread();
+            void        recordAutoFocus(nsecs_t duration, int status);
 
     sp<PictureThread>   mPictureThread;
             int         pictureThread();
+            int         burstCapture(int count, int interval);
+            int         triggerBurstFrame(nsecs_t *last, int interval);
+            void        finishCapture();
             bool        mCaptureInProgress;
-
-            int         save_jpeg(unsigned char *real_jpeg, int jpeg_size);
-            void        save_postview(const char *fname, uint8_t *buf,
-                                        uint32_t size);
+            int         mBurstCount;
+            int         mBurstInterval;
+
+    sp<JpegThread>      mJpegThread;
+            int         jpegThread();
+            status_t    queueJpegJob(JpegJob *job);
+            void        assembleJpeg(JpegJob *job);
+            camera_memory_t *spliceExif(camera_memory_t *mem, unsigned int jpegSize,
+                                        const sp<MemoryHeapBase>& thumbnail, JpegJob *job);
+            void        releaseJpegJob(JpegJob *job);
+            void        resizeCapturePools();
+
+            int         debugDumps();
+            int         save_jpeg(camera_memory_t *jpeg);
+            int         save_postview(const sp<MemoryHeapBase>& heap,
+                                      uint32_t size);
             int         decodeInterleaveData(unsigned char *pInterleaveData,
                                                 int interleaveDataSize,
                                                 int yuvWidth,
@@ -160,15 +338,8 @@ private:
                                                 int *pJpegSize,
                                                 void *pJpegData,
                                                 void *pYuvData);
-            bool        YUY2toNV21(void *srcBuf, void *dstBuf, uint32_t srcWidth, uint32_t srcHeight);
-            bool        scaleDownYuv422(char *srcBuf, uint32_t srcWidth,
-                                        uint32_t srcHight, char *dstBuf,
-                                        uint32_t dstWidth, uint32_t dstHight);
 
             bool        CheckVideoStartMarker(unsigned char *pBuf);
-            bool        CheckEOIMarker(unsigned char *pBuf);
-            bool        FindEOIMarkerInJPEG(unsigned char *pBuf,
-                                            int dwBufSize, int *pnJPEGsize);
             bool        SplitFrame(unsigned char *pFrame, int dwSize,
                                    int dwJPEGLineLength, int dwVideoLineLength,
                                    int dwVideoHeight, void *pJPEG,
@@ -184,6 +355,7 @@ private:
     mutable Mutex       mFocusLock;
     mutable Condition   mFocusCondition;
             bool        mExitAutoFocusThread;
+            AutoFocusStats mAutoFocusStats;
 
     /* used by preview thread to block until it's told to run */
     mutable Mutex       mPreviewLock;
@@ -193,24 +365,106 @@ private:
             bool        mPreviewStartDeferred;
             bool        mExitPreviewThread;
 
+    /* guards mPacing; previewThread() only ever tryLock()s it */
+    mutable Mutex       mPacingLock;
+            PreviewPacing mPacing;
+
+    /* front camera zero shutter lag: the latest preview frames stay with
+     * the HAL so a shot can be encoded from one of them without stopping
+     * the preview.  mZslActive only changes while the preview thread is
+     * idle, the ring is guarded by mZslLock. */
+    enum { ZSL_RING_SIZE = 3 };
+    mutable Mutex       mZslLock;
+    mutable Condition   mZslCondition;
+            ZslFrame    mZslRing[ZSL_RING_SIZE];
+            int         mZslHead;
+            int         mZslCount;
+            bool        mZslActive;
+            bool        mZslCapture;    /* the shot in flight comes from the ring */
+            nsecs_t     mZslShutter;
+            unsigned int mZslShots;
+            nsecs_t     mZslLastOffset; /* frame time minus shutter time */
+
             preview_stream_ops *mPreviewWindow;
 
+    /* zero-copy preview: FIMC captures straight into the window buffers */
+            bool        mZeroCopyPreview;
+            preview_stream_ops *mZeroCopyWindow;
+            buffer_handle_t *mZeroCopyHandles[kBufferCount];
+            void        *mZeroCopyAddrs[kBufferCount];
+            unsigned int mZeroCopyHeld;     /* dequeued from the window and locked */
+            int         mZeroCopyMissing;   /* owed to the FIMC by the window */
+
+    /* addresses and strides the window buffers seen by the copy path were
+     * locked at, dropped by previewThread() once mPreviewMapsStale is raised */
+    struct PreviewMapping {
+        buffer_handle_t handle;
+        void        *vaddr;
+        int         stride;
+    };
+            PreviewMapping mPreviewMaps[kBufferCount];
+            int         mPreviewMapCount;
+            volatile int32_t mPreviewMapsStale;
+            bool        mGrallocCached; /* the gralloc lets known buffers go unlocked */
+            bool        mPreviewLocked; /* the buffer being filled is locked */
+            unsigned int mPreviewMapHits;
+            unsigned int mPreviewMapMisses;
+            int         lockPreviewBuffer(buffer_handle_t *buf_handle, int stride,
+                                          int width, int height, void **vaddr);
+            void        unlockPreviewBuffer(buffer_handle_t *buf_handle);
+
     /* used to guard mCaptureInProgress */
     mutable Mutex       mCaptureLock;
     mutable Condition   mCaptureCondition;
 
+    /* used to hand captured shots to the jpeg thread, one at a time */
+    mutable Mutex       mJpegLock;
+    mutable Condition   mJpegCondition;
+            JpegJob     *mJpegJob;
+            bool        mExitJpegThread;
+
+    /* video snapshot set up by takePicture() while recording, filled from
+     * the next preview frame; guarded by mJpegLock */
+            JpegJob     *mVideoSnapshotJob;
+            volatile int32_t mVideoSnapshotPending;
+            unsigned int mVideoSnapshots;
+
+    /* debug dumps of the shots, started by the jpeg thread on demand and
+     * guarded by mJpegLock */
+    sp<SecCameraDumpWriter> mDumpWriter;
+            unsigned int mDumpSequence;
+
+            CaptureHeapPool mPostviewPool;
+            CaptureHeapPool mThumbnailPool;
+            CaptureHeapPool mExifPool;
+            CaptureHeapPool mVideoSnapshotPool;
+
     CameraParameters    mParameters;
     CameraParameters    mInternalParameters;
 
     camera_memory_t     *mPreviewHeap;
+            uint8_t     *mNv21Scratch;
+            size_t      mNv21ScratchSize;
+
+    /* downscaled preview callbacks, set up by startPreviewInternal() */
+            camera_memory_t *mScaledHeap;
+            int         mScaledWidth;
+            int         mScaledHeight;
+            bool        mScaledLumaOnly;
+            int         mScaledFrameSize;
+            unsigned int mScaledIndex;
+            uint8_t     *mScaledScratch;
+            size_t      mScaledScratchSize;
+            void        initScaledCallbacks(int width, int height);
+            void        releaseScaledCallbacks(void);
+            int         scalePreviewCallback(int index, int width, int height, int offset);
     camera_memory_t     *mRawHeap;
     camera_memory_t     *mRecordHeap;
 
     SecCamera           *mSecCamera;
             const __u8  *mCameraSensorName;
 
-    mutable Mutex       mSkipFrameLock;
-            int         mSkipFrame;
+            volatile int32_t mSkipFrame;
 
     camera_notify_callback     mNotifyCb;
     camera_data_callback       mDataCb;
@@ -218,10 +472,24 @@ private:
     camera_request_memory      mGetMemoryCb;
             void        *mCallbackCookie;
 
-            int32_t     mMsgEnabled;
-
-            bool        mRecordRunning;
+            volatile int32_t mMsgEnabled;
+
+    /* previewThread() runs the record path without taking mRecordLock,
+     * which only serializes startRecording() and stopRecording() */
+            volatile int32_t mRecordRunning;
+            volatile int32_t mRecordBusy;
+    /* stopRecording() sleeps on mRecordIdle with mRecordWaiting raised
+     * until previewThread() drops mRecordBusy */
+            volatile int32_t mRecordWaiting;
+    mutable Mutex       mRecordIdleLock;
+            Condition   mRecordIdle;
+            int         recordFrame();
+            int         mRecordHandlesLive;
+            int         createRecordHandles();
+            void        destroyRecordHandles();
     mutable Mutex       mRecordLock;
+            RecordReturnRing mRecordReturns;
+    mutable Mutex       mRecordReturnLock;
             int         mPostViewWidth;
             int         mPostViewHeight;
             int         mPostViewSize;
@@ -0,0 +1,133 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraParams.h"
+
+#include <camera/CameraParameters.h>
+#include <linux/videodev2.h>
+#include <videodev2_samsung.h>
+
+namespace android {
+
+const char FOCUS_MODE_FACEDETECT[] = "facedetect";
+
+const ParamEnum pictureFormats[] = {
+    { CameraParameters::PIXEL_FORMAT_RGB565,   V4L2_PIX_FMT_RGB565 },
+    { CameraParameters::PIXEL_FORMAT_RGBA8888, V4L2_PIX_FMT_RGB32 },
+    { CameraParameters::PIXEL_FORMAT_YUV420SP, V4L2_PIX_FMT_NV21 },
+    { "yuv420sp_custom",                       V4L2_PIX_FMT_NV12T },
+    { "yuv420p",                               V4L2_PIX_FMT_YUV420 },
+    { "yuv422i",                               V4L2_PIX_FMT_YUYV },
+    { "uyv422i_custom",                        V4L2_PIX_FMT_UYVY }, //Zero copy UYVY format
+    { "uyv422i",                               V4L2_PIX_FMT_UYVY }, //Non-zero copy UYVY format
+    { CameraParameters::PIXEL_FORMAT_JPEG,     V4L2_PIX_FMT_YUYV },
+    { "yuv422p",                               V4L2_PIX_FMT_YUV422P },
+    { NULL, -1 },
+};
+
+const ParamEnum isoValues[] = {
+    { "auto",       ISO_AUTO },
+    { "ISO50",      ISO_50 },
+    { "ISO100",     ISO_100 },
+    { "ISO200",     ISO_200 },
+    { "ISO400",     ISO_400 },
+    { "ISO800",     ISO_800 },
+    { "ISO1600",    ISO_1600 },
+    { "ISO_SPORTS", ISO_SPORTS },
+    { "ISO_NIGHT",  ISO_NIGHT },
+    { NULL, -1 },
+};
+
+const ParamEnum whiteBalances[] = {
+    { CameraParameters::WHITE_BALANCE_AUTO,            WHITE_BALANCE_AUTO },
+    { CameraParameters::WHITE_BALANCE_DAYLIGHT,        WHITE_BALANCE_SUNNY },
+    { CameraParameters::WHITE_BALANCE_CLOUDY_DAYLIGHT, WHITE_BALANCE_CLOUDY },
+    { CameraParameters::WHITE_BALANCE_FLUORESCENT,     WHITE_BALANCE_FLUORESCENT },
+    { CameraParameters::WHITE_BALANCE_INCANDESCENT,    WHITE_BALANCE_TUNGSTEN },
+    { NULL, -1 },
+};
+
+const SceneModeParam sceneModes[] = {
+    { CameraParameters::SCENE_MODE_AUTO,        SCENE_MODE_NONE,
+      NULL,                                     "on,off,auto,torch" },
+    { CameraParameters::SCENE_MODE_PORTRAIT,    SCENE_MODE_PORTRAIT,
+      CameraParameters::FLASH_MODE_AUTO,        "auto" },
+    { CameraParameters::SCENE_MODE_LANDSCAPE,   SCENE_MODE_LANDSCAPE,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_SPORTS,      SCENE_MODE_SPORTS,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_PARTY,       SCENE_MODE_PARTY_INDOOR,
+      CameraParameters::FLASH_MODE_AUTO,        "auto" },
+    { CameraParameters::SCENE_MODE_BEACH,       SCENE_MODE_BEACH_SNOW,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_SNOW,        SCENE_MODE_BEACH_SNOW,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_SUNSET,      SCENE_MODE_SUNSET,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_NIGHT,       SCENE_MODE_NIGHTSHOT,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_FIREWORKS,   SCENE_MODE_FIREWORKS,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { CameraParameters::SCENE_MODE_CANDLELIGHT, SCENE_MODE_CANDLE_LIGHT,
+      CameraParameters::FLASH_MODE_OFF,         "off" },
+    { NULL, -1, NULL, NULL },
+};
+
+const FocusModeParam focusModes[] = {
+    { CameraParameters::FOCUS_MODE_AUTO,     FOCUS_MODE_AUTO,
+      BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR },
+    { CameraParameters::FOCUS_MODE_MACRO,    FOCUS_MODE_MACRO,
+      BACK_CAMERA_MACRO_FOCUS_DISTANCES_STR },
+    { CameraParameters::FOCUS_MODE_INFINITY, FOCUS_MODE_INFINITY,
+      BACK_CAMERA_INFINITY_FOCUS_DISTANCES_STR },
+    { FOCUS_MODE_FACEDETECT,                 FOCUS_MODE_FACEDETECT_ON,
+      BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR },
+    { NULL, -1, NULL },
+};
+
+#ifdef HAVE_FLASH
+const ParamEnum flashModes[] = {
+    { CameraParameters::FLASH_MODE_OFF,   FLASH_MODE_OFF },
+    { CameraParameters::FLASH_MODE_AUTO,  FLASH_MODE_AUTO },
+    { CameraParameters::FLASH_MODE_ON,    FLASH_MODE_ON },
+    { CameraParameters::FLASH_MODE_TORCH, FLASH_MODE_TORCH },
+    { NULL, -1 },
+};
+#endif
+
+const ParamEnum imageEffects[] = {
+    { CameraParameters::EFFECT_NONE,     IMAGE_EFFECT_NONE },
+    { CameraParameters::EFFECT_MONO,     IMAGE_EFFECT_BNW },
+    { CameraParameters::EFFECT_SEPIA,    IMAGE_EFFECT_SEPIA },
+    { CameraParameters::EFFECT_AQUA,     IMAGE_EFFECT_AQUA },
+    { CameraParameters::EFFECT_NEGATIVE, IMAGE_EFFECT_NEGATIVE },
+    { NULL, -1 },
+};
+
+const ParamEnum gammaModes[] = {
+    { "off", GAMMA_OFF },
+    { "on",  GAMMA_ON },
+    { NULL, -1 },
+};
+
+const ParamEnum slowAeModes[] = {
+    { "off", SLOW_AE_OFF },
+    { "on",  SLOW_AE_ON },
+    { NULL, -1 },
+};
+
+}; // namespace android
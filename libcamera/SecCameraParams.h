@@ -0,0 +1,88 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_PARAMS_H
+#define ANDROID_HARDWARE_CAMERA_SEC_PARAMS_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define BACK_CAMERA_AUTO_FOCUS_DISTANCES_STR       "0.10,1.20,Infinity"
+#define BACK_CAMERA_MACRO_FOCUS_DISTANCES_STR      "0.10,0.20,Infinity"
+#define BACK_CAMERA_INFINITY_FOCUS_DISTANCES_STR   "0.10,1.20,Infinity"
+#define FRONT_CAMERA_FOCUS_DISTANCES_STR           "0.20,0.25,Infinity"
+
+namespace android {
+
+/*
+ * String values of the enum-like parameters, looked up with lookupParam()
+ * instead of open-coded strcmp chains.  Every table ends with a NULL name.
+ */
+struct ParamEnum {
+    const char *name;
+    int         value;
+};
+
+struct FocusModeParam {
+    const char *name;
+    int         value;
+    const char *distances;
+};
+
+struct SceneModeParam {
+    const char *name;
+    int         value;
+    /* flash mode forced by the scene, and the ones it allows */
+    const char *flashMode;
+    const char *supportedFlashModes;
+};
+
+/* not a SecCamera focus mode, face detection is switched on instead */
+static const int FOCUS_MODE_FACEDETECT_ON = -2;
+
+// Samsung-specific focus mode
+extern const char FOCUS_MODE_FACEDETECT[];
+
+extern const ParamEnum pictureFormats[];
+extern const ParamEnum isoValues[];
+extern const ParamEnum whiteBalances[];
+extern const SceneModeParam sceneModes[];
+extern const FocusModeParam focusModes[];
+#ifdef HAVE_FLASH
+extern const ParamEnum flashModes[];
+#endif
+extern const ParamEnum imageEffects[];
+extern const ParamEnum gammaModes[];
+extern const ParamEnum slowAeModes[];
+
+template <typename T>
+inline const T *lookupParam(const T *table, const char *str)
+{
+    if (str == NULL)
+        return NULL;
+
+    for (; table->name != NULL; table++) {
+        if (!strcmp(table->name, str))
+            return table;
+    }
+
+    return NULL;
+}
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_PARAMS_H
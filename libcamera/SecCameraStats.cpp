@@ -0,0 +1,162 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraStats.h"
+
+#include <stdio.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+#define STATS_MIN_BUCKET_US 16
+
+struct StageHistogram {
+    volatile int32_t    buckets[SecCameraStats::BUCKETS];
+    volatile int32_t    max;        /* us */
+    volatile int32_t    last;       /* us */
+};
+
+static const char *stageNames[STAGE_COUNT] = {
+    "camera init",
+    "record node open",
+    "preview start",
+    "init to first preview frame",
+    "preview dqbuf",
+    "window dequeue",
+    "gralloc lock",
+    "plane copy",
+    "window enqueue",
+    "nv21 convert",
+    "callback scale",
+    "preview callback",
+    "record dqbuf",
+    "record callback",
+    "autofocus",
+    "snapshot prepare",
+    "snapshot capture",
+    "snapshot post",
+    "thumbnail",
+    "exif",
+    "encode",
+    "jpeg assemble",
+    "jpeg callback",
+};
+
+/* SecCamera is a singleton, so one set of histograms serves the process */
+static StageHistogram stageStats[STAGE_COUNT];
+
+static int bucketOf(int32_t us)
+{
+    int bucket = 0;
+
+    while (bucket < SecCameraStats::BUCKETS - 1 &&
+           us >= (STATS_MIN_BUCKET_US << bucket))
+        bucket++;
+
+    return bucket;
+}
+
+/* upper bound of the bucket holding the given fraction of the samples,
+ * the maximum seen when that is the open-ended last bucket */
+static int32_t percentile(const int32_t *buckets, int32_t count, int permille,
+                          int32_t max)
+{
+    int32_t target = ((int64_t)count * permille + 999) / 1000;
+    int32_t seen = 0;
+
+    for (int i = 0; i < SecCameraStats::BUCKETS - 1; i++) {
+        seen += buckets[i];
+        if (seen >= target)
+            return STATS_MIN_BUCKET_US << i;
+    }
+
+    return max;
+}
+
+void SecCameraStats::record(SecCameraStage stage, nsecs_t duration)
+{
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return;
+
+    StageHistogram &s = stageStats[stage];
+    int64_t us = ns2us(duration);
+    int32_t value = us < 0 ? 0 : (us > 0x7fffffff ? 0x7fffffff : (int32_t)us);
+
+    android_atomic_inc(&s.buckets[bucketOf(value)]);
+    android_atomic_release_store(value, &s.last);
+
+    int32_t max;
+    do {
+        max = s.max;
+    } while (value > max && android_atomic_cmpxchg(max, value, &s.max));
+}
+
+void SecCameraStats::reset(void)
+{
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageHistogram &s = stageStats[i];
+
+        for (int j = 0; j < BUCKETS; j++)
+            android_atomic_release_store(0, &s.buckets[j]);
+        android_atomic_release_store(0, &s.max);
+        android_atomic_release_store(0, &s.last);
+    }
+}
+
+void SecCameraStats::dump(String8& result)
+{
+    char buffer[256];
+
+    result.append(" pipeline stages (us):\n");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageHistogram &s = stageStats[i];
+        int32_t buckets[BUCKETS];
+        int32_t count = 0;
+
+        /* count from the buckets themselves, so a record() racing with
+         * this can't make the percentiles run past the samples read */
+        for (int j = 0; j < BUCKETS; j++) {
+            buckets[j] = android_atomic_acquire_load(&s.buckets[j]);
+            count += buckets[j];
+        }
+        if (count == 0)
+            continue;
+
+        int32_t max = android_atomic_acquire_load(&s.max);
+        int32_t p50 = percentile(buckets, count, 500, max);
+        int32_t p90 = percentile(buckets, count, 900, max);
+        int32_t p99 = percentile(buckets, count, 990, max);
+
+        snprintf(buffer, 255, "  %s: count(%d) p50(<%d) p90(<%d) p99(<%d) max(%d) last(%d)\n",
+                 stageNames[i], count, p50, p90, p99, max, s.last);
+        result.append(buffer);
+
+        result.append("   ");
+        for (int j = 0; j < BUCKETS; j++) {
+            if (buckets[j] == 0)
+                continue;
+            if (j < BUCKETS - 1)
+                snprintf(buffer, 255, " <%d(%d)", STATS_MIN_BUCKET_US << j, buckets[j]);
+            else
+                snprintf(buffer, 255, " >=%d(%d)", STATS_MIN_BUCKET_US << (j - 1), buckets[j]);
+            result.append(buffer);
+        }
+        result.append("\n");
+    }
+}
+
+}; // namespace android
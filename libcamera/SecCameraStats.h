@@ -0,0 +1,92 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef ANDROID_HARDWARE_CAMERA_SEC_STATS_H
+#define ANDROID_HARDWARE_CAMERA_SEC_STATS_H
+
+#include <stdint.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/*
+ * Pipeline stages whose latency is tracked.  Each stage keeps a histogram
+ * of log2 buckets that is updated with atomics only, so it is cheap enough
+ * to stay on in release builds and can be read from dump() at any time.
+ */
+enum SecCameraStage {
+    STAGE_CAMERA_INIT,
+    STAGE_RECORD_NODE_OPEN,
+    STAGE_PREVIEW_START,
+    STAGE_FIRST_PREVIEW_FRAME,
+    STAGE_PREVIEW_DQBUF,
+    STAGE_WINDOW_DEQUEUE,
+    STAGE_GRALLOC_LOCK,
+    STAGE_PLANE_COPY,
+    STAGE_WINDOW_ENQUEUE,
+    STAGE_NV21_CONVERT,
+    STAGE_CALLBACK_SCALE,
+    STAGE_PREVIEW_CALLBACK,
+    STAGE_RECORD_DQBUF,
+    STAGE_RECORD_CALLBACK,
+    STAGE_AUTOFOCUS,
+    STAGE_SNAPSHOT_PREPARE,
+    STAGE_SNAPSHOT_CAPTURE,
+    STAGE_SNAPSHOT_POST,
+    STAGE_THUMBNAIL,
+    STAGE_EXIF,
+    STAGE_ENCODE,
+    STAGE_JPEG_ASSEMBLE,
+    STAGE_JPEG_CALLBACK,
+    STAGE_COUNT
+};
+
+class SecCameraStats {
+public:
+    /* bucket 0 counts durations under 16 us, bucket i under 16 us << i,
+     * the last one everything from 16 us << (BUCKETS - 2) up */
+    enum { BUCKETS = 20 };
+
+    static void     record(SecCameraStage stage, nsecs_t duration);
+    static void     reset(void);
+    static void     dump(String8& result);
+
+    /* records the time from construction to destruction, or to stop() */
+    class Timer {
+    public:
+        Timer(SecCameraStage stage) :
+            mStage(stage), mStart(systemTime(SYSTEM_TIME_MONOTONIC)) {}
+        ~Timer() { stop(); }
+
+        void stop(void)
+        {
+            if (mStart) {
+                record(mStage, systemTime(SYSTEM_TIME_MONOTONIC) - mStart);
+                mStart = 0;
+            }
+        }
+
+    private:
+        SecCameraStage  mStage;
+        nsecs_t         mStart;
+    };
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_CAMERA_SEC_STATS_H
@@ -18,6 +18,8 @@
 
 #include "SecCameraUtils.h"
 #include <stdlib.h>
+#include <string.h>
+#include <cutils/atomic.h>
 
 namespace android {
 
@@ -69,4 +71,126 @@ String8 SecCameraArea::toString8() {
         m_left, m_top, m_right, m_bottom, m_weight);
 }
 
+#define JPEG_MARKER_SOI     0xD8
+#define JPEG_MARKER_EOI     0xD9
+#define JPEG_MARKER_SOS     0xDA
+#define JPEG_MARKER_APP1    0xE1
+#define JPEG_MARKER_TEM     0x01
+#define JPEG_MARKER_RST0    0xD0
+#define JPEG_MARKER_RST7    0xD7
+
+/*
+ * Skip the entropy-coded data of a scan.  Inside it 0xFF is only followed
+ * by a stuffed 0x00 or a restart marker, so the first other marker ends
+ * the scan.  Returns the offset of that marker's 0xFF, or size.
+ */
+static size_t skipEntropyData(const uint8_t *buf, size_t pos, size_t size)
+{
+    while (pos + 1 < size) {
+        const uint8_t *ff = (const uint8_t *)memchr(buf + pos, 0xFF, size - pos - 1);
+        if (!ff)
+            break;
+
+        pos = ff - buf;
+        uint8_t next = buf[pos + 1];
+        if (next != 0x00 && next != 0xFF &&
+            (next < JPEG_MARKER_RST0 || next > JPEG_MARKER_RST7))
+            return pos;
+        /* 0xFF 0xFF is fill, the marker may still follow */
+        pos += (next == 0xFF) ? 1 : 2;
+    }
+
+    return size;
+}
+
+bool parseJpegMarkers(const uint8_t *buf, size_t size, JpegMarkers *markers)
+{
+    markers->soi = markers->app1 = markers->app1Length = -1;
+    markers->sos = markers->eoi = -1;
+
+    if (buf == NULL || size < 4 || buf[0] != 0xFF || buf[1] != JPEG_MARKER_SOI)
+        return false;
+    markers->soi = 0;
+
+    size_t pos = 2;
+    while (pos + 1 < size) {
+        if (buf[pos] != 0xFF)
+            return false;
+        /* any number of fill bytes may precede a marker */
+        while (pos + 1 < size && buf[pos + 1] == 0xFF)
+            pos++;
+        if (pos + 1 >= size)
+            break;
+
+        size_t start = pos;
+        uint8_t marker = buf[pos + 1];
+        pos += 2;
+
+        if (marker == JPEG_MARKER_EOI) {
+            markers->eoi = start;
+            return true;
+        }
+        if (marker == JPEG_MARKER_TEM ||
+            (marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_RST7))
+            continue;
+
+        if (pos + 2 > size)
+            break;
+        size_t length = (buf[pos] << 8) | buf[pos + 1];
+        if (length < 2 || pos + length > size)
+            break;
+
+        if (marker == JPEG_MARKER_APP1 && markers->app1 < 0 &&
+            length >= 8 && !memcmp(buf + pos + 2, "Exif\0\0", 6)) {
+            markers->app1 = start;
+            markers->app1Length = length + 2;
+        }
+
+        pos += length;
+        if (marker == JPEG_MARKER_SOS) {
+            if (markers->sos < 0)
+                markers->sos = start;
+            pos = skipEntropyData(buf, pos, size);
+        }
+    }
+
+    return false;
+}
+
+RecordReturnRing::RecordReturnRing()
+{
+    reset();
+}
+
+/* only while neither side is running */
+void RecordReturnRing::reset()
+{
+    mHead = 0;
+    mTail = 0;
+}
+
+bool RecordReturnRing::push(int index)
+{
+    uint32_t head = mHead;
+
+    if (head - (uint32_t)android_atomic_acquire_load(&mTail) >= SIZE)
+        return false;
+
+    mSlots[head % SIZE] = index;
+    android_atomic_release_store(head + 1, &mHead);
+    return true;
+}
+
+int RecordReturnRing::pop()
+{
+    uint32_t tail = mTail;
+
+    if (tail == (uint32_t)android_atomic_acquire_load(&mHead))
+        return -1;
+
+    int index = mSlots[tail % SIZE];
+    android_atomic_release_store(tail + 1, &mTail);
+    return index;
+}
+
 }
\ No newline at end of file
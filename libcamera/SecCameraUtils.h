@@ -19,6 +19,8 @@
 #ifndef ANDROID_HARDWARE_CAMERA_SEC_UTILS_H
 #define ANDROID_HARDWARE_CAMERA_SEC_UTILS_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <utils/String8.h>
 
 namespace android {
@@ -39,6 +41,47 @@ struct SecCameraArea {
     String8 toString8();
 };
 
+/*
+ * Offsets of the markers of interest in a baseline or progressive JPEG
+ * stream, -1 where a marker is absent.  app1 is the first APP1 segment
+ * carrying EXIF, app1Length its size including the marker.  sos is the
+ * first scan; eoi + 2 is the real end of the stream, anything after it
+ * is padding.
+ */
+struct JpegMarkers {
+    int soi;
+    int app1;
+    int app1Length;
+    int sos;
+    int eoi;
+};
+
+/*
+ * Walk the marker segments of a JPEG in one pass, skipping over table and
+ * APPn segments by their length and searching the entropy-coded data with
+ * memchr().  Returns false if the stream is truncated or malformed before
+ * EOI.
+ */
+bool parseJpegMarkers(const uint8_t *buf, size_t size, JpegMarkers *markers);
+
+/*
+ * Record buffer indices handed back by releaseRecordingFrame(), for
+ * previewThread() to requeue.  Lock free for one producer and one
+ * consumer at a time.
+ */
+class RecordReturnRing {
+public:
+    RecordReturnRing();
+    void                reset();
+    bool                push(int index);
+    int                 pop();
+private:
+    enum { SIZE = 16 };
+    int                 mSlots[SIZE];
+    volatile int32_t    mHead;      /* only written by push() */
+    volatile int32_t    mTail;      /* only written by pop() */
+};
+
 }; // namespace android
 
 #endif // ANDROID_HARDWARE_CAMERA_SEC_UTILS_H
\ No newline at end of file
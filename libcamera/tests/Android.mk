@@ -0,0 +1,123 @@
+# Host unit tests for the pure helpers of the camera HAL, the parts that
+# don't need the FIMC or the JPEG block.  The EXIF template is checked
+# against makeExif() from libs3cjpeg, which only formats memory, and the
+# parameter tables need the CameraParameters strings, built from source
+# since libcamera_client isn't built for the host.  Run with
+#   mmm device/samsung/aries-common/libcamera/tests
+#   $ANDROID_HOST_OUT/nativetest/camera.aries_tests/camera.aries_tests
+#
+# camera.aries_bench runs SecCamera itself on SecCameraFakeDevice and
+# prints preview throughput and shot-to-shot times, see its -h.
+# camera.aries_params_bench times CameraHardwareSec::setParameters() on the
+# fake as well, on the device since the HAL class needs libbinder:
+#   adb shell /system/bin/camera.aries_params_bench
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+# libs3cjpeg and CameraParameters, relative to the top of the tree
+S3CJPEG_PATH := hardware/samsung/exynos3/s5pc110/libs3cjpeg
+CAMERA_CLIENT_PATH := frameworks/av/camera
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_C_INCLUDES += hardware/samsung/exynos3/s5pc110/include
+LOCAL_C_INCLUDES += $(S3CJPEG_PATH)
+
+LOCAL_CFLAGS := \
+	-Wno-missing-field-initializers \
+	-Wno-unused-parameter
+
+LOCAL_SRC_FILES:= \
+	SecCameraColorConvert_test.cpp \
+	SecCameraExif_test.cpp \
+	SecCameraParams_test.cpp \
+	SecCameraUtils_test.cpp \
+	../SecCameraColorConvert.cpp \
+	../SecCameraExif.cpp \
+	../SecCameraParams.cpp \
+	../SecCameraUtils.cpp \
+	../../../../../$(S3CJPEG_PATH)/JpegEncoder.cpp \
+	../../../../../$(CAMERA_CLIENT_PATH)/CameraParameters.cpp \
+
+LOCAL_STATIC_LIBRARIES:= libutils libcutils liblog
+
+LOCAL_MODULE := camera.aries_tests
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_C_INCLUDES += hardware/samsung/exynos3/s5pc110/include
+LOCAL_C_INCLUDES += $(S3CJPEG_PATH)
+
+LOCAL_CFLAGS := \
+	-Wno-missing-field-initializers \
+	-Wno-unused-parameter
+
+LOCAL_SRC_FILES:= \
+	SecCameraBench.cpp \
+	../SecCamera.cpp \
+	../SecCameraDevice.cpp \
+	../SecCameraExif.cpp \
+	../SecCameraFakeDevice.cpp \
+	../SecCameraStats.cpp \
+	../SecCameraUtils.cpp \
+	../../../../../$(S3CJPEG_PATH)/JpegEncoder.cpp \
+
+LOCAL_STATIC_LIBRARIES:= libutils libcutils liblog
+
+LOCAL_MODULE := camera.aries_bench
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_C_INCLUDES += hardware/samsung/exynos3/s5pc110/include
+LOCAL_C_INCLUDES += $(S3CJPEG_PATH)
+LOCAL_C_INCLUDES += frameworks/native/include/media/hardware
+LOCAL_C_INCLUDES += system/media/camera/include
+
+LOCAL_CFLAGS := \
+	-Wno-missing-field-initializers \
+	-Wno-unused-parameter \
+	-Wno-extra
+
+ifdef BOARD_SECOND_CAMERA_DEVICE
+    LOCAL_CFLAGS += -DFFC_PRESENT
+endif
+
+ifdef BOARD_CAMERA_HAVE_FLASH
+    LOCAL_CFLAGS += -DHAVE_FLASH
+endif
+
+ifdef BOARD_CAMERA_FFC_FLIPPED
+    LOCAL_CFLAGS += -DFFC_FLIPPED
+endif
+
+LOCAL_SRC_FILES:= \
+	SecCameraParamsBench.cpp \
+	../SecCamera.cpp \
+	../SecCameraColorConvert.cpp \
+	../SecCameraDevice.cpp \
+	../SecCameraDumpWriter.cpp \
+	../SecCameraExif.cpp \
+	../SecCameraFakeDevice.cpp \
+	../SecCameraHWInterface.cpp \
+	../SecCameraParams.cpp \
+	../SecCameraStats.cpp \
+	../SecCameraUtils.cpp \
+
+LOCAL_SHARED_LIBRARIES:= libutils libcutils libbinder liblog libcamera_client libhardware
+LOCAL_SHARED_LIBRARIES+= libs3cjpeg
+
+LOCAL_MODULE := camera.aries_params_bench
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
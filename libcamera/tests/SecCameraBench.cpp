@@ -0,0 +1,270 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Preview throughput and shot-to-shot latency of SecCamera on the fake
+ * FIMC, to compare changes to the capture path on a workstation.  The
+ * sensor timing comes from the options, so the numbers show what the HAL
+ * adds on top of it.
+ */
+
+#include "SecCamera.h"
+#include "SecCameraFakeDevice.h"
+#include "SecCameraStats.h"
+#include "SecCameraUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace android;
+
+#define PREVIEW_WIDTH   640
+#define PREVIEW_HEIGHT  480
+
+struct BenchTimes {
+    nsecs_t         min;
+    nsecs_t         max;
+    nsecs_t         total;
+    unsigned int    count;
+};
+
+static void addTime(BenchTimes *times, nsecs_t t)
+{
+    if (!times->count || t < times->min)
+        times->min = t;
+    if (!times->count || t > times->max)
+        times->max = t;
+    times->total += t;
+    times->count++;
+}
+
+static void printTimes(const char *name, const BenchTimes *times)
+{
+    if (!times->count)
+        return;
+    printf("%-20s %6u  min %8.2f  avg %8.2f  max %8.2f ms\n", name, times->count,
+           times->min / 1e6, times->total / 1e6 / times->count, times->max / 1e6);
+}
+
+/* frames through getPreview(), optionally into user pointers */
+static int benchPreview(SecCamera *camera, int frames, bool userptr, int stallMs)
+{
+    size_t frameSize = PREVIEW_WIDTH * PREVIEW_HEIGHT * 3 / 2;
+    unsigned char *buffers[MAX_BUFFERS] = { NULL };
+    BenchTimes intervals;
+    int ret = -1;
+
+    memset(&intervals, 0, sizeof(intervals));
+
+    if (userptr) {
+        for (int i = 0; i < MAX_BUFFERS; i++) {
+            buffers[i] = (unsigned char *)malloc(frameSize);
+            if (buffers[i] == NULL ||
+                camera->setPreviewUserPtr(i, (unsigned long)buffers[i], frameSize) < 0)
+                goto out;
+        }
+    }
+
+    {
+        unsigned int delivered = SecCameraFakeDevice::delivered();
+        unsigned int dropped = SecCameraFakeDevice::dropped();
+        unsigned int resets = SecCameraFakeDevice::resets();
+        nsecs_t start = 0, last = 0;
+
+        if (camera->startPreview() < 0) {
+            fprintf(stderr, "startPreview() failed\n");
+            goto out;
+        }
+
+        /* intervals from the first frame on, startPreview() waited for it */
+        for (int i = 0; i < frames; i++) {
+            if (stallMs && i == frames / 2)
+                SecCameraFakeDevice::stall(ms2ns(stallMs));
+
+            int index = camera->getPreview();
+            if (index < 0) {
+                fprintf(stderr, "getPreview() failed at frame %d\n", i);
+                camera->stopPreview();
+                goto out;
+            }
+            if (userptr)
+                camera->releasePreviewFrame(index);
+
+            nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+            if (i)
+                addTime(&intervals, now - last);
+            else
+                start = now;
+            last = now;
+        }
+
+        nsecs_t elapsed = last - start;
+        camera->stopPreview();
+
+        printf("preview %dx%d%s: %d frames in %.2f s, %.2f fps, "
+               "%u dropped, %u sensor resets\n",
+               PREVIEW_WIDTH, PREVIEW_HEIGHT, userptr ? " (user pointers)" : "",
+               frames, elapsed / 1e9, elapsed ? (frames - 1) * 1e9 / elapsed : 0,
+               SecCameraFakeDevice::dropped() - dropped,
+               SecCameraFakeDevice::resets() - resets);
+        printf("  sensor delivered %u\n", SecCameraFakeDevice::delivered() - delivered);
+        printTimes("frame interval", &intervals);
+    }
+    ret = 0;
+
+out:
+    if (userptr)
+        camera->clearPreviewUserPtrs();
+    for (int i = 0; i < MAX_BUFFERS; i++)
+        free(buffers[i]);
+    return ret;
+}
+
+/* preview running, then for every shot: capture, EXIF, and back to the
+ * first preview frame, as takePicture() followed by startPreview() */
+static int benchShots(SecCamera *camera, int shots)
+{
+    unsigned char *exif = (unsigned char *)malloc(EXIF_MAX_BUILD_SIZE);
+    BenchTimes capture, total;
+    int ret = -1;
+
+    memset(&capture, 0, sizeof(capture));
+    memset(&total, 0, sizeof(total));
+
+    if (exif == NULL || camera->startPreview() < 0 || camera->getPreview() < 0) {
+        fprintf(stderr, "preview didn't start\n");
+        goto out;
+    }
+
+    for (int i = 0; i < shots; i++) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        exif_attribute_t exifInfo;
+        JpegMarkers markers;
+        unsigned int phyaddr;
+        int size;
+
+        camera->stopPreview();
+        if (camera->setSnapshotCmd() < 0) {
+            fprintf(stderr, "setSnapshotCmd() failed at shot %d\n", i);
+            goto out;
+        }
+
+        unsigned char *jpeg = camera->getJpeg(&size, &phyaddr);
+        if (jpeg == NULL || !parseJpegMarkers(jpeg, size, &markers)) {
+            fprintf(stderr, "no JPEG at shot %d\n", i);
+            camera->endSnapshot();
+            goto out;
+        }
+        addTime(&capture, systemTime(SYSTEM_TIME_MONOTONIC) - start);
+
+        camera->getExifInfo(&exifInfo);
+        camera->getExif(exif, EXIF_MAX_BUILD_SIZE, NULL, 0, 0, &exifInfo);
+        camera->endSnapshot();
+
+        if (camera->startPreview() < 0 || camera->getPreview() < 0) {
+            fprintf(stderr, "preview didn't restart after shot %d\n", i);
+            goto out;
+        }
+        addTime(&total, systemTime(SYSTEM_TIME_MONOTONIC) - start);
+    }
+
+    int width, height, frameSize;
+    camera->getSnapshotSize(&width, &height, &frameSize);
+    printf("shots %dx%d:\n", width, height);
+    printTimes("capture to JPEG", &capture);
+    printTimes("shot to shot", &total);
+    ret = 0;
+
+out:
+    camera->stopPreview();
+    free(exif);
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-f fps] [-j jitter_us] [-d capture_delay_ms] [-z jpeg_size]\n"
+            "       %*s [-n preview_frames] [-s shots] [-e esd_interval] [-t stall_ms] [-u]\n"
+            "  -e  the sensor hangs every esd_interval preview frames\n"
+            "  -t  the sensor stalls once halfway through the preview run\n"
+            "  -u  preview into user pointers instead of mmap'ed buffers\n",
+            name, (int)strlen(name), "");
+}
+
+int main(int argc, char **argv)
+{
+    SecCameraFakeDevice::Config config;
+    int frames = 300, shots = 10, stallMs = 0;
+    bool userptr = false;
+    int opt;
+
+    SecCameraFakeDevice::defaultConfig(&config);
+
+    while ((opt = getopt(argc, argv, "f:j:d:z:n:s:e:t:u")) != -1) {
+        switch (opt) {
+        case 'f': config.fps = atoi(optarg); break;
+        case 'j': config.jitterUs = atoi(optarg); break;
+        case 'd': config.captureDelayMs = atoi(optarg); break;
+        case 'z': config.jpegSize = atoi(optarg); break;
+        case 'n': frames = atoi(optarg); break;
+        case 's': shots = atoi(optarg); break;
+        case 'e': config.esdInterval = atoi(optarg); break;
+        case 't': stallMs = atoi(optarg); break;
+        case 'u': userptr = true; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    SecCameraFakeDevice::install(config);
+
+    SecCamera *camera = SecCamera::createInstance();
+    if (camera->initCamera(SecCamera::CAMERA_ID_BACK) < 0) {
+        fprintf(stderr, "initCamera() failed\n");
+        return 1;
+    }
+
+    int snapshotWidth, snapshotHeight;
+    camera->getSnapshotMaxSize(&snapshotWidth, &snapshotHeight);
+    camera->setPreviewSize(PREVIEW_WIDTH, PREVIEW_HEIGHT, V4L2_PIX_FMT_NV21);
+    camera->setSnapshotSize(snapshotWidth, snapshotHeight);
+    camera->setSnapshotPixelFormat(V4L2_PIX_FMT_YUYV);
+    /* the thumbnail needs the JPEG block */
+    camera->setJpegThumbnailSize(0, 0);
+
+    SecCameraStats::reset();
+
+    int ret = 0;
+    if (frames > 0 && benchPreview(camera, frames, userptr, stallMs) < 0)
+        ret = 1;
+    if (shots > 0 && benchShots(camera, shots) < 0)
+        ret = 1;
+
+    camera->DeinitCamera();
+    SecCameraFakeDevice::uninstall();
+
+    String8 result;
+    SecCameraFakeDevice::dump(result);
+    SecCameraStats::dump(result);
+    printf("\n%s", result.string());
+
+    return ret;
+}
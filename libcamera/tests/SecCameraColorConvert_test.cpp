@@ -0,0 +1,315 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * The converters against plain per-sample loops.  On the host only the
+ * generic kernels run; the NEON ones take the same paths for the tails,
+ * so the odd sizes below cover both of their edges.
+ */
+
+#include "SecCameraColorConvert.h"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace android {
+
+static void fillRandom(std::vector<uint8_t>& buf, unsigned int seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < buf.size(); i++)
+        buf[i] = rand() & 0xff;
+}
+
+static int yv12ChromaStride(int stride)
+{
+    return ((stride / 2) + 15) & ~15;
+}
+
+/* sizes the preview runs at, plus odd ones for the row tails */
+static const struct { int width, height; } kSizes[] = {
+    { 640, 480 }, { 720, 480 }, { 176, 144 }, { 1280, 720 },
+    { 33, 17 }, { 65, 3 }, { 2, 2 }, { 1, 1 },
+};
+
+// ======================================================================
+// Plane copy
+
+TEST(SecCameraColorConvert, CopyPlaneHonoursStrides)
+{
+    const int width = 37, height = 11, srcStride = 48, dstStride = 64;
+    std::vector<uint8_t> src(srcStride * height), dst(dstStride * height, 0xAA);
+    fillRandom(src, 1);
+
+    copyPlane(&dst[0], dstStride, &src[0], srcStride, width, height);
+
+    for (int y = 0; y < height; y++) {
+        EXPECT_EQ(0, memcmp(&dst[y * dstStride], &src[y * srcStride], width)) << "row " << y;
+        /* the padding is left alone */
+        for (int x = width; x < dstStride; x++)
+            ASSERT_EQ(0xAA, dst[y * dstStride + x]);
+    }
+}
+
+TEST(SecCameraColorConvert, Yuv420ToYv12AndBack)
+{
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        const int width = kSizes[i].width, height = kSizes[i].height;
+        const int cwidth = (width + 1) / 2, cheight = (height + 1) / 2;
+        const int frameSize = width * height + 2 * cwidth * cheight;
+
+        /* gralloc strides are 16 aligned, try the tightest and a padded one */
+        for (int pad = 0; pad <= 32; pad += 32) {
+            const int stride = ((width + 15) & ~15) + pad;
+            const int cstride = yv12ChromaStride(stride);
+            std::vector<uint8_t> src(frameSize);
+            std::vector<uint8_t> yv12(stride * height + 2 * cstride * cheight);
+            std::vector<uint8_t> back(frameSize);
+            fillRandom(src, i);
+
+            copyYuv420ToYv12(&yv12[0], stride, &src[0], width, height);
+
+            const uint8_t *u = &src[width * height];
+            const uint8_t *v = u + cwidth * cheight;
+            const uint8_t *dv = &yv12[stride * height];
+            const uint8_t *du = dv + cstride * cheight;
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                    ASSERT_EQ(src[y * width + x], yv12[y * stride + x])
+                        << width << "x" << height << " luma " << x << "," << y;
+            for (int y = 0; y < cheight; y++) {
+                for (int x = 0; x < cwidth; x++) {
+                    ASSERT_EQ(u[y * cwidth + x], du[y * cstride + x])
+                        << width << "x" << height << " U " << x << "," << y;
+                    ASSERT_EQ(v[y * cwidth + x], dv[y * cstride + x])
+                        << width << "x" << height << " V " << x << "," << y;
+                }
+            }
+
+            copyYv12ToYuv420(&back[0], &yv12[0], stride, width, height);
+            EXPECT_EQ(0, memcmp(&src[0], &back[0], frameSize))
+                << width << "x" << height << " stride " << stride;
+        }
+    }
+}
+
+// ======================================================================
+// Planar to semi-planar
+
+TEST(SecCameraColorConvert, InterleaveChroma)
+{
+    /* around the 16 and 32 sample NEON blocks */
+    static const int kCounts[] = { 1, 15, 16, 17, 31, 32, 33, 100, 4800 };
+
+    for (size_t i = 0; i < sizeof(kCounts) / sizeof(kCounts[0]); i++) {
+        const int count = kCounts[i];
+        std::vector<uint8_t> first(count), second(count), dst(2 * count + 1, 0xAA);
+        fillRandom(first, 2 * i);
+        fillRandom(second, 2 * i + 1);
+
+        interleaveChroma(&dst[0], &first[0], &second[0], count);
+
+        for (int k = 0; k < count; k++) {
+            ASSERT_EQ(first[k], dst[2 * k]) << "count " << count << " sample " << k;
+            ASSERT_EQ(second[k], dst[2 * k + 1]) << "count " << count << " sample " << k;
+        }
+        EXPECT_EQ(0xAA, dst[2 * count]) << "count " << count;
+    }
+}
+
+TEST(SecCameraColorConvert, Yuv420ToNv21InPlace)
+{
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        const int width = kSizes[i].width, height = kSizes[i].height;
+        const int csize = ((width + 1) / 2) * ((height + 1) / 2);
+        const int lumaSize = width * height;
+        std::vector<uint8_t> src(lumaSize + 2 * csize);
+        fillRandom(src, 100 + i);
+        std::vector<uint8_t> frame(src);
+        std::vector<uint8_t> scratch(nv21ScratchSize(width, height));
+
+        yuv420ToNv21InPlace(&frame[0], width, height, &scratch[0]);
+
+        EXPECT_EQ(0, memcmp(&src[0], &frame[0], lumaSize)) << width << "x" << height;
+        const uint8_t *u = &src[lumaSize];
+        const uint8_t *v = u + csize;
+        const uint8_t *vu = &frame[lumaSize];
+        for (int k = 0; k < csize; k++) {
+            ASSERT_EQ(v[k], vu[2 * k]) << width << "x" << height << " sample " << k;
+            ASSERT_EQ(u[k], vu[2 * k + 1]) << width << "x" << height << " sample " << k;
+        }
+    }
+}
+
+// ======================================================================
+// YUYV to NV21 and the thumbnail downscale
+
+TEST(SecCameraColorConvert, YuyvToNv21)
+{
+    /* the front camera's captures, and widths off the 32 pixel blocks */
+    static const struct { int width, height; } kYuyvSizes[] = {
+        { 640, 480 }, { 320, 240 }, { 34, 6 }, { 66, 2 }, { 2, 2 },
+    };
+
+    for (size_t i = 0; i < sizeof(kYuyvSizes) / sizeof(kYuyvSizes[0]); i++) {
+        const int width = kYuyvSizes[i].width, height = kYuyvSizes[i].height;
+        std::vector<uint8_t> src(width * height * 2);
+        std::vector<uint8_t> dst(width * height * 3 / 2);
+        fillRandom(src, 200 + i);
+
+        yuyvToNv21(&dst[0], &src[0], width, height);
+
+        for (int y = 0; y < height; y++) {
+            const uint8_t *row = &src[y * width * 2];
+            for (int x = 0; x < width; x++)
+                ASSERT_EQ(row[2 * x], dst[y * width + x])
+                    << width << "x" << height << " luma " << x << "," << y;
+            /* chroma comes from the even rows */
+            if (y & 1)
+                continue;
+            const uint8_t *vu = &dst[width * height + (y / 2) * width];
+            for (int x = 0; x < width; x += 2) {
+                ASSERT_EQ(row[2 * x + 3], vu[x]) << width << "x" << height << " V " << x << "," << y;
+                ASSERT_EQ(row[2 * x + 1], vu[x + 1]) << width << "x" << height << " U " << x << "," << y;
+            }
+        }
+    }
+}
+
+/* one YUYV sample averaged over its box, rounded to nearest */
+static uint8_t boxAverage(const std::vector<uint8_t>& src, int srcWidth,
+                          int x0, int y0, int stepX, int stepY, int offset, int pitch)
+{
+    unsigned int sum = 0, count = 0;
+
+    for (int y = y0; y < y0 + stepY; y++) {
+        for (int k = 0; k < stepX; k++) {
+            sum += src[y * srcWidth * 2 + x0 * 2 + k * pitch + offset];
+            count++;
+        }
+    }
+    return (sum + count / 2) / count;
+}
+
+TEST(SecCameraColorConvert, ScaleDownYuv422)
+{
+    static const struct { int srcWidth, srcHeight, dstWidth, dstHeight; } kScales[] = {
+        { 640, 480, 160, 120 },     /* front camera thumbnail */
+        { 640, 480, 640, 480 },     /* 1:1 */
+        { 644, 483, 160, 120 },     /* remainders dropped */
+        { 96, 64, 32, 16 },         /* unequal ratios */
+    };
+
+    for (size_t i = 0; i < sizeof(kScales) / sizeof(kScales[0]); i++) {
+        const int srcWidth = kScales[i].srcWidth, srcHeight = kScales[i].srcHeight;
+        const int dstWidth = kScales[i].dstWidth, dstHeight = kScales[i].dstHeight;
+        const int stepX = srcWidth / dstWidth, stepY = srcHeight / dstHeight;
+        std::vector<uint8_t> src(srcWidth * srcHeight * 2);
+        std::vector<uint8_t> dst(dstWidth * dstHeight * 2);
+        fillRandom(src, 300 + i);
+
+        ASSERT_TRUE(scaleDownYuv422(&dst[0], dstWidth, dstHeight,
+                                    &src[0], srcWidth, srcHeight));
+
+        for (int y = 0; y < dstHeight; y++) {
+            for (int x = 0; x < dstWidth; x += 2) {
+                const uint8_t *out = &dst[(y * dstWidth + x) * 2];
+                const int sx = x * stepX, sy = y * stepY;
+                /* luma over stepX pixels, chroma over stepX pixel pairs */
+                ASSERT_EQ(boxAverage(src, srcWidth, sx, sy, stepX, stepY, 0, 2), out[0]);
+                ASSERT_EQ(boxAverage(src, srcWidth, sx, sy, stepX, stepY, 1, 4), out[1]);
+                ASSERT_EQ(boxAverage(src, srcWidth, sx + stepX, sy, stepX, stepY, 0, 2), out[2]);
+                ASSERT_EQ(boxAverage(src, srcWidth, sx, sy, stepX, stepY, 3, 4), out[3]);
+            }
+        }
+    }
+}
+
+TEST(SecCameraColorConvert, ScaleDownYuv422RejectsBadSizes)
+{
+    std::vector<uint8_t> src(64 * 64 * 2), dst(64 * 64 * 2);
+
+    EXPECT_FALSE(scaleDownYuv422(&dst[0], 31, 16, &src[0], 64, 64));   /* odd width */
+    EXPECT_FALSE(scaleDownYuv422(&dst[0], 32, 0, &src[0], 64, 64));
+    EXPECT_FALSE(scaleDownYuv422(&dst[0], 64, 32, &src[0], 32, 64));   /* upscale */
+}
+
+// ======================================================================
+// NV12T to YUYV
+
+struct TilePos { int x, y; };
+
+/* lays plane out in 64x32 tiles, the n-th tile stored being order[n] */
+static void tilePlane(std::vector<uint8_t>& tiled, const std::vector<uint8_t>& plane,
+                      int width, int height, const TilePos *order, int count)
+{
+    tiled.assign(count * 64 * 32, 0);
+    for (int t = 0; t < count; t++) {
+        for (int r = 0; r < 32; r++) {
+            int y = order[t].y * 32 + r;
+            if (y >= height)
+                continue;
+            memcpy(&tiled[t * 64 * 32 + r * 64], &plane[y * width + order[t].x * 64], 64);
+        }
+    }
+}
+
+TEST(SecCameraColorConvert, Nv12tToYuyv)
+{
+    /* 256x96: two 2x2 blocks, the second one's Z flipped, then the odd
+     * last row of tiles in order */
+    static const TilePos kLumaOrder[] = {
+        { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 },
+        { 2, 1 }, { 3, 1 }, { 2, 0 }, { 3, 0 },
+        { 0, 2 }, { 1, 2 }, { 2, 2 }, { 3, 2 },
+    };
+    /* its 256x48 chroma plane: the same two blocks, the second row of
+     * tiles cut short */
+    static const TilePos kChromaOrder[] = {
+        { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 },
+        { 2, 1 }, { 3, 1 }, { 2, 0 }, { 3, 0 },
+    };
+    const int width = 256, height = 96;
+
+    std::vector<uint8_t> luma(width * height), chroma(width * height / 2);
+    std::vector<uint8_t> tiledLuma, tiledChroma;
+    std::vector<uint8_t> dst(width * height * 2);
+    fillRandom(luma, 300);
+    fillRandom(chroma, 301);
+
+    tilePlane(tiledLuma, luma, width, height, kLumaOrder, 12);
+    tilePlane(tiledChroma, chroma, width, height / 2, kChromaOrder, 8);
+    EXPECT_EQ(tiledLuma.size(), nv12tPlaneSize(width, height));
+    EXPECT_EQ(tiledChroma.size(), nv12tPlaneSize(width, height / 2));
+
+    nv12tToYuyv(&dst[0], &tiledLuma[0], &tiledChroma[0], width, height);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = &dst[y * width * 2];
+        const uint8_t *cbcr = &chroma[(y / 2) * width];
+        for (int x = 0; x < width; x++)
+            ASSERT_EQ(luma[y * width + x], row[2 * x]) << "luma " << x << "," << y;
+        for (int x = 0; x < width; x += 2) {
+            ASSERT_EQ(cbcr[x], row[2 * x + 1]) << "U " << x << "," << y;
+            ASSERT_EQ(cbcr[x + 1], row[2 * x + 3]) << "V " << x << "," << y;
+        }
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,239 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraExif.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+/*
+ * makeExif() takes the thumbnail from the JPEG block's output buffer, which
+ * doesn't exist on the host, so these shots leave the thumbnail out; the
+ * layouts with GPS and the lengths of the processing method still go
+ * through the same patch table.
+ */
+
+#define EXIF_BUF_SIZE   4096
+
+static unsigned int pick(unsigned int n)
+{
+    return (unsigned int)rand() % n;
+}
+
+/* the attributes setExifFixedAttribute() fills once per sensor */
+static void fixedAttributes(exif_attribute_t *exif)
+{
+    memset(exif, 0, sizeof(*exif));
+
+    strcpy((char *)exif->maker, "samsung");
+    strcpy((char *)exif->model, "GT-I9000");
+    strcpy((char *)exif->software, "LMY49J");
+    exif->ycbcr_positioning = 1;
+    exif->fnumber.num = 26;
+    exif->fnumber.den = 10;
+    exif->exposure_program = 3;
+    memcpy(exif->exif_version, "0220", 4);
+    exif->aperture.num = 276;
+    exif->aperture.den = 100;
+    exif->max_aperture = exif->aperture;
+    exif->focal_length.num = 343;
+    exif->focal_length.den = 100;
+    strcpy((char *)exif->user_comment, "User comments");
+    exif->color_space = 1;
+    exif->exposure_mode = 0;
+    exif->gps_version_id[0] = 0x02;
+    exif->gps_version_id[1] = 0x02;
+    exif->compression_scheme = 6;
+    exif->x_resolution.num = 72;
+    exif->x_resolution.den = 1;
+    exif->y_resolution = exif->x_resolution;
+    exif->resolution_unit = 2;
+}
+
+/* the attributes setExifChangedAttribute() fills for every shot */
+static void shotAttributes(exif_attribute_t *exif, bool gps, int methodLength)
+{
+    exif->width = 320 + pick(2240);
+    exif->height = 240 + pick(1680);
+    exif->orientation = 1 + pick(8);
+    snprintf((char *)exif->date_time, sizeof(exif->date_time),
+             "2026:%02u:%02u %02u:%02u:%02u", 1 + pick(12), 1 + pick(28),
+             pick(24), pick(60), pick(60));
+    exif->exposure_time.num = 1;
+    exif->exposure_time.den = 1 + pick(4000);
+    exif->iso_speed_rating = 50 << pick(5);
+    exif->shutter_speed.num = (int)pick(2000) - 1000;
+    exif->shutter_speed.den = 100;
+    exif->brightness.num = (int)pick(2000) - 1000;
+    exif->brightness.den = 100;
+    exif->exposure_bias.num = (int)pick(9) - 4;
+    exif->exposure_bias.den = 1;
+    exif->metering_mode = pick(3);
+    exif->flash = pick(2);
+    exif->white_balance = pick(2);
+    exif->scene_capture_type = pick(4);
+    exif->enableThumb = false;
+
+    exif->enableGps = gps;
+    if (!gps)
+        return;
+
+    strcpy((char *)exif->gps_latitude_ref, pick(2) ? "N" : "S");
+    strcpy((char *)exif->gps_longitude_ref, pick(2) ? "E" : "W");
+    for (int i = 0; i < 3; i++) {
+        exif->gps_latitude[i].num = pick(60);
+        exif->gps_latitude[i].den = 1;
+        exif->gps_longitude[i].num = pick(60);
+        exif->gps_longitude[i].den = 1;
+        exif->gps_timestamp[i].num = pick(60);
+        exif->gps_timestamp[i].den = 1;
+    }
+    exif->gps_altitude_ref = pick(2);
+    exif->gps_altitude.num = pick(9000);
+    exif->gps_altitude.den = 1;
+    snprintf((char *)exif->gps_datestamp, sizeof(exif->gps_datestamp),
+             "2026:%02u:%02u", 1 + pick(12), 1 + pick(28));
+
+    memset(exif->gps_processing_method, 0, sizeof(exif->gps_processing_method));
+    for (int i = 0; i < methodLength; i++)
+        exif->gps_processing_method[i] = 'A' + pick(26);
+}
+
+/* makeExif() rewrites the user comment, so it gets a copy */
+static unsigned int makeExif(JpegEncoder& encoder, unsigned char *out,
+                             const exif_attribute_t *exif)
+{
+    exif_attribute_t copy = *exif;
+    unsigned int size = 0;
+
+    encoder.makeExif(out, &copy, &size, true);
+    return size;
+}
+
+TEST(SecCameraExifTest, MakeMatchesMakeExif)
+{
+    static const struct {
+        bool    gps;
+        int     methodLength;
+    } kLayouts[] = {
+        { false, 0 },
+        { true, 0 },
+        { true, 3 },
+        { true, 32 },
+        { true, sizeof(((exif_attribute_t *)0)->gps_processing_method) },
+    };
+
+    JpegEncoder encoder;
+    exif_attribute_t exif;
+    unsigned char ref[EXIF_BUF_SIZE];
+    unsigned char out[EXIF_BUF_SIZE];
+
+    srand(1);
+    fixedAttributes(&exif);
+
+    for (size_t l = 0; l < sizeof(kLayouts) / sizeof(kLayouts[0]); l++) {
+        SecCameraExifTemplate exifTemplate;
+
+        shotAttributes(&exif, kLayouts[l].gps, kLayouts[l].methodLength);
+        EXPECT_FALSE(exifTemplate.matches(&exif, false));
+
+        unsigned int size = makeExif(encoder, ref, &exif);
+        ASSERT_TRUE(exifTemplate.build(ref, size, &exif, false)) << "layout " << l;
+
+        for (int shot = 0; shot < 200; shot++) {
+            shotAttributes(&exif, kLayouts[l].gps, kLayouts[l].methodLength);
+            ASSERT_TRUE(exifTemplate.matches(&exif, false));
+
+            size = makeExif(encoder, ref, &exif);
+            memset(out, 0xa5, sizeof(out));
+            ASSERT_EQ(size, exifTemplate.size(0)) << "layout " << l << " shot " << shot;
+            ASSERT_EQ(size, exifTemplate.make(out, &exif, NULL, 0))
+                << "layout " << l << " shot " << shot;
+
+            unsigned int i = 0;
+            while (i < size && out[i] == ref[i])
+                i++;
+            ASSERT_EQ(size, i) << "layout " << l << " shot " << shot
+                               << " differs at byte " << i;
+        }
+    }
+}
+
+TEST(SecCameraExifTest, OtherLayoutsDontMatch)
+{
+    JpegEncoder encoder;
+    SecCameraExifTemplate exifTemplate;
+    exif_attribute_t exif;
+    unsigned char ref[EXIF_BUF_SIZE];
+
+    srand(2);
+    fixedAttributes(&exif);
+    shotAttributes(&exif, true, 8);
+    unsigned int size = makeExif(encoder, ref, &exif);
+    ASSERT_TRUE(exifTemplate.build(ref, size, &exif, false));
+    EXPECT_TRUE(exifTemplate.matches(&exif, false));
+
+    /* a thumbnail adds the 1st IFD */
+    EXPECT_FALSE(exifTemplate.matches(&exif, true));
+
+    /* another length of the processing method moves everything after it */
+    shotAttributes(&exif, true, 9);
+    EXPECT_FALSE(exifTemplate.matches(&exif, false));
+    shotAttributes(&exif, true, 0);
+    EXPECT_FALSE(exifTemplate.matches(&exif, false));
+
+    shotAttributes(&exif, false, 0);
+    EXPECT_FALSE(exifTemplate.matches(&exif, false));
+
+    shotAttributes(&exif, true, 8);
+    EXPECT_TRUE(exifTemplate.matches(&exif, false));
+    exifTemplate.invalidate();
+    EXPECT_FALSE(exifTemplate.matches(&exif, false));
+}
+
+TEST(SecCameraExifTest, RejectsBrokenBlocks)
+{
+    JpegEncoder encoder;
+    SecCameraExifTemplate exifTemplate;
+    exif_attribute_t exif;
+    unsigned char ref[EXIF_BUF_SIZE];
+
+    srand(3);
+    fixedAttributes(&exif);
+    shotAttributes(&exif, true, 8);
+    unsigned int size = makeExif(encoder, ref, &exif);
+
+    /* cut inside the GPS IFD */
+    EXPECT_FALSE(exifTemplate.build(ref, size / 2, &exif, false));
+    EXPECT_FALSE(exifTemplate.matches(&exif, false));
+
+    /* GPS expected but the block has none */
+    shotAttributes(&exif, false, 0);
+    size = makeExif(encoder, ref, &exif);
+    shotAttributes(&exif, true, 8);
+    EXPECT_FALSE(exifTemplate.build(ref, size, &exif, false));
+
+    /* not an APP1 block */
+    memset(ref, 0, sizeof(ref));
+    EXPECT_FALSE(exifTemplate.build(ref, size, &exif, false));
+}
+
+}; // namespace android
@@ -0,0 +1,160 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Per-call cost of CameraHardwareSec::setParameters() on the fake FIMC,
+ * for the patterns apps send: the same parameters again, zoom steps,
+ * touch-AF taps and a scene change.  Every call gets the full parameter
+ * set, as from the framework, and the HAL's own counters show how many of
+ * them reached a SecCamera setter.
+ *
+ * CameraHardwareSec needs libbinder, libhardware and libcamera_client, none
+ * of which are built for the host, so this runs on the device.  The fake
+ * FIMC keeps it off the sensor, the camera service can stay up.
+ */
+
+#include "SecCameraHWInterface.h"
+#include "SecCameraFakeDevice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace android;
+
+typedef void (*ParamsStep)(CameraParameters& params, int i);
+
+static void sameParams(CameraParameters& params, int i)
+{
+}
+
+static void zoomStep(CameraParameters& params, int i)
+{
+    int max = params.getInt(CameraParameters::KEY_MAX_ZOOM);
+    if (max <= 0)
+        return;
+
+    /* up and back down, as a pinch does */
+    int step = i % (2 * max);
+    params.set(CameraParameters::KEY_ZOOM, step <= max ? step : 2 * max - step);
+}
+
+static void touchAF(CameraParameters& params, int i)
+{
+    static const char *areas[] = {
+        "(-200,-200,200,200,1)",
+        "(100,-500,300,-300,1)",
+        "(-700,400,-500,600,1)",
+    };
+
+    params.set(CameraParameters::KEY_FOCUS_AREAS, areas[i % 3]);
+}
+
+static void sceneChange(CameraParameters& params, int i)
+{
+    params.set(CameraParameters::KEY_SCENE_MODE, i & 1 ?
+               CameraParameters::SCENE_MODE_NIGHT : CameraParameters::SCENE_MODE_AUTO);
+}
+
+static const struct {
+    const char  *name;
+    ParamsStep  step;
+} kSteps[] = {
+    { "same parameters", sameParams },
+    { "zoom steps",      zoomStep },
+    { "touch AF",        touchAF },
+    { "scene change",    sceneChange },
+};
+
+static void benchParams(CameraHardwareSec *hw, const char *name, ParamsStep step, int calls)
+{
+    CameraParameters params = hw->getParameters();
+    CameraHardwareSec::ParamStats before = hw->getParamStats();
+    nsecs_t min = 0, max = 0, total = 0;
+    int failed = 0;
+
+    for (int i = 0; i < calls; i++) {
+        step(params, i);
+
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (hw->setParameters(params) != NO_ERROR)
+            failed++;
+        nsecs_t t = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+        if (!i || t < min)
+            min = t;
+        if (!i || t > max)
+            max = t;
+        total += t;
+    }
+
+    CameraHardwareSec::ParamStats after = hw->getParamStats();
+    printf("%-16s %6d  min %8.1f  avg %8.1f  max %8.1f us  unchanged %6u  setters %6u",
+           name, calls, min / 1e3, total / 1e3 / calls, max / 1e3,
+           after.unchanged - before.unchanged, after.dispatched - before.dispatched);
+    if (failed)
+        printf("  failed %d", failed);
+    printf("\n");
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-c camera_id] [-n calls]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    SecCameraFakeDevice::Config config;
+    camera_device_t device;
+    int cameraId = SecCamera::CAMERA_ID_BACK;
+    int calls = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+        switch (opt) {
+        case 'c': cameraId = atoi(optarg); break;
+        case 'n': calls = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (calls <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SecCameraFakeDevice::defaultConfig(&config);
+    SecCameraFakeDevice::install(config);
+
+    memset(&device, 0, sizeof(device));
+    sp<CameraHardwareSec> hw = new CameraHardwareSec(cameraId, &device);
+
+    /* the first call hands everything to SecCamera */
+    hw->setParameters(hw->getParameters());
+
+    printf("camera %d, setParameters() with the preview stopped:\n", cameraId);
+    for (size_t i = 0; i < sizeof(kSteps) / sizeof(kSteps[0]); i++)
+        benchParams(hw.get(), kSteps[i].name, kSteps[i].step, calls);
+
+    hw->release();
+    hw.clear();
+    SecCameraFakeDevice::uninstall();
+
+    return 0;
+}
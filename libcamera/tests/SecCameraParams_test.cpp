@@ -0,0 +1,134 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraParams.h"
+
+#include <camera/CameraParameters.h>
+#include <linux/videodev2.h>
+#include <videodev2_samsung.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+/* every name finds its own entry, so no two entries share a name */
+template <typename T>
+static void expectLookupFindsEveryName(const T *table, const char *tableName)
+{
+    int count = 0;
+
+    for (const T *entry = table; entry->name != NULL; entry++, count++) {
+        EXPECT_EQ(entry, lookupParam(table, entry->name))
+            << tableName << " entry " << count << " \"" << entry->name << "\"";
+    }
+
+    EXPECT_GT(count, 0) << tableName;
+}
+
+/* whether list, comma separated, has item */
+static bool hasItem(const char *list, const char *item)
+{
+    size_t length = strlen(item);
+
+    for (const char *p = list; p != NULL; p = strchr(p, ',')) {
+        if (*p == ',')
+            p++;
+        if (!strncmp(p, item, length) && (p[length] == ',' || p[length] == '\0'))
+            return true;
+    }
+
+    return false;
+}
+
+TEST(SecCameraParamsTest, LookupFindsEveryName)
+{
+    expectLookupFindsEveryName(pictureFormats, "pictureFormats");
+    expectLookupFindsEveryName(isoValues, "isoValues");
+    expectLookupFindsEveryName(whiteBalances, "whiteBalances");
+    expectLookupFindsEveryName(sceneModes, "sceneModes");
+    expectLookupFindsEveryName(focusModes, "focusModes");
+#ifdef HAVE_FLASH
+    expectLookupFindsEveryName(flashModes, "flashModes");
+#endif
+    expectLookupFindsEveryName(imageEffects, "imageEffects");
+    expectLookupFindsEveryName(gammaModes, "gammaModes");
+    expectLookupFindsEveryName(slowAeModes, "slowAeModes");
+}
+
+TEST(SecCameraParamsTest, LookupRejectsUnknownValues)
+{
+    EXPECT_TRUE(lookupParam(isoValues, NULL) == NULL);
+    EXPECT_TRUE(lookupParam(isoValues, "") == NULL);
+    EXPECT_TRUE(lookupParam(isoValues, "ISO3200") == NULL);
+    /* app values are case sensitive */
+    EXPECT_TRUE(lookupParam(isoValues, "Auto") == NULL);
+    /* no prefix matches */
+    EXPECT_TRUE(lookupParam(isoValues, "ISO") == NULL);
+    EXPECT_TRUE(lookupParam(isoValues, "ISO1000") == NULL);
+    EXPECT_TRUE(lookupParam(gammaModes, "of") == NULL);
+}
+
+TEST(SecCameraParamsTest, LookupMapsToSensorValues)
+{
+    const ParamEnum *format = lookupParam(pictureFormats, CameraParameters::PIXEL_FORMAT_JPEG);
+    ASSERT_TRUE(format != NULL);
+    /* the sensor encodes, FIMC delivers it as YUYV */
+    EXPECT_EQ(V4L2_PIX_FMT_YUYV, format->value);
+
+    const ParamEnum *white = lookupParam(whiteBalances, CameraParameters::WHITE_BALANCE_DAYLIGHT);
+    ASSERT_TRUE(white != NULL);
+    EXPECT_EQ(WHITE_BALANCE_SUNNY, white->value);
+
+    const SceneModeParam *beach = lookupParam(sceneModes, CameraParameters::SCENE_MODE_BEACH);
+    const SceneModeParam *snow = lookupParam(sceneModes, CameraParameters::SCENE_MODE_SNOW);
+    ASSERT_TRUE(beach != NULL && snow != NULL);
+    EXPECT_EQ(SCENE_MODE_BEACH_SNOW, beach->value);
+    EXPECT_EQ(beach->value, snow->value);
+
+    const FocusModeParam *face = lookupParam(focusModes, FOCUS_MODE_FACEDETECT);
+    ASSERT_TRUE(face != NULL);
+    EXPECT_EQ(FOCUS_MODE_FACEDETECT_ON, face->value);
+}
+
+TEST(SecCameraParamsTest, SceneModesAllowTheirFlashMode)
+{
+    const SceneModeParam *scene;
+
+    for (scene = sceneModes; scene->name != NULL; scene++) {
+        ASSERT_TRUE(scene->supportedFlashModes != NULL) << scene->name;
+        if (scene->flashMode != NULL) {
+            EXPECT_TRUE(hasItem(scene->supportedFlashModes, scene->flashMode))
+                << scene->name << ": " << scene->flashMode << " not in "
+                << scene->supportedFlashModes;
+        }
+    }
+
+    /* auto leaves the flash to the app */
+    scene = lookupParam(sceneModes, CameraParameters::SCENE_MODE_AUTO);
+    ASSERT_TRUE(scene != NULL);
+    EXPECT_TRUE(scene->flashMode == NULL);
+    EXPECT_EQ(SCENE_MODE_NONE, scene->value);
+}
+
+TEST(SecCameraParamsTest, FocusModesHaveDistances)
+{
+    for (const FocusModeParam *focus = focusModes; focus->name != NULL; focus++) {
+        ASSERT_TRUE(focus->distances != NULL) << focus->name;
+        EXPECT_TRUE(hasItem(focus->distances, "Infinity")) << focus->name;
+    }
+}
+
+}; // namespace android
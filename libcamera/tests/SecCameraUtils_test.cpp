@@ -0,0 +1,227 @@
+/*
+**
+** Copyright 2026, The LineageOS Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "SecCameraUtils.h"
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <vector>
+
+namespace android {
+
+// ======================================================================
+// JPEG markers
+
+/* builds a JPEG stream segment by segment */
+class JpegBuilder {
+public:
+    JpegBuilder() { marker(0xD8); }
+
+    int marker(uint8_t m) {
+        int at = mData.size();
+        mData.push_back(0xFF);
+        mData.push_back(m);
+        return at;
+    }
+
+    /* a marker with a payload of length bytes, filled with fill */
+    int segment(uint8_t m, int length, uint8_t fill = 0x11, const char *head = NULL,
+                int headLength = 0) {
+        int at = marker(m);
+        mData.push_back((length + 2) >> 8);
+        mData.push_back((length + 2) & 0xff);
+        for (int i = 0; i < length; i++)
+            mData.push_back(i < headLength ? head[i] : fill);
+        return at;
+    }
+
+    void bytes(const uint8_t *b, int n) { mData.insert(mData.end(), b, b + n); }
+
+    const uint8_t *data() const { return &mData[0]; }
+    size_t size() const { return mData.size(); }
+
+private:
+    std::vector<uint8_t> mData;
+};
+
+TEST(JpegMarkers, FindsSegments)
+{
+    JpegBuilder jpeg;
+    jpeg.segment(0xE0, 14);                                 /* JFIF */
+    int app1 = jpeg.segment(0xE1, 300, 0x22, "Exif\0\0", 6);
+    jpeg.segment(0xDB, 65);                                 /* DQT */
+    jpeg.segment(0xC0, 15);                                 /* SOF0 */
+    jpeg.segment(0xC4, 29);                                 /* DHT */
+    int sos = jpeg.segment(0xDA, 10);
+    /* entropy data with a stuffed byte, restart markers and fill */
+    static const uint8_t scan[] = {
+        0x12, 0xFF, 0x00, 0x34, 0xFF, 0xD0, 0x56, 0xFF, 0xD7, 0x78,
+        0xFF, 0xFF, 0x00, 0x9A,
+    };
+    jpeg.bytes(scan, sizeof(scan));
+    int eoi = jpeg.marker(0xD9);
+    /* padding the ISP leaves after the stream */
+    static const uint8_t pad[] = { 0x00, 0xFF, 0xD9, 0x00 };
+    jpeg.bytes(pad, sizeof(pad));
+
+    JpegMarkers m;
+    ASSERT_TRUE(parseJpegMarkers(jpeg.data(), jpeg.size(), &m));
+    EXPECT_EQ(0, m.soi);
+    EXPECT_EQ(app1, m.app1);
+    EXPECT_EQ(300 + 4, m.app1Length);
+    EXPECT_EQ(sos, m.sos);
+    EXPECT_EQ(eoi, m.eoi);
+}
+
+TEST(JpegMarkers, Progressive)
+{
+    JpegBuilder jpeg;
+    jpeg.segment(0xC2, 15);                                 /* SOF2 */
+    int sos = jpeg.segment(0xDA, 10);
+    static const uint8_t scan1[] = { 0x01, 0x02, 0xFF, 0x00 };
+    jpeg.bytes(scan1, sizeof(scan1));
+    jpeg.segment(0xC4, 20);                                 /* DHT between scans */
+    jpeg.segment(0xDA, 10);
+    static const uint8_t scan2[] = { 0x03, 0x04 };
+    jpeg.bytes(scan2, sizeof(scan2));
+    int eoi = jpeg.marker(0xD9);
+
+    JpegMarkers m;
+    ASSERT_TRUE(parseJpegMarkers(jpeg.data(), jpeg.size(), &m));
+    EXPECT_EQ(-1, m.app1);
+    EXPECT_EQ(-1, m.app1Length);
+    EXPECT_EQ(sos, m.sos);
+    EXPECT_EQ(eoi, m.eoi);
+}
+
+TEST(JpegMarkers, IgnoresNonExifApp1)
+{
+    JpegBuilder jpeg;
+    jpeg.segment(0xE1, 40, 0x33, "http://ns.adobe.com/xap/1.0/", 28);   /* XMP */
+    int app1 = jpeg.segment(0xE1, 100, 0x22, "Exif\0\0", 6);
+    jpeg.segment(0xDA, 10);
+    jpeg.marker(0xD9);
+
+    JpegMarkers m;
+    ASSERT_TRUE(parseJpegMarkers(jpeg.data(), jpeg.size(), &m));
+    EXPECT_EQ(app1, m.app1);
+}
+
+TEST(JpegMarkers, RejectsBrokenStreams)
+{
+    JpegBuilder jpeg;
+    jpeg.segment(0xE1, 100, 0x22, "Exif\0\0", 6);
+    jpeg.segment(0xDA, 10);
+    static const uint8_t scan[] = { 0x01, 0x02, 0x03 };
+    jpeg.bytes(scan, sizeof(scan));
+    int eoi = jpeg.marker(0xD9);
+
+    JpegMarkers m;
+    /* cut anywhere before EOI */
+    for (int size = 0; size < eoi + 2; size++)
+        EXPECT_FALSE(parseJpegMarkers(jpeg.data(), size, &m)) << "cut at " << size;
+    EXPECT_TRUE(parseJpegMarkers(jpeg.data(), eoi + 2, &m));
+
+    /* no SOI */
+    EXPECT_FALSE(parseJpegMarkers(jpeg.data() + 2, jpeg.size() - 2, &m));
+    EXPECT_EQ(-1, m.soi);
+
+    /* a segment length running past the end */
+    std::vector<uint8_t> bad(jpeg.data(), jpeg.data() + jpeg.size());
+    bad[4] = 0x7F;
+    EXPECT_FALSE(parseJpegMarkers(&bad[0], bad.size(), &m));
+
+    /* garbage where a marker should be */
+    bad.assign(jpeg.data(), jpeg.data() + jpeg.size());
+    bad[2] = 0x00;
+    EXPECT_FALSE(parseJpegMarkers(&bad[0], bad.size(), &m));
+}
+
+// ======================================================================
+// Record return ring
+
+TEST(RecordReturnRing, FifoUntilFull)
+{
+    RecordReturnRing ring;
+
+    EXPECT_EQ(-1, ring.pop());
+
+    /* goes round several times, with the indices wrapping in the slots */
+    for (int round = 0; round < 5; round++) {
+        int pushed = 0;
+        while (ring.push(round * 100 + pushed))
+            pushed++;
+        EXPECT_EQ(16, pushed);
+
+        for (int i = 0; i < pushed; i++)
+            ASSERT_EQ(round * 100 + i, ring.pop());
+        EXPECT_EQ(-1, ring.pop());
+    }
+}
+
+TEST(RecordReturnRing, ResetEmpties)
+{
+    RecordReturnRing ring;
+
+    ring.push(3);
+    ring.push(4);
+    ring.reset();
+    EXPECT_EQ(-1, ring.pop());
+    EXPECT_TRUE(ring.push(5));
+    EXPECT_EQ(5, ring.pop());
+}
+
+/* the encoder returning buffers while the preview thread drains them */
+static const int kStressCount = 1000000;
+
+static void *stressProducer(void *arg)
+{
+    RecordReturnRing *ring = (RecordReturnRing *)arg;
+
+    for (int i = 0; i < kStressCount; i++) {
+        while (!ring->push(i % 8))
+            sched_yield();
+    }
+    return NULL;
+}
+
+TEST(RecordReturnRing, OneProducerOneConsumer)
+{
+    RecordReturnRing ring;
+    pthread_t producer;
+
+    ASSERT_EQ(0, pthread_create(&producer, NULL, stressProducer, &ring));
+
+    /* keep draining on a mismatch, the producer would spin on a full ring */
+    int next = 0, mismatches = 0;
+    while (next < kStressCount) {
+        int index = ring.pop();
+        if (index < 0) {
+            sched_yield();
+            continue;
+        }
+        if (index != next % 8)
+            mismatches++;
+        next++;
+    }
+
+    pthread_join(producer, NULL);
+    EXPECT_EQ(0, mismatches);
+    EXPECT_EQ(-1, ring.pop());
+}
+
+}; // namespace android